@@ -0,0 +1,121 @@
+/*
+ * ASCII STL parse throughput
+ * ==========================
+ * Writes a synthetic ASCII STL and reports MB/s for:
+ *   - the old getline + istringstream parser (kept here as a baseline)
+ *   - STLModel::load, single-threaded
+ *   - STLModel::load, parallel
+ *
+ * Usage: ascii_parse_bench [triangles] [repeats]
+ */
+
+#include "stl_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static void writeSyntheticASCII(const std::string& path, size_t numTriangles) {
+    std::ofstream out(path);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+
+    char line[160];
+    out << "solid bench\n";
+    for (size_t i = 0; i < numTriangles; ++i) {
+        std::snprintf(line, sizeof(line), "  facet normal %e %e %e\n    outer loop\n",
+                      0.0, 0.0, 1.0);
+        out << line;
+        for (int v = 0; v < 3; ++v) {
+            std::snprintf(line, sizeof(line), "      vertex %e %e %e\n",
+                          dist(rng), dist(rng), dist(rng));
+            out << line;
+        }
+        out << "    endloop\n  endfacet\n";
+    }
+    out << "endsolid bench\n";
+}
+
+// The parser STLModel used before the buffer tokenizer, for comparison
+static size_t legacyParse(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<Triangle> triangles;
+    std::string line;
+    Triangle currentTri{};
+    int vertexIndex = 0;
+
+    while (std::getline(file, line)) {
+        size_t start = line.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos) continue;
+        line = line.substr(start);
+
+        if (line.rfind("facet normal", 0) == 0) {
+            std::istringstream iss(line.substr(12));
+            iss >> currentTri.normal[0] >> currentTri.normal[1] >> currentTri.normal[2];
+            vertexIndex = 0;
+        } else if (line.rfind("vertex", 0) == 0) {
+            std::istringstream iss(line.substr(6));
+            float x, y, z;
+            iss >> x >> y >> z;
+            if (vertexIndex == 0) currentTri.v0 = {x, y, z};
+            else if (vertexIndex == 1) currentTri.v1 = {x, y, z};
+            else if (vertexIndex == 2) currentTri.v2 = {x, y, z};
+            vertexIndex++;
+        } else if (line.rfind("endfacet", 0) == 0) {
+            triangles.push_back(currentTri);
+        }
+    }
+    return triangles.size();
+}
+
+template <typename Fn>
+static void report(const char* name, double megabytes, int repeats, Fn&& fn) {
+    double best = 1e30;
+    size_t tris = 0;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        tris = fn();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s);
+    }
+    std::printf("%-22s %9.1f ms  %8.1f MB/s  (%zu triangles)\n",
+                name, best * 1000.0, megabytes / best, tris);
+}
+
+int main(int argc, char** argv) {
+    size_t numTriangles = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::string path = (fs::temp_directory_path() / "stl_viewer_ascii_bench.stl").string();
+    writeSyntheticASCII(path, numTriangles);
+    double megabytes = fs::file_size(path) / (1024.0 * 1024.0);
+    std::printf("%s: %.1f MB, %zu triangles, best of %d\n\n", path.c_str(), megabytes, numTriangles, repeats);
+
+    report("legacy istringstream", megabytes, repeats, [&] { return legacyParse(path); });
+
+    LoadOptions serial;
+    serial.parallel = false;
+    report("load (1 thread)", megabytes, repeats, [&] {
+        STLModel m;
+        m.load(path, serial);
+        return m.triangleCount();
+    });
+
+    report("load (parallel)", megabytes, repeats, [&] {
+        STLModel m;
+        m.load(path);
+        return m.triangleCount();
+    });
+
+    fs::remove(path);
+    return 0;
+}
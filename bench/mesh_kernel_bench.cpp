@@ -0,0 +1,135 @@
+/*
+ * Triangle emit kernels
+ * =====================
+ * Runs the post-decode pass (zero-normal fixup, bounds, GL interleave) over
+ * synthetic binary STL records on one thread and reports M triangles/s for:
+ *   - three separate passes over a Triangle array (how the loader used to
+ *     do it: fix normals, then bounds, then buildGLData), as a baseline
+ *   - every MeshKernels variant this CPU runs, fused into one pass
+ * Each variant's output is checked byte for byte against the baseline's.
+ *
+ * Usage: mesh_kernel_bench [million triangles] [repeats] [zero-normal %]
+ */
+
+#include "mesh_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr size_t kRecordSize = 50;
+
+static std::vector<char> makeRecords(size_t count, double zeroNormals) {
+    std::vector<char> records(count * kRecordSize);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f), jitter(-0.5f, 0.5f), unit(0.0f, 1.0f);
+    for (size_t i = 0; i < count; ++i) {
+        float t[12];
+        for (int k = 3; k < 6; ++k) t[k] = pos(rng);
+        for (int k = 6; k < 12; ++k) t[k] = t[3 + k % 3] + jitter(rng);
+        if (unit(rng) < zeroNormals) {
+            t[0] = t[1] = t[2] = 0.0f;
+        } else {
+            t[0] = 0.0f; t[1] = 0.0f; t[2] = 1.0f;
+        }
+        std::memcpy(&records[i * kRecordSize], t, sizeof(t));
+        std::memset(&records[i * kRecordSize + sizeof(t)], 0, 2);
+    }
+    return records;
+}
+
+// The pre-kernel loader: decode to Triangles, then one pass per job
+static void threePasses(const std::vector<char>& records, size_t count,
+                        std::vector<Triangle>& tris, std::vector<float>& out, BoundingBox& box) {
+    for (size_t i = 0; i < count; ++i) std::memcpy(&tris[i], &records[i * kRecordSize], sizeof(Triangle));
+
+    for (auto& tri : tris) {
+        float len = tri.normal[0]*tri.normal[0] + tri.normal[1]*tri.normal[1] + tri.normal[2]*tri.normal[2];
+        if (len >= 1e-6f) continue;
+        float ux = tri.v1[0] - tri.v0[0], uy = tri.v1[1] - tri.v0[1], uz = tri.v1[2] - tri.v0[2];
+        float vx = tri.v2[0] - tri.v0[0], vy = tri.v2[1] - tri.v0[1], vz = tri.v2[2] - tri.v0[2];
+        float nx = uy*vz - uz*vy, ny = uz*vx - ux*vz, nz = ux*vy - uy*vx;
+        float nlen = std::sqrt(nx*nx + ny*ny + nz*nz);
+        if (nlen > 1e-6f) tri.normal = {nx/nlen, ny/nlen, nz/nlen};
+    }
+
+    box.reset();
+    auto include = [&](const std::array<float, 3>& v) {
+        box.minX = std::min(box.minX, v[0]); box.maxX = std::max(box.maxX, v[0]);
+        box.minY = std::min(box.minY, v[1]); box.maxY = std::max(box.maxY, v[1]);
+        box.minZ = std::min(box.minZ, v[2]); box.maxZ = std::max(box.maxZ, v[2]);
+    };
+    for (const auto& tri : tris) {
+        include(tri.v0);
+        include(tri.v1);
+        include(tri.v2);
+    }
+
+    float* o = out.data();
+    for (const auto& tri : tris) {
+        const std::array<float, 3>* verts[3] = {&tri.v0, &tri.v1, &tri.v2};
+        for (const auto* v : verts) {
+            *o++ = tri.normal[0]; *o++ = tri.normal[1]; *o++ = tri.normal[2];
+            *o++ = (*v)[0];       *o++ = (*v)[1];       *o++ = (*v)[2];
+        }
+    }
+}
+
+template <typename Fn>
+static double report(const char* name, size_t count, int repeats, double baseline, Fn&& fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s);
+    }
+    double mtris = count / best / 1e6;
+    // Bytes read (50 per record) plus written (72 per triangle)
+    double gbs = count * (kRecordSize + 72.0) / best / 1e9;
+    std::printf("%-22s %9.1f ms  %8.1f Mtri/s  %6.2f GB/s", name, best * 1000.0, mtris, gbs);
+    if (baseline > 0.0) std::printf("  %5.2fx", baseline / best);
+    std::printf("\n");
+    return best;
+}
+
+int main(int argc, char** argv) {
+    double millions = argc > 1 ? std::atof(argv[1]) : 10.0;
+    int repeats      = argc > 2 ? std::atoi(argv[2]) : 5;
+    double zeroPct   = argc > 3 ? std::atof(argv[3]) : 0.0;
+    size_t count = std::max<size_t>(1, size_t(millions * 1e6));
+
+    std::vector<char> records = makeRecords(count, zeroPct / 100.0);
+    std::printf("%zu triangles (%.0f MB of records), %.1f%% zero normals, 1 thread, best of %d\n\n",
+                count, records.size() / (1024.0 * 1024.0), zeroPct, repeats);
+
+    std::vector<float> out(count * 18), reference(count * 18);
+    BoundingBox box, referenceBox;
+
+    double baseline;
+    {
+        std::vector<Triangle> tris(count);
+        baseline = report("three passes", count, repeats, 0.0, [&] { threePasses(records, count, tris, reference, referenceBox); });
+    }
+
+    bool ok = true;
+    for (const auto& kernel : MeshKernels::available()) {
+        report(kernel.name, count, repeats, baseline, [&] {
+            box.reset();
+            kernel.emit(records.data(), kRecordSize, count, out.data(), box);
+        });
+
+        if (std::memcmp(out.data(), reference.data(), out.size() * sizeof(float)) != 0 ||
+            std::memcmp(&box, &referenceBox, sizeof(BoundingBox)) != 0) {
+            std::printf("  MISMATCH: %s differs from three passes\n", kernel.name);
+            ok = false;
+        }
+    }
+    std::printf("\nDispatched: %s\n", MeshKernels::best().name);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/*
+ * PNG encode throughput
+ * =====================
+ * Encodes a synthetic render-like frame (flat background, shaded blob,
+ * a little noise) and reports MB/s of RGBA input plus output size for:
+ *   - stbi_write_png (the encoder Exporter used before, as a baseline)
+ *   - Exporter::encodePNG at fast / balanced / small, 1 thread and all threads
+ *   - the other export encoders (QOI, JPEG, WebP when built in) for comparison
+ *
+ * Usage: png_encode_bench [width] [height] [repeats]
+ */
+
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#include "exporter.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static std::vector<unsigned char> makeFrame(int w, int h) {
+    std::vector<unsigned char> px(size_t(w) * h * 4);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> noise(-2, 2);
+
+    float cx = w * 0.5f, cy = h * 0.5f, r = std::min(w, h) * 0.35f;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            unsigned char* p = &px[(size_t(y) * w + x) * 4];
+            float dx = (x - cx) / r, dy = (y - cy) / r;
+            float d2 = dx * dx + dy * dy;
+            if (d2 < 1.0f) {
+                // Lambert-ish shading of a sphere, with mild dithering noise
+                float nz = std::sqrt(1.0f - d2);
+                float shade = 0.25f + 0.75f * std::max(0.0f, 0.3f * -dx + 0.5f * -dy + 0.8f * nz);
+                p[0] = (unsigned char)std::clamp(int(79  * shade) + noise(rng), 0, 255);
+                p[1] = (unsigned char)std::clamp(int(195 * shade) + noise(rng), 0, 255);
+                p[2] = (unsigned char)std::clamp(int(247 * shade) + noise(rng), 0, 255);
+            } else {
+                p[0] = 30; p[1] = 30; p[2] = 46;
+            }
+            p[3] = 255;
+        }
+    }
+    return px;
+}
+
+static void stbCount(void* ctx, void*, int size) {
+    *static_cast<size_t*>(ctx) += size_t(size);
+}
+
+template <typename Fn>
+static void report(const char* name, double megabytes, int repeats, Fn&& fn) {
+    double best = 1e30;
+    size_t bytes = 0;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        bytes = fn();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        best = std::min(best, s);
+    }
+    std::printf("%-26s %9.1f ms  %8.1f MB/s  %9zu KB\n",
+                name, best * 1000.0, megabytes / best, bytes / 1024);
+}
+
+int main(int argc, char** argv) {
+    int w = argc > 1 ? std::atoi(argv[1]) : 3840;
+    int h = argc > 2 ? std::atoi(argv[2]) : 2160;
+    int repeats = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    std::vector<unsigned char> frame = makeFrame(w, h);
+    double megabytes = frame.size() / (1024.0 * 1024.0);
+    std::printf("%dx%d RGBA (%.1f MB), %u hardware threads, best of %d\n\n",
+                w, h, megabytes, Parallel::threadCount(), repeats);
+
+    report("stbi_write_png (RGBA)", megabytes, repeats, [&] {
+        size_t bytes = 0;
+        stbi_write_png_to_func(stbCount, &bytes, w, h, 4, frame.data(), w * 4);
+        return bytes;
+    });
+
+    const struct { const char* name; Exporter::PNGCompression level; } levels[] = {
+        {"fast",     Exporter::PNGCompression::Fast},
+        {"balanced", Exporter::PNGCompression::Balanced},
+        {"small",    Exporter::PNGCompression::Small},
+    };
+
+    std::vector<unsigned char> png;
+    for (const auto& level : levels) {
+        for (unsigned threads : {1u, 0u}) {
+            Exporter::PNGOptions options;
+            options.compression = level.level;
+            options.threads     = threads;
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s (RGB, %s)", level.name,
+                          threads == 1 ? "1 thread" : "all threads");
+            report(name, megabytes, repeats, [&] {
+                Exporter::encodePNG(w, h, frame, options, png);
+                return png.size();
+            });
+        }
+    }
+
+    std::printf("\n");
+    const struct { const char* name; Exporter::ImageFormat format; } others[] = {
+        {"qoi (RGB)",       Exporter::ImageFormat::QOI},
+        {"jpeg (q90)",      Exporter::ImageFormat::JPEG},
+        {"webp (q90, RGB)", Exporter::ImageFormat::WebP},
+    };
+    for (const auto& other : others) {
+        Exporter::ExportFormat format;
+        format.format = other.format;
+        auto encoder = Exporter::makeEncoder(format);
+        if (!encoder) continue;
+        std::vector<unsigned char> out;
+        report(other.name, megabytes, repeats, [&] {
+            encoder->encode(w, h, frame, out);
+            return out.size();
+        });
+    }
+    return 0;
+}
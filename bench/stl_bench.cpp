@@ -0,0 +1,619 @@
+/*
+ * End-to-end benchmark harness
+ * ============================
+ * Times the whole path from file to image on synthetic meshes (binary and
+ * ASCII at each --sizes entry) and on any STL files given:
+ *   - STLModel::load per format and loader mode (parallel, single-thread,
+ *     weld, BVH, mesh-cache hit, and time to first streamed geometry)
+ *   - the post-load stages on their own (weld, buildBVH, ensureTriangles,
+ *     buildGLData, LOD chain)
+ *   - Renderer::uploadModel, renderToBuffer (draw + readback) and
+ *     Exporter::savePNG, on a hidden GL 3.3 context (skipped without one)
+ * Each case reports min / mean / p50 / p90 / p99 / max milliseconds,
+ * throughput at the median and the process's peak RSS during the case.
+ * --json writes the same as machine-readable JSON for regression tracking.
+ *
+ * Usage: stl_bench [--sizes N,N,...] [--repeats N] [--image WxH] [--no-gl]
+ *                  [--json FILE|-] [file.stl ...]
+ */
+
+#include "stl_loader.h"
+#include "mesh_kernels.h"
+#include "mesh_lod.h"
+#include "parallel.h"
+#include "renderer.h"
+#include "exporter.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// ── Peak RSS ────────────────────────────────────────────────────────────────
+// Linux can reset the high-water mark, so each case gets its own peak;
+// elsewhere the figure is the process's peak so far.
+
+static void resetPeakRss() {
+#ifdef __linux__
+    if (FILE* f = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+#endif
+}
+
+static uint64_t peakRssBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+#ifdef __linux__
+    if (FILE* f = std::fopen("/proc/self/status", "r")) {
+        char line[256];
+        unsigned long long kb = 0;
+        while (std::fgets(line, sizeof(line), f)) {
+            if (std::sscanf(line, "VmHWM: %llu kB", &kb) == 1) break;
+        }
+        std::fclose(f);
+        if (kb) return kb * 1024;
+    }
+#endif
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return uint64_t(usage.ru_maxrss);          // Bytes
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;   // Kilobytes
+#endif
+#endif
+}
+
+// ── Synthetic meshes ────────────────────────────────────────────────────────
+// A closed torus grid: every vertex is shared by six triangles, like a
+// scanned or CAD-tessellated part, so welding and LODs have real work.
+
+static std::vector<Triangle> makeTorus(size_t targetTriangles) {
+    size_t cells = std::max<size_t>(1, targetTriangles / 2);
+    size_t nu = std::max<size_t>(3, size_t(std::sqrt(double(cells) * 4.0)));
+    size_t nv = std::max<size_t>(3, cells / nu);
+
+    const float R = 40.0f, r = 12.0f, twoPi = 6.28318531f;
+    auto point = [&](size_t i, size_t j) {
+        float u = twoPi * float(i % nu) / float(nu), v = twoPi * float(j % nv) / float(nv);
+        return std::array<float, 3>{(R + r * std::cos(v)) * std::cos(u),
+                                    (R + r * std::cos(v)) * std::sin(u),
+                                    r * std::sin(v)};
+    };
+
+    std::vector<Triangle> tris;
+    tris.reserve(nu * nv * 2);
+    for (size_t i = 0; i < nu; ++i) {
+        for (size_t j = 0; j < nv; ++j) {
+            auto a = point(i, j), b = point(i + 1, j), c = point(i + 1, j + 1), d = point(i, j + 1);
+            tris.push_back({{0.0f, 0.0f, 0.0f}, a, b, c});   // Zero normals: the loader fixes them
+            tris.push_back({{0.0f, 0.0f, 0.0f}, a, c, d});
+        }
+    }
+    return tris;
+}
+
+static bool writeBinarySTL(const std::string& path, const std::vector<Triangle>& tris) {
+    std::ofstream out(path, std::ios::binary);
+    char header[80] = "stl_bench synthetic torus";
+    uint32_t count = uint32_t(tris.size());
+    out.write(header, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&count), 4);
+    const uint16_t attributes = 0;
+    for (const auto& tri : tris) {
+        out.write(reinterpret_cast<const char*>(&tri), sizeof(Triangle));
+        out.write(reinterpret_cast<const char*>(&attributes), 2);
+    }
+    return bool(out);
+}
+
+static bool writeASCIISTL(const std::string& path, const std::vector<Triangle>& tris) {
+    std::ofstream out(path);
+    char line[160];
+    out << "solid stl_bench\n";
+    for (const auto& tri : tris) {
+        std::snprintf(line, sizeof(line), "  facet normal %e %e %e\n    outer loop\n",
+                      tri.normal[0], tri.normal[1], tri.normal[2]);
+        out << line;
+        for (const auto* v : {&tri.v0, &tri.v1, &tri.v2}) {
+            std::snprintf(line, sizeof(line), "      vertex %e %e %e\n", (*v)[0], (*v)[1], (*v)[2]);
+            out << line;
+        }
+        out << "    endloop\n  endfacet\n";
+    }
+    out << "endsolid stl_bench\n";
+    return bool(out);
+}
+
+// ── Measurement ─────────────────────────────────────────────────────────────
+
+struct Case {
+    std::string input;       // "synthetic-1000000" or the file name
+    std::string format;      // binary / ascii / any (stages past the loader)
+    std::string stage;       // load, weld, upload, ...
+    std::string mode;        // Loader mode for "load"; empty otherwise
+    size_t      triangles = 0;
+    uint64_t    bytes     = 0;   // Input bytes the throughput figure is per
+    std::vector<double> ms;      // One sample per repeat
+    uint64_t    peakRss   = 0;
+    bool        ok        = true;
+};
+
+struct Summary {
+    double min, mean, p50, p90, p99, max;
+};
+
+static Summary summarize(std::vector<double> ms) {
+    Summary s{};
+    if (ms.empty()) return s;
+    std::sort(ms.begin(), ms.end());
+    // Nearest-rank percentiles
+    auto pct = [&](double p) {
+        size_t rank = size_t(std::ceil(p / 100.0 * double(ms.size())));
+        return ms[std::min(ms.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+    s.min = ms.front();
+    s.max = ms.back();
+    double sum = 0.0;
+    for (double v : ms) sum += v;
+    s.mean = sum / double(ms.size());
+    s.p50 = pct(50);
+    s.p90 = pct(90);
+    s.p99 = pct(99);
+    return s;
+}
+
+// Human-readable table; stderr when the JSON goes to stdout
+static FILE* g_table = stdout;
+
+// Time one call; negative = it failed
+static double timeMs(const std::function<bool()>& fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    bool ok = fn();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return ok ? ms : -1.0;
+}
+
+struct Bench {
+    int repeats = 5;
+    std::vector<Case> cases;
+
+    // `sample` does any untimed setup, then returns timeMs() of the work
+    // (or its own figure); a failed sample ends the case
+    void run(Case c, const std::function<double()>& sample) {
+        resetPeakRss();
+        for (int r = 0; r < repeats; ++r) {
+            double ms = sample();
+            if (ms < 0.0) {
+                c.ok = false;
+                break;
+            }
+            c.ms.push_back(ms);
+        }
+        c.peakRss = peakRssBytes();
+        print(c);
+        cases.push_back(std::move(c));
+    }
+
+    static void print(const Case& c) {
+        Summary s = summarize(c.ms);
+        std::string name = c.stage + (c.mode.empty() ? "" : " (" + c.mode + ")");
+        std::fprintf(g_table, "  %-7s %-30s %9.2f ms p50 %9.2f p90 %8.2f Mtri/s %9.1f MB/s %7.0f MB RSS%s\n",
+                    c.format.c_str(), name.c_str(), s.p50, s.p90,
+                    s.p50 > 0 ? c.triangles / s.p50 / 1e3 : 0.0,
+                    s.p50 > 0 ? c.bytes / s.p50 / 1e3 : 0.0,
+                    c.peakRss / (1024.0 * 1024.0), c.ok ? "" : "  FAILED");
+    }
+};
+
+// ── JSON ────────────────────────────────────────────────────────────────────
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            std::snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)(unsigned char)c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string toJSON(const Bench& bench, const std::string& glRenderer, int imageW, int imageH) {
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"schema\": 1,\n";
+    out << "  \"timestamp\": " << jsonString(stamp) << ",\n";
+    out << "  \"hardwareThreads\": " << Parallel::threadCount() << ",\n";
+    out << "  \"simd\": " << jsonString(MeshKernels::best().name) << ",\n";
+    out << "  \"glRenderer\": " << (glRenderer.empty() ? "null" : jsonString(glRenderer)) << ",\n";
+    out << "  \"image\": [" << imageW << ", " << imageH << "],\n";
+    out << "  \"repeats\": " << bench.repeats << ",\n";
+    out << "  \"cases\": [";
+
+    char buf[512];
+    for (size_t i = 0; i < bench.cases.size(); ++i) {
+        const Case& c = bench.cases[i];
+        Summary s = summarize(c.ms);
+        out << (i ? ",\n" : "\n") << "    {";
+        out << "\"input\": " << jsonString(c.input) << ", \"format\": " << jsonString(c.format)
+            << ", \"stage\": " << jsonString(c.stage) << ", \"mode\": " << jsonString(c.mode);
+        std::snprintf(buf, sizeof(buf),
+                      ", \"ok\": %s, \"triangles\": %zu, \"bytes\": %llu, \"samples\": %zu"
+                      ", \"ms\": {\"min\": %.4f, \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}"
+                      ", \"mtrisPerSec\": %.3f, \"mbPerSec\": %.3f, \"peakRssBytes\": %llu}",
+                      c.ok ? "true" : "false", c.triangles, (unsigned long long)c.bytes, c.ms.size(),
+                      s.min, s.mean, s.p50, s.p90, s.p99, s.max,
+                      s.p50 > 0 ? c.triangles / s.p50 / 1e3 : 0.0,
+                      s.p50 > 0 ? c.bytes / s.p50 / 1e3 : 0.0,
+                      (unsigned long long)c.peakRss);
+        out << buf;
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+// ── GL context ──────────────────────────────────────────────────────────────
+
+static GLFWwindow* createHiddenContext() {
+    if (!glfwInit()) return nullptr;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(16, 16, "stl_bench", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;   // GLX-only GLEW under EGL
+#endif
+    if (err != GLEW_OK) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+// ── Cases ───────────────────────────────────────────────────────────────────
+
+static Case makeCase(const std::string& input, const std::string& format, const std::string& stage,
+                     const std::string& mode, size_t triangles, uint64_t bytes) {
+    Case c;
+    c.input     = input;
+    c.format    = format;
+    c.stage     = stage;
+    c.mode      = mode;
+    c.triangles = triangles;
+    c.bytes     = bytes;
+    return c;
+}
+
+// STLModel::load in each loader mode
+static void benchLoads(Bench& bench, const std::string& input, const std::string& format,
+                       const std::string& path, const fs::path& scratch) {
+    std::error_code ec;
+    uint64_t bytes = fs::file_size(path, ec);
+    STLFileInfo info;
+    probeSTLFile(path, info);
+
+    // The header count is exact for binary; ASCII gets the real one from a load
+    size_t triangles = info.triangles;
+    if (!info.binary) {
+        STLModel model;
+        if (model.load(path)) triangles = model.triangleCount();
+    }
+
+    struct Mode {
+        const char* name;
+        void (*apply)(LoadOptions&);
+    };
+    const Mode modes[] = {
+        {"parallel",      [](LoadOptions&) {}},
+        {"single-thread", [](LoadOptions& o) { o.parallel = false; }},
+        {"weld",          [](LoadOptions& o) { o.weld = true; }},
+        {"bvh",           [](LoadOptions& o) { o.buildBVH = true; }},
+    };
+    for (const auto& mode : modes) {
+        LoadOptions options;
+        mode.apply(options);
+        bench.run(makeCase(input, format, "load", mode.name, triangles, bytes), [&] {
+            STLModel model;
+            return timeMs([&] { return model.load(path, options); });
+        });
+    }
+
+    // Mesh-cache hit: the first load writes the entry, every sample maps it
+    {
+        LoadOptions options;
+        options.buildBVH = true;
+        options.cacheDir = (scratch / "cache").string();
+        STLModel primer;
+        primer.load(path, options);
+        bench.run(makeCase(input, format, "load", "cache-hit", triangles, bytes), [&] {
+            STLModel model;
+            return timeMs([&] { return model.load(path, options); });
+        });
+    }
+
+    // Streaming: the time until the first run of triangles is published,
+    // which is when the viewer can first put the model on screen
+    bench.run(makeCase(input, format, "load", "stream-first-geometry", triangles, bytes), [&] {
+        LoadOptions options;
+        options.stream = std::make_shared<LoadStream>();
+        LoadStream& stream = *options.stream;
+
+        STLModel model;
+        bool ok = false;
+        auto t0 = std::chrono::steady_clock::now();
+        std::thread loader([&] { ok = model.load(path, options); });
+
+        double firstMs = -1.0;
+        while (!stream.closed()) {
+            // Keep draining after the first run so close() needn't wait
+            stream.drain([&](const float*, const LoadStream::Range&) {
+                if (firstMs < 0.0) {
+                    firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                }
+            });
+            std::this_thread::yield();
+        }
+        loader.join();
+        return ok ? firstMs : -1.0;
+    });
+}
+
+// The post-load stages on their own, each on a fresh copy of `base`
+static void benchStages(Bench& bench, const std::string& input, const STLModel& base, unsigned threads) {
+    size_t tris = base.triangleCount();
+    uint64_t bytes = base.glVertices.size() * sizeof(float);
+    STLModel model;
+
+    bench.run(makeCase(input, "any", "weld", "", tris, bytes), [&] {
+        model = base;
+        return timeMs([&] { model.weld(); return model.isIndexed(); });
+    });
+    bench.run(makeCase(input, "any", "buildBVH", "", tris, bytes), [&] {
+        model = base;
+        return timeMs([&] { model.buildBVH(threads); return model.bvh != nullptr; });
+    });
+    bench.run(makeCase(input, "any", "ensureTriangles", "", tris, bytes), [&] {
+        model = base;
+        model.triangles.clear();
+        return timeMs([&] { model.ensureTriangles(); return !model.triangles.empty(); });
+    });
+    bench.run(makeCase(input, "any", "buildGLData", "", tris, bytes), [&] {
+        model = base;
+        model.ensureTriangles();
+        return timeMs([&] { model.buildGLData(); return model.vertexCount > 0; });
+    });
+
+    LodOptions lod;
+    lod.threads = threads;
+    bench.run(makeCase(input, "any", "lodChain", "", tris, bytes), [&] {
+        return timeMs([&] { buildLodChain(base, lod); return true; });
+    });
+}
+
+// Upload, offscreen draw + readback, and PNG encode + write
+static void benchGL(Bench& bench, const std::string& input, const STLModel& base, Renderer& renderer,
+                    int width, int height, const fs::path& scratch) {
+    size_t tris = base.triangleCount();
+    uint64_t pixelBytes = uint64_t(width) * height * 4;
+    RenderSettings settings;
+
+    bench.run(makeCase(input, "any", "uploadModel", "", tris,
+                       base.glVertices.size() * sizeof(float) + base.indices.size() * sizeof(uint32_t)), [&] {
+        renderer.evictAll();
+        return timeMs([&] {
+            bool ok = renderer.uploadModel(base) != 0;
+            glFinish();
+            return ok;
+        });
+    });
+
+    std::vector<unsigned char> pixels;
+    renderer.uploadModel(base);
+    renderer.renderToBuffer(base, settings, width, height, pixels);   // Warm the target
+    bench.run(makeCase(input, "any", "renderToBuffer", "", tris, pixelBytes), [&] {
+        return timeMs([&] { return renderer.renderToBuffer(base, settings, width, height, pixels); });
+    });
+
+    std::string png = (scratch / "frame.png").string();
+    bench.run(makeCase(input, "any", "savePNG", "", tris, pixelBytes), [&] {
+        return timeMs([&] { return !pixels.empty() && Exporter::savePNG(png, width, height, pixels); });
+    });
+}
+
+// ── Main ────────────────────────────────────────────────────────────────────
+
+static std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) sizes.push_back(size_t(std::strtoull(item.c_str(), nullptr, 10)));
+    }
+    return sizes;
+}
+
+static void usage() {
+    std::cerr << "Usage: stl_bench [--sizes N,N,...] [--repeats N] [--image WxH] [--no-gl]\n"
+                 "                 [--json FILE|-] [file.stl ...]\n"
+                 "  --sizes    Synthetic triangle counts, binary + ASCII each (default 100000,1000000)\n"
+                 "  --repeats  Samples per case (default 5)\n"
+                 "  --image    renderToBuffer / savePNG size (default 1920x1080)\n"
+                 "  --no-gl    Skip upload, render and PNG cases\n"
+                 "  --json     Also write results as JSON (- = stdout, replacing the table)\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = {100000, 1000000};
+    std::vector<std::string> files;
+    std::string jsonPath;
+    int width = 1920, height = 1080;
+    bool useGL = true;
+    Bench bench;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        if (arg == "--sizes") {
+            const char* v = value();
+            if (!v) { usage(); return 2; }
+            sizes = parseSizes(v);
+        } else if (arg == "--repeats") {
+            const char* v = value();
+            if (!v) { usage(); return 2; }
+            bench.repeats = std::max(1, std::atoi(v));
+        } else if (arg == "--image") {
+            const char* v = value();
+            if (!v || std::sscanf(v, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                usage();
+                return 2;
+            }
+        } else if (arg == "--no-gl") {
+            useGL = false;
+        } else if (arg == "--json") {
+            const char* v = value();
+            if (!v) { usage(); return 2; }
+            jsonPath = v;
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    // With --json -, the table goes to stderr so stdout is pure JSON
+    if (jsonPath == "-") g_table = stderr;
+
+    std::error_code ec;
+    fs::path scratch = fs::temp_directory_path(ec) / "stl_bench";
+    fs::create_directories(scratch, ec);
+
+    GLFWwindow* window = nullptr;
+    Renderer renderer;
+    std::string glRenderer;
+    if (useGL) {
+        window = createHiddenContext();
+        if (window && renderer.init()) {
+            glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        } else {
+            std::cerr << "No OpenGL 3.3 context; skipping upload / render / PNG cases" << std::endl;
+            useGL = false;
+        }
+    }
+
+    std::fprintf(g_table, "stl_bench: %u hardware threads, %s kernels, GL %s, %d samples per case\n",
+                Parallel::threadCount(), MeshKernels::best().name,
+                glRenderer.empty() ? "off" : glRenderer.c_str(), bench.repeats);
+
+    auto benchInput = [&](const std::string& input, const std::vector<std::pair<std::string, std::string>>& paths) {
+        std::fprintf(g_table, "\n%s\n", input.c_str());
+        for (const auto& [format, path] : paths) benchLoads(bench, input, format, path, scratch);
+
+        STLModel base;
+        if (!base.load(paths.front().second)) return;
+        benchStages(bench, input, base, 0);
+        if (useGL) benchGL(bench, input, base, renderer, width, height, scratch);
+    };
+
+    for (size_t size : sizes) {
+        if (size == 0) continue;
+        std::vector<Triangle> tris = makeTorus(size);
+        std::string input = "synthetic-" + std::to_string(size);
+        std::string bin = (scratch / (input + "-binary.stl")).string();
+        std::string txt = (scratch / (input + "-ascii.stl")).string();
+        if (!writeBinarySTL(bin, tris) || !writeASCIISTL(txt, tris)) {
+            std::cerr << "Cannot write synthetic meshes to " << scratch.string() << std::endl;
+            return 1;
+        }
+        benchInput(input, {{"binary", bin}, {"ascii", txt}});
+        fs::remove(bin, ec);
+        fs::remove(txt, ec);
+    }
+
+    for (const auto& file : files) {
+        STLFileInfo info;
+        if (!probeSTLFile(file, info)) {
+            std::cerr << "Cannot read: " << file << std::endl;
+            continue;
+        }
+        benchInput(fs::path(file).filename().string(), {{info.binary ? "binary" : "ascii", file}});
+    }
+
+    fs::remove_all(scratch, ec);
+    if (window) {
+        renderer.shutdown();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+
+    bool ok = std::all_of(bench.cases.begin(), bench.cases.end(), [](const Case& c) { return c.ok; });
+    if (!jsonPath.empty()) {
+        std::string json = toJSON(bench, glRenderer, width, height);
+        if (jsonPath == "-") {
+            std::fwrite(json.data(), 1, json.size(), stdout);
+        } else {
+            std::ofstream out(jsonPath);
+            out << json;
+            if (!out) {
+                std::cerr << "Cannot write: " << jsonPath << std::endl;
+                return 1;
+            }
+            std::fprintf(g_table, "\nWrote %s\n", jsonPath.c_str());
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Headless batch export: `stl_viewer --export <dir|file> [--out <dir>] ...`
+// renders every input to PNG from a hidden/offscreen GL context, without
+// ImGui, and exits with one of the codes below.
+
+namespace BatchCLI {
+
+enum ExitCode {
+    kExitOk        = 0,   // Every input exported
+    kExitFailed    = 1,   // At least one input failed to load or export
+    kExitUsage     = 2,   // Bad flags or config file
+    kExitNoContext = 3,   // No OpenGL 3.3 context could be created
+};
+
+// True if the command line asks for batch mode (--export or --help)
+bool requested(int argc, char** argv);
+
+// Parse flags, export, and return the process exit code
+int run(int argc, char** argv);
+
+} // namespace BatchCLI
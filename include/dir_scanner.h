@@ -0,0 +1,88 @@
+#pragma once
+
+#include "stl_loader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Parallel folder scanning. Worker threads take directories and batches of
+// found files from a shared queue: a directory task lists one folder (queuing
+// its subfolders when recursive), a file task reads each hit's 84-byte header
+// (probeSTLFile). Hits stream out as they are found; the GL thread polls
+// takeFound() once per frame, so a big folder fills the list while the walk
+// is still running.
+
+struct ScanHit {
+    uint64_t    scanId = 0;
+    std::string path;
+    STLFileInfo info;
+    bool        probed = false;   // Header read; false for unreadable files or unprobed scans
+};
+
+class DirScanner {
+public:
+    explicit DirScanner(unsigned workers = 0);   // 0 = 2 per hardware thread, at most 16
+    ~DirScanner();                               // Cancels outstanding scans and joins
+
+    DirScanner(const DirScanner&) = delete;
+    DirScanner& operator=(const DirScanner&) = delete;
+
+    // Start walking `directory`; with probe == false hits carry only their path
+    uint64_t scan(const std::string& directory, bool recursive, bool probe = true);
+    void     cancel(uint64_t id);
+    void     cancelAll();
+
+    // GL thread: hits found since the last call, in discovery order
+    std::vector<ScanHit> takeFound();
+
+    // Blocking variant: waits until hits are ready (empty only when no scan is left)
+    std::vector<ScanHit> waitFound();
+
+    bool   scanning(uint64_t id) const;
+    size_t pending() const;   // Scans still running
+
+private:
+    struct Scan {
+        uint64_t          id = 0;
+        bool              recursive = false;
+        bool              probe     = true;
+        size_t            tasks     = 0;   // Queued or running, guarded by mutex_
+        std::atomic<bool> cancel{false};
+    };
+
+    struct Task {
+        std::shared_ptr<Scan>    scan;
+        std::string              directory;   // Directory task when set
+        std::vector<std::string> files;       // ... else headers to read
+    };
+
+    void workerLoop();
+    void listDirectory(const std::shared_ptr<Scan>& scan, const std::string& directory);
+    void probeFiles(const std::shared_ptr<Scan>& scan, const std::vector<std::string>& files);
+    void finishTask(const std::shared_ptr<Scan>& scan);
+
+    mutable std::mutex                 mutex_;
+    std::condition_variable            wake_;
+    std::condition_variable            foundCv_;
+    std::deque<Task>                   files_;   // Served first: they are what callers wait on
+    std::deque<Task>                   dirs_;
+    std::vector<std::shared_ptr<Scan>> scans_;   // Running
+    std::vector<ScanHit>               found_;
+    std::vector<std::thread>           workers_;
+    uint64_t                           nextId_   = 1;
+    bool                               stopping_ = false;
+};
+
+// True for paths ending in ".stl" in any case (no lowercased copy)
+bool isSTLPath(const std::string& path);
+
+// Collect all .stl files in a directory (optionally recursive), sorted.
+// Blocking; walks the tree with a DirScanner without reading headers.
+std::vector<std::string> findSTLFiles(const std::string& directory, bool recursive = false);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "export_pipeline.h"
+#include "renderer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+// Batch export on several GL contexts at once. Each worker gets a hidden
+// window (its context), a thread, its own Renderer — shaders, mesh cache
+// and FBO are per instance — and an ExportPipeline, and all of them take
+// items from one ExportQueue, so the batch spreads itself over however
+// fast each context turns out to be.
+//
+// GLFW has no way to choose the GPU behind a context; they all land on the
+// driver's default device. Several contexts there still overlap one
+// worker's CPU-side stages (load, readback, encode) with another's draws.
+// To use more GPUs, run one process per GPU with BatchCLI's --shard.
+//
+// Construct and destroy on the main thread (GLFW's window rules), with
+// GLEW already initialised: contexts from one driver share entry points.
+class ExportFarm {
+public:
+    // Creates `contexts` hidden windows from the current GLFW hints; fewer
+    // workers start if some can't be created (see workers()).
+    ExportFarm(unsigned contexts, const RenderSettings& settings, std::vector<ExportItem> items,
+               const ExportPipelineOptions& options, VertexFormat vertexFormat);
+    ~ExportFarm();   // Cancels, joins, destroys the windows
+
+    ExportFarm(const ExportFarm&) = delete;
+    ExportFarm& operator=(const ExportFarm&) = delete;
+
+    size_t workers()   const { return workers_.size(); }
+    size_t total()     const { return queue_->size(); }
+    size_t succeeded() const;
+    size_t failed()    const;
+    size_t completed() const { return succeeded() + failed(); }
+    bool   finished()  const;
+
+    void cancel() { stop_ = true; }
+    void wait();
+
+private:
+    struct Worker {
+        GLFWwindow*          window = nullptr;
+        std::thread          thread;
+        mutable std::mutex   mutex;              // Guards `pipeline` while it's published
+        ExportPipeline*      pipeline = nullptr;
+        size_t               succeeded = 0;      // Final counts once `pipeline` is gone
+        size_t               failed    = 0;
+        std::atomic<bool>    done{false};
+    };
+
+    void workerLoop(Worker& worker);
+
+    RenderSettings               settings_;
+    ExportPipelineOptions        options_;
+    VertexFormat                 vertexFormat_;
+    std::shared_ptr<ExportQueue> queue_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool>            stop_{false};
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "exporter.h"
+#include "load_queue.h"
+#include "renderer.h"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Pipelined batch export. Four stages run concurrently:
+//   load    — LoadQueue workers parse upcoming models (bounded prefetch)
+//   render  — GL thread draws into the offscreen FBO
+//   readback— glReadPixels into a ring of PBOs, completion tracked by fences
+//   encode  — image compression + file write on a thread pool
+// so a long batch runs at the speed of its slowest stage rather than the sum.
+// All methods must be called on the thread that owns the renderer's context.
+
+struct ExportItem {
+    std::string                     input;    // STL path (loaded if `model` is null)
+    std::string                     output;   // Image path (unused with a raw sink)
+    std::shared_ptr<const STLModel> model;    // Optional, already in memory
+};
+
+// The batch, shared by every pipeline working on it: each takes the next
+// untaken item whenever its prefetch window has room, so faster contexts
+// simply take more. Items are whole models, coarse enough that one atomic
+// cursor balances as well as per-worker deques with stealing would.
+class ExportQueue {
+public:
+    explicit ExportQueue(std::vector<ExportItem> items) : items_(std::move(items)) {}
+
+    bool take(size_t& index) {
+        size_t i = next_.fetch_add(1);
+        if (i >= items_.size()) return false;
+        index = i;
+        return true;
+    }
+
+    const ExportItem& operator[](size_t index) const { return items_[index]; }
+    size_t size()      const { return items_.size(); }
+    bool   exhausted() const { return next_ >= items_.size(); }
+
+private:
+    std::vector<ExportItem> items_;
+    std::atomic<size_t>     next_{0};
+};
+
+struct ExportPipelineOptions {
+    unsigned loadWorkers   = 0;   // 0 = LoadQueue default
+    unsigned encodeThreads = 0;   // 0 = hardware threads - 1 (at least 1)
+    size_t   prefetch      = 8;   // Models parsed ahead of the renderer
+    size_t   readbackSlots = 3;   // PBOs in the readback ring
+    LoadOptions loadOptions;
+    Exporter::ExportFormat format;   // png.threads = 0 becomes 1: the pool is the parallelism
+
+    // ImageFormat::Raw only: frames are written here back to back, in item
+    // order, instead of to per-item files. Models that fail to load are skipped.
+    FILE* rawSink = nullptr;
+
+    // Multi-view: each model is uploaded once and drawn from every pose into
+    // tiles of one exportWidth x exportHeight-per-tile sheet, read back once.
+    // The sheet is written as-is, or split into `<name>_NNN` frames.
+    std::vector<ViewPose> views;          // Empty = the settings' single camera
+    int                   sheetColumns = 0;   // 0 = roughly square
+    bool                  splitViews   = false;
+
+    // Tiled rendering for images past the GL size limit (PNG or raw only):
+    // tiles of this size, streamed a band at a time so the full image never
+    // sits in memory. 0 = only when needed, at Renderer::kDefaultTileSize.
+    int tileSize = 0;
+};
+
+class ExportPipeline {
+public:
+    ExportPipeline(Renderer& renderer, const RenderSettings& settings,
+                   std::vector<ExportItem> items, const ExportPipelineOptions& options = {});
+    // Work on a queue shared with pipelines on other contexts (ExportFarm);
+    // counts then cover only the items this pipeline took
+    ExportPipeline(Renderer& renderer, const RenderSettings& settings,
+                   std::shared_ptr<ExportQueue> queue, const ExportPipelineOptions& options = {});
+    ~ExportPipeline();   // Cancels anything outstanding and waits for encoders
+
+    ExportPipeline(const ExportPipeline&) = delete;
+    ExportPipeline& operator=(const ExportPipeline&) = delete;
+
+    // Advance every stage without blocking on more than one fence; returns
+    // false once all items are written. GUI callers run this once per frame.
+    bool step();
+
+    // Block until the batch is finished (headless use). Setting `stop`
+    // from another thread cancels it.
+    void run(const std::atomic<bool>* stop = nullptr);
+
+    void cancel();
+
+    size_t total()     const { return queue_->size(); }
+    size_t completed() const { return succeeded_ + failed_; }
+    size_t succeeded() const { return succeeded_; }
+    size_t failed()    const { return failed_; }
+    bool   finished()  const;
+    bool   valid()     const { return encoder_ != nullptr; }   // False if the format isn't built in
+
+private:
+    struct Slot {
+        GLuint pbo   = 0;
+        GLsync fence = nullptr;
+        size_t item  = 0;
+        bool   busy  = false;
+    };
+
+    struct EncodeTask {
+        std::vector<unsigned char> pixels;   // Top-down RGBA
+        std::string                path;
+    };
+
+    bool feedLoads();
+    bool collectLoads(bool block);
+    void failAll(const char* reason);
+    bool renderReady();
+    bool renderTiledReady();
+    bool retireReadbacks(bool block);
+    bool writeRaw(const EncodeTask& task);
+    bool writeFile(const EncodeTask& task);
+    void submitEncode(EncodeTask task);
+    void encoderLoop();
+
+    Renderer&              renderer_;
+    RenderSettings         settings_;
+    std::shared_ptr<ExportQueue> queue_;
+    ExportPipelineOptions  options_;
+    SheetLayout            layout_;            // 1x1 without multi-view
+    size_t                 frameBytes_ = 0;    // One readback (the whole sheet)
+    bool                   tiled_ = false;     // No PBO ring or encoders; see renderTiledReady()
+    std::unique_ptr<Exporter::ImageEncoder> encoder_;
+
+    // Load stage
+    LoadQueue                            loader_;
+    std::unordered_map<uint64_t, size_t> loading_;    // Job id -> item
+    struct Ready { size_t item; std::shared_ptr<const STLModel> model; };   // Null model: load failed
+    std::deque<Ready>                    ready_;
+    size_t                               nextRender_ = 0;   // Raw sink: next item in stream order
+
+    // Readback stage (ring order: oldest slot first)
+    std::vector<Slot> slots_;
+    size_t            slotHead_ = 0;   // Oldest busy slot
+    size_t            slotTail_ = 0;   // Next slot to fill
+    size_t            slotsBusy_ = 0;
+
+    // Encode stage
+    std::mutex              encodeMutex_;
+    std::condition_variable encodeWake_;
+    std::condition_variable encodeDone_;
+    std::deque<EncodeTask>  encodeQueue_;
+    size_t                  encodeLimit_ = 0;   // Backpressure: frames waiting to encode
+    std::vector<std::thread> encoders_;
+    bool                    stopping_ = false;
+
+    std::atomic<size_t> encoding_{0};    // Queued or being written
+    std::atomic<size_t> succeeded_{0};
+    std::atomic<size_t> failed_{0};
+    bool                cancelled_ = false;
+};
@@ -1,17 +1,118 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace Exporter {
 
+enum class PNGCompression {
+    Fast,       // zlib level 1, RLE strategy, Sub filter
+    Balanced,   // zlib level 6, adaptive per-row filter
+    Small,      // zlib level 9, adaptive per-row filter
+};
+
+enum class AlphaMode {
+    Auto,   // Write RGB when every pixel is opaque
+    Keep,   // Always RGBA
+    Drop,   // Always RGB
+};
+
+struct PNGOptions {
+    PNGCompression compression = PNGCompression::Balanced;
+    AlphaMode      alpha       = AlphaMode::Auto;
+    unsigned       threads     = 0;   // Strips deflated in parallel; 0 = one per hardware thread
+};
+
+enum class ImageFormat {
+    PNG,    // Lossless, see PNGOptions
+    QOI,    // Lossless, several times faster than PNG at a larger size
+    JPEG,   // Lossy thumbnails (stb_image_write)
+    WebP,   // Lossy thumbnails (needs a build with STL_VIEWER_WITH_WEBP)
+    Raw,    // Headerless top-down RGBA/RGB frames, for streaming to a pipe
+};
+
+struct ExportFormat {
+    ImageFormat format  = ImageFormat::PNG;
+    PNGOptions  png;            // PNG settings; png.alpha also applies to QOI / Raw
+    int         quality = 90;   // JPEG / WebP, 1-100
+};
+
+// Encoders are stateless after construction; encode() may be called from
+// several threads at once.
+class ImageEncoder {
+public:
+    virtual ~ImageEncoder() = default;
+    virtual const char* extension() const = 0;   // Without the dot
+    virtual bool encode(int width, int height,
+                        const std::vector<unsigned char>& pixels,   // Top-down RGBA
+                        std::vector<unsigned char>& out) const = 0;
+};
+
+// Null if the format isn't compiled in (WebP)
+std::unique_ptr<ImageEncoder> makeEncoder(const ExportFormat& format);
+
+bool        formatAvailable(ImageFormat format);
+const char* formatExtension(ImageFormat format);
+
+// Parse "png" / "qoi" / "jpeg" (or "jpg") / "webp" / "raw"
+bool parseFormat(const std::string& name, ImageFormat& out);
+
+// Encode and write one image file
+bool saveImage(const std::string& filepath,
+               int width, int height,
+               const std::vector<unsigned char>& pixels,
+               const ImageEncoder& encoder);
+
+// Encode top-down RGBA pixels to an in-memory PNG. Rows are split into
+// strips that are filtered and deflated independently (each primed with the
+// previous strip's last 32 KB), then stitched into one zlib stream.
+bool encodePNG(int width, int height,
+               const std::vector<unsigned char>& pixels,
+               const PNGOptions& options,
+               std::vector<unsigned char>& out);
+
+// Writes a PNG a band of rows at a time, for images too large to hold in
+// memory whole. Output matches encodePNG() except that AlphaMode::Auto keeps
+// alpha (rows can't be scanned before the header is written); pass Drop
+// when the image is known to be opaque. An unfinished file is deleted.
+class PNGStreamWriter {
+public:
+    PNGStreamWriter();
+    ~PNGStreamWriter();
+    PNGStreamWriter(const PNGStreamWriter&) = delete;
+    PNGStreamWriter& operator=(const PNGStreamWriter&) = delete;
+
+    bool open(const std::string& filepath, int width, int height, const PNGOptions& options = {});
+    bool writeRows(const unsigned char* rgba, int rows);   // Next `rows` top-down RGBA rows
+    bool finish();                                         // False unless every row was written
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+    std::string            path_;
+    bool                   keepAlpha_ = true;
+};
+
 // Save RGBA pixel buffer to PNG
 bool savePNG(const std::string& filepath,
              int width, int height,
-             const std::vector<unsigned char>& pixels);
+             const std::vector<unsigned char>& pixels,
+             const PNGOptions& options = {});
+
+// Parse "fast" / "balanced" / "small"
+bool parseCompression(const std::string& name, PNGCompression& out);
 
-// Derive output path: replace .stl extension with .png, optionally into a different directory
+// Derive output path: replace .stl extension with the format's, optionally into a different directory
 std::string deriveOutputPath(const std::string& stlPath,
-                             const std::string& outputDir = "");
+                             const std::string& outputDir = "",
+                             ImageFormat format = ImageFormat::PNG);
+
+// Copy the w x h region at (x, y) out of a top-down RGBA image
+void cropImage(const std::vector<unsigned char>& pixels, int imageWidth,
+               int x, int y, int w, int h, std::vector<unsigned char>& out);
+
+// "out/part.png", 7 -> "out/part_007.png" (one file per multi-view frame)
+std::string framePath(const std::string& path, size_t index);
 
 } // namespace Exporter
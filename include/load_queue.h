@@ -0,0 +1,93 @@
+#pragma once
+
+#include "stl_loader.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background STL loading. Worker threads parse models; the GL thread polls
+// takeFinished() once per frame and uploads whatever arrived. Jobs asking to
+// be shown go first, then the largest `sizeHint` (file bytes): starting the
+// long loads early keeps one big part from finishing a batch on its own.
+
+enum class LoadState { Queued, Loading, Done, Failed, Cancelled };
+
+struct LoadJobStatus {
+    uint64_t    id = 0;
+    std::string filename;
+    LoadState   state    = LoadState::Queued;
+    float       progress = 0.0f;
+};
+
+struct LoadResult {
+    uint64_t    id = 0;
+    std::string path;
+    LoadState   state  = LoadState::Failed;   // Done, Failed or Cancelled
+    bool        select = false;               // Caller asked to show it when ready
+    STLModel    model;                        // Valid when state == Done
+};
+
+class LoadQueue {
+public:
+    explicit LoadQueue(unsigned workers = 0);   // 0 = min(4, hardware threads)
+    ~LoadQueue();                               // Cancels outstanding jobs and joins
+
+    LoadQueue(const LoadQueue&) = delete;
+    LoadQueue& operator=(const LoadQueue&) = delete;
+
+    uint64_t enqueue(const std::string& path, const LoadOptions& options, bool select = false,
+                     uint64_t sizeHint = 0);
+    void     cancel(uint64_t id);
+    void     cancelAll();
+
+    // GL thread: results completed since the last call, in completion order
+    std::vector<LoadResult> takeFinished();
+
+    // Blocking variant for non-GUI callers: waits until at least one result
+    // is ready (returns empty only when nothing is pending)
+    std::vector<LoadResult> waitFinished();
+
+    // Jobs still queued or loading, in submission order (for the UI)
+    std::vector<LoadJobStatus> status() const;
+    size_t pending() const;
+
+private:
+    struct Job {
+        uint64_t     id = 0;
+        std::string  path;
+        LoadOptions  options;
+        bool         select   = false;
+        uint64_t     sizeHint = 0;
+        LoadState    state    = LoadState::Queued;
+        LoadProgress progress;
+    };
+
+    // priority_queue order: the job that should run next compares greatest
+    struct JobOrder {
+        bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+            if (a->select != b->select) return b->select;
+            if (a->sizeHint != b->sizeHint) return a->sizeHint < b->sizeHint;
+            return a->id > b->id;   // Otherwise first come, first served
+        }
+    };
+    using JobHeap =
+        std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, JobOrder>;
+
+    void workerLoop();
+
+    mutable std::mutex                 mutex_;
+    std::condition_variable            wake_;
+    std::condition_variable            finishedCv_;
+    JobHeap                            queued_;
+    std::vector<std::shared_ptr<Job>>  active_;     // Queued + loading, for status()
+    std::vector<LoadResult>            finished_;
+    std::vector<std::thread>           workers_;
+    uint64_t                           nextId_   = 1;
+    bool                               stopping_ = false;
+};
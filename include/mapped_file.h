@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file (mmap on POSIX, MapViewOfFile on
+// Windows). open() fails for anything that isn't a regular, non-empty file,
+// so callers can fall back to stream reads for pipes and odd filesystems.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& filepath);
+    void close();
+
+    bool        isOpen() const { return data_ != nullptr; }
+    const char* data()   const { return data_; }
+    size_t      size()   const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t      size_ = 0;
+#ifdef _WIN32
+    void*       fileHandle_    = nullptr;
+    void*       mappingHandle_ = nullptr;
+#endif
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "stl_loader.h"
+
+#include <string>
+
+// On-disk cache of load() results: the GL-ready vertex / index arrays,
+// bounds and BVH of one STL file as processed with one set of LoadOptions.
+// Entries are keyed by the file's absolute path and the options that change
+// the output (weld, BVH); they're stale once the file's size or modification
+// time changes. Files are a fixed header followed by the raw arrays at
+// 64-byte offsets, in native byte order, so a hit is one mapping and one
+// copy per array instead of a parse.
+
+namespace MeshCache {
+
+constexpr uint32_t kVersion = 1;
+
+// Per-user default: $XDG_CACHE_HOME or ~/.cache, %LOCALAPPDATA% on Windows
+std::string defaultDirectory();
+
+// The cache file for `stlPath` under options.cacheDir
+std::string entryPath(const std::string& stlPath, const LoadOptions& options);
+
+// Fill `model`'s GL data from a fresh entry; false on a miss or a stale,
+// truncated or foreign-format file
+bool load(const std::string& stlPath, const LoadOptions& options, STLModel& model);
+
+// Write (or replace) the entry for a just-loaded model. Written to a
+// temporary file and renamed, so readers never see a partial entry.
+bool save(const std::string& stlPath, const LoadOptions& options, const STLModel& model);
+
+// Delete every entry in `directory`; returns how many were removed
+size_t clear(const std::string& directory);
+
+} // namespace MeshCache
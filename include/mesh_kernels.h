@@ -0,0 +1,34 @@
+#pragma once
+
+#include "stl_loader.h"
+
+#include <cstddef>
+#include <vector>
+
+// Post-decode triangle pass shared by the binary and ASCII loaders and
+// buildGLData(): recompute all-zero facet normals, grow the bounds and write
+// the interleaved [nx, ny, nz, vx, vy, vz] x 3 layout, all in one read of
+// each triangle. SIMD variants (SSE2 / AVX2 on x86-64, NEON on AArch64) are
+// picked once at runtime from the CPU's features.
+
+namespace MeshKernels {
+
+// `count` triangles laid out as 48-byte [normal, v0, v1, v2] records, each
+// `stride` bytes after the previous (50 for binary STL, sizeof(Triangle) for
+// Triangle arrays). Writes count * 18 floats to `out` and grows `box`, which
+// must be reset() or already hold points.
+using EmitFn = void (*)(const char* src, size_t stride, size_t count, float* out, BoundingBox& box);
+
+struct Kernel {
+    const char* name;
+    EmitFn      emit;
+};
+
+// The fastest variant this CPU runs; STL_VIEWER_SIMD=scalar|sse2|avx2|neon
+// in the environment overrides it (for comparisons)
+const Kernel& best();
+
+// Every variant this CPU runs, scalar first (benchmarks)
+std::vector<Kernel> available();
+
+} // namespace MeshKernels
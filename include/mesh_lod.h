@@ -0,0 +1,80 @@
+#pragma once
+
+#include "stl_loader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Level-of-detail meshes for interactive viewing. Levels come from quadric
+// error metric vertex clustering: positions are snapped to a grid, each cell's
+// vertices collapse to the point that minimises the summed plane distances of
+// their faces, and triangles with two corners in one cell disappear. Unlike
+// edge-collapse decimation every pass is a plain parallel loop, so a 50M
+// triangle mesh simplifies in seconds on the loader's thread.
+
+struct LodOptions {
+    float    reduction    = 0.25f;    // Target triangles of each level vs the previous
+    size_t   minTriangles = 20000;    // Stop once a level is this small
+    size_t   maxLevels    = 6;
+    unsigned threads      = 0;        // 0 = hardware concurrency
+};
+
+// Simplify `source` on a grid of `resolution` cells along its longest side
+// into an indexed, smooth-shaded mesh in the same coordinates (and bounds).
+// False if cancelled or if nothing survives.
+bool simplifyMesh(const STLModel& source, int resolution, STLModel& out,
+                  unsigned threads = 0, const std::atomic<bool>* cancel = nullptr);
+
+// Successively coarser levels of `model`, finest first; empty if the model is
+// already below options.minTriangles or the build was cancelled
+std::vector<std::shared_ptr<const STLModel>> buildLodChain(const STLModel& model, const LodOptions& options = {},
+                                                           const std::atomic<bool>* cancel = nullptr);
+
+struct LodResult {
+    uint64_t id = 0;
+    std::vector<std::shared_ptr<const STLModel>> levels;   // Empty if cancelled
+};
+
+// Builds LOD chains in the background, one model at a time (each build is
+// itself parallel). Same polling contract as LoadQueue.
+class LodBuilder {
+public:
+    LodBuilder();
+    ~LodBuilder();   // Cancels outstanding builds and joins
+
+    LodBuilder(const LodBuilder&) = delete;
+    LodBuilder& operator=(const LodBuilder&) = delete;
+
+    uint64_t enqueue(std::shared_ptr<const STLModel> model, const LodOptions& options = {});
+    void     cancel(uint64_t id);
+    void     cancelAll();
+
+    // GL thread: chains completed since the last call
+    std::vector<LodResult> takeFinished();
+    size_t pending() const;
+
+private:
+    struct Job {
+        uint64_t                        id = 0;
+        std::shared_ptr<const STLModel> model;
+        LodOptions                      options;
+    };
+
+    void workerLoop();
+
+    mutable std::mutex      mutex_;
+    std::condition_variable wake_;
+    std::deque<Job>         queue_;
+    std::vector<LodResult>  finished_;
+    uint64_t                nextId_  = 1;
+    uint64_t                running_ = 0;   // Id of the build in progress
+    std::atomic<bool>       cancelRunning_{false};
+    bool                    stopping_ = false;
+    std::thread             worker_;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+// Resolve a requested thread count (0 = one per hardware thread)
+inline unsigned threadCount(unsigned requested = 0) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+// Number of chunks forChunks() will use for `count` items
+inline size_t chunkCount(size_t count, size_t minChunk, unsigned threads) {
+    if (count == 0) return 0;
+    size_t byMin = std::max<size_t>(1, count / std::max<size_t>(1, minChunk));
+    return std::min<size_t>(byMin, threadCount(threads));
+}
+
+// Split [0, count) into contiguous chunks of at least `minChunk` items (at
+// most one per thread) and call fn(begin, end, chunkIndex) for each. The
+// first chunk runs on the calling thread, so small inputs never spawn.
+template <typename Fn>
+size_t forChunks(size_t count, size_t minChunk, unsigned threads, Fn&& fn) {
+    size_t chunks = chunkCount(count, minChunk, threads);
+    if (chunks == 0) return 0;
+
+    auto range = [&](size_t c, size_t& b, size_t& e) {
+        b = count * c / chunks;
+        e = count * (c + 1) / chunks;
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t b, e;
+        range(c, b, e);
+        workers.emplace_back([&fn, b, e, c] { fn(b, e, c); });
+    }
+
+    size_t b, e;
+    range(0, b, e);
+    fn(b, e, size_t(0));
+
+    for (auto& t : workers) t.join();
+    return chunks;
+}
+
+} // namespace Parallel
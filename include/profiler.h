@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Scoped CPU timers for the load / render / export hot paths. Every scope
+// updates its name's latest duration (shown by the viewer's performance
+// overlay); while tracing is on, each one is also kept as an event for a
+// Chrome trace (chrome://tracing, Perfetto). Names are "group.stage" string
+// literals, e.g. "load.parse"; scopes are meant for stages, not inner loops.
+// A group with a "<group>.total" scope has runs: one total and the stages its
+// thread finished inside it (one model load, one viewport redraw).
+
+namespace Profiler {
+
+using Clock = std::chrono::steady_clock;
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(name), start_(Clock::now()) {}
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char*       name_;
+    Clock::time_point start_;
+};
+
+// Record a finished interval directly (e.g. one measured elsewhere)
+void record(const char* name, Clock::time_point start, Clock::time_point end);
+
+struct StageTime {
+    std::string       name;   // Without the group prefix
+    double            ms = 0.0;
+    Clock::time_point when;   // When it last finished
+    bool              stale = false;   // Not part of the group's latest run
+};
+
+// Every stage of "<group>.*", in first-seen order. For a group with runs these
+// are the latest run's own times, even if other threads have finished newer
+// ones since (concurrent loads); stages that run skipped keep their newest
+// time from anywhere and are marked stale. Without runs: each stage's latest.
+std::vector<StageTime> lastTimes(const std::string& group);
+
+// Trace events are kept (up to a fixed count, oldest dropped) only while on
+void   setTracing(bool enabled);
+bool   tracing();
+size_t traceEventCount();
+void   clearTrace();
+
+// Chrome trace event format ("X" events, microseconds); false on I/O error
+bool writeChromeTrace(const std::string& path);
+
+} // namespace Profiler
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)   Profiler::Scope PROFILE_CONCAT(profileScope_, __LINE__)(name)
@@ -3,6 +3,12 @@
 #include "stl_loader.h"
 #include <GL/glew.h>
 
+#include <array>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 struct RenderSettings {
     // Camera
     float elevation   = 30.0f;
@@ -24,43 +30,372 @@ struct RenderSettings {
 
     // Display
     bool  wireframe      = false;
-    float edgeWidth       = 1.0f;
+    float edgeWidth       = 1.0f;    // Pixels
+    bool  lineWireframe  = false;    // Second GL_LINE pass instead of shader edges in the solid pass
 
     // Export
     int   exportWidth    = 1920;
     int   exportHeight   = 1080;
 };
 
+// Whether two settings draw the same viewport image (field by field; the
+// export size doesn't count)
+bool sameView(const RenderSettings& a, const RenderSettings& b);
+
+// One camera angle of a multi-view render; distance / fov come from RenderSettings
+struct ViewPose {
+    float elevation = 0.0f;
+    float azimuth   = 0.0f;
+};
+
+// `count` poses evenly spaced around the model, starting at the settings' azimuth
+std::vector<ViewPose> turntablePoses(const RenderSettings& settings, int count);
+
+// Tiles of a multi-view sprite sheet, row-major from the top-left
+struct SheetLayout {
+    int tileWidth  = 0;
+    int tileHeight = 0;
+    int columns    = 1;
+    int rows       = 1;
+
+    int width()  const { return tileWidth * columns; }
+    int height() const { return tileHeight * rows; }
+};
+
+// columns = 0 picks a roughly square sheet
+SheetLayout sheetLayout(size_t views, int tileWidth, int tileHeight, int columns = 0);
+
+// GPU vertex layout used by uploadModel
+enum class VertexFormat {
+    Float,     // 24 B/vertex: float normal + float position
+    Compact    // 12 B/vertex: 2_10_10_10 normal + 16-bit position quantized to the bounds
+};
+
+// Identifies a model's GPU buffers in the residency cache (STLModel::revision)
+using MeshHandle = uint64_t;
+
 class Renderer {
 public:
     bool init();
     void shutdown();
 
-    void uploadModel(const STLModel& model);
+    // Takes effect for meshes uploaded from now on
+    void setVertexFormat(VertexFormat format);
+    VertexFormat getVertexFormat() const { return vertexFormat; }
+
+    // Make `model` resident (uploading only if it isn't already) and select it
+    // for render(). Switching back to a cached model costs no upload.
+    MeshHandle uploadModel(const STLModel& model);
+
+    // Make `model` resident without changing the current mesh
+    MeshHandle acquire(const STLModel& model);
+
+    // Make an already-resident mesh current; false (and nothing current) if
+    // it was evicted. Lets callers show a mesh whose CPU data is gone.
+    bool select(MeshHandle handle);
+
+    // Progressive display of a load in progress (LoadOptions::stream): the
+    // vertex buffer is allocated at its final size and filled as the loader
+    // publishes runs, and render() draws whatever has arrived. Always the
+    // Float layout (Compact quantizes to bounds that aren't final yet) and
+    // never culled. beginStream() returns 0 until the loader has sized the
+    // stream and doesn't change the current mesh; updateStream() uploads the
+    // runs published since its last call, false once the mesh was evicted.
+    MeshHandle beginStream(LoadStream& stream);
+    bool       updateStream(MeshHandle handle, LoadStream& stream);
+    size_t     streamedTriangles(MeshHandle handle) const;
+
+    bool isResident(MeshHandle handle) const { return meshes.count(handle) != 0; }
+    void evict(MeshHandle handle);
+    void evictAll();
+
+    // Least-recently-used meshes are freed once resident bytes exceed this.
+    // The current mesh and the one being uploaded are never evicted.
+    void   setVramBudget(size_t bytes);
+    size_t getVramBudget() const { return vramBudget; }
+    size_t residentBytes() const { return residentTotal; }
+    size_t residentCount() const { return meshes.size(); }
+    size_t meshBytes(MeshHandle handle) const;   // VBO + EBO of a mesh and its LODs
+
+    // GPU time of the solid and wireframe passes of on-screen render()s, from
+    // timer queries read back a couple of frames late so nothing stalls.
+    // Negative until a result is in, or when that pass didn't run.
+    struct GpuTimes {
+        float solidMs = -1.0f;
+        float wireMs  = -1.0f;
+    };
+    void     setGpuTiming(bool enabled);
+    GpuTimes lastGpuTimes() const { return gpuTimes; }
+
+    // Draw the current mesh, or any resident mesh by handle
     void render(const RenderSettings& settings, int viewportWidth, int viewportHeight);
+    void render(MeshHandle handle, const RenderSettings& settings, int viewportWidth, int viewportHeight);
 
-    // Offscreen render to framebuffer for export
+    // Window drawing through a cached image: render() (or renderScene())
+    // goes into a width x height offscreen texture only when `redraw` is set
+    // or the size changed, and the texture is then blitted to the default
+    // framebuffer at (0, 0) under the caller's scissor. Frames where only
+    // the UI changed cost a blit instead of the mesh. True if it redrew.
+    bool drawViewport(const RenderSettings& settings, int width, int height, bool scene, bool redraw);
+
+    // Bumped whenever what render() / renderScene() would draw changes for
+    // reasons other than the settings or viewport size: another current
+    // mesh, uploads, streamed runs, LODs, evictions, the scene
+    uint64_t drawGeneration() const { return generation; }
+
+    // Render into the offscreen framebuffer and leave it bound as the read
+    // framebuffer, so the caller can issue its own (e.g. PBO) readback.
+    // The image is drawn upside down through a Y-flipped projection, so
+    // glReadPixels returns rows top-down with no CPU flip.
+    // Pair with endOffscreen(). Does not change the current mesh. The target
+    // persists between calls and is only reallocated when the size changes,
+    // so back-to-back renders at one resolution create no GL objects.
+    bool renderOffscreen(const STLModel& model, const RenderSettings& settings,
+                         int width, int height);
+    void endOffscreen();
+
+    // Offscreen render to framebuffer for export (does not change the current mesh)
     bool renderToBuffer(const STLModel& model, const RenderSettings& settings,
                         int width, int height,
                         std::vector<unsigned char>& pixels);
 
+    // Multi-view: one upload, every pose drawn into its tile of a single
+    // layout.width() x layout.height() target, so a turntable costs one
+    // readback instead of one per angle. Same binding contract as
+    // renderOffscreen(). Fails if the sheet exceeds the GL size limit.
+    bool renderViewsOffscreen(const STLModel& model, const RenderSettings& settings,
+                              const std::vector<ViewPose>& poses, const SheetLayout& layout);
+    bool renderViewsToBuffer(const STLModel& model, const RenderSettings& settings,
+                             const std::vector<ViewPose>& poses, const SheetLayout& layout,
+                             std::vector<unsigned char>& pixels);
+
+    // Poster-size export past the GL size limit: draws a width x height image
+    // as tiles through sub-frustums of the full projection, reusing one
+    // tile-sized target. Each band of tile rows goes to `sink` top-down
+    // (width * rows * 4 bytes) before the next is drawn, so only one band is
+    // ever in host memory. tileSize 0 = kDefaultTileSize; stops if sink fails.
+    using BandSink = std::function<bool(const unsigned char* rgba, int rows)>;
+    static constexpr int kDefaultTileSize = 2048;
+    bool renderTiled(const STLModel& model, const RenderSettings& settings,
+                     int width, int height, int tileSize, const BandSink& sink);
+
+    // Largest offscreen target side (0 before init)
+    int getMaxTargetSize() const { return maxTargetSize; }
+
+    // Scene mode: many models drawn together. Each distinct mesh (same
+    // contents, whichever model it came from) is packed once into shared
+    // vertex / index buffers, every placement is an instance, and a pass is
+    // one glMultiDraw*Indirect per buffer kind where GL 4.3 or
+    // ARB_multi_draw_indirect + ARB_base_instance is available, else one
+    // instanced draw per distinct mesh. Float layout, no culling or LOD; the
+    // scene's buffers are separate from the per-model cache and its budget.
+    // Rebuilds are incremental: meshes the buffers already hold stay where
+    // they are (or are moved GPU-side when the buffers are compacted), only
+    // new ones are uploaded, and content fingerprints are kept per revision.
+    struct SceneItem {
+        const STLModel*      model = nullptr;
+        std::array<float, 3> offset{0.0f, 0.0f, 0.0f};   // Placement: p * scale + offset
+        float                scale = 1.0f;
+    };
+    struct SceneStats {
+        size_t items     = 0;   // Instances
+        size_t meshes    = 0;   // Distinct meshes uploaded
+        size_t triangles = 0;   // Drawn per frame, all instances
+        size_t bytes     = 0;   // Vertex + index + instance + command buffers
+        int    drawCalls = 0;   // Per pass
+    };
+    bool       buildScene(const std::vector<SceneItem>& items);   // Replaces the scene; false if empty or too big
+    void       clearScene();
+    bool       hasScene() const { return scene.mesh.vao != 0; }
+    SceneStats sceneStats() const { return scene.stats; }
+    void       renderScene(const RenderSettings& settings, int viewportWidth, int viewportHeight);
+
+    // Level of detail: render() may draw one of `levels` (coarser stand-ins
+    // for `base` in the same coordinates, finest first) instead of `base`
+    // when the model covers few pixels, or a coarse one while the view is
+    // interactive. Levels are cached like any mesh and evicted with `base`;
+    // offscreen renders and picking always use the full mesh.
+    void attachLods(MeshHandle base, const std::vector<std::shared_ptr<const STLModel>>& levels);
+    void setLodEnabled(bool enabled) {
+        if (enabled != lodEnabled) generation++;
+        lodEnabled = enabled;
+    }
+    void setInteractive(bool moving) {   // E.g. while orbiting
+        if (moving != interactive) generation++;
+        interactive = moving;
+    }
+    int  lastLodLevel() const { return drawnLod; }               // 0 = full resolution
+
+    // Meshes uploaded with a BVH are frustum-culled per node; these count
+    // the triangles submitted by the last draw and the mesh's total
+    size_t lastDrawnTriangles() const { return drawnTriangles; }
+    size_t lastTotalTriangles() const { return totalTriangles; }
+
+    // Picking for the current mesh as render() draws it into a vpWidth x
+    // vpHeight viewport. (px, py) are viewport pixels from the top-left;
+    // origin / dir (and the projected point) are in STL model coordinates.
+    bool pickRay(const RenderSettings& settings, int vpWidth, int vpHeight, float px, float py,
+                 std::array<float, 3>& origin, std::array<float, 3>& dir) const;
+    bool projectPoint(const RenderSettings& settings, int vpWidth, int vpHeight,
+                      const std::array<float, 3>& point, float& px, float& py) const;
+
 private:
-    GLuint shaderProgram = 0;
-    GLuint vao = 0, vbo = 0;
+    // Post-projection adjustment for offscreen passes
+    struct ClipTransform {
+        bool  flipY   = false;              // Row 0 = top of the image (readback order)
+        float aspect  = 0.0f;               // 0 = the viewport's
+        float scaleX  = 1.0f, scaleY  = 1.0f;   // Sub-frustum of a larger image
+        float offsetX = 0.0f, offsetY = 0.0f;
+    };
+
+    struct GpuMesh {
+        GLuint vao = 0, vbo = 0, ebo = 0;
+        size_t vertexCount = 0;
+        size_t indexCount  = 0;     // > 0 when the model is welded
+        float  centerX = 0, centerY = 0, centerZ = 0;
+        float  span = 1.0f;
+        VertexFormat         format = VertexFormat::Float;
+        std::array<float, 3> posOffset{0.0f, 0.0f, 0.0f};
+        std::array<float, 3> posScale{1.0f, 1.0f, 1.0f};
+        size_t   bytes   = 0;       // VBO + EBO size
+        uint64_t lastUse = 0;       // LRU stamp
+        std::shared_ptr<const MeshBVH> bvh;   // Null = always drawn whole
+        std::vector<MeshHandle>        lods;  // See attachLods()
+
+        // Streamed meshes draw only the vertex ranges uploaded so far
+        // (sorted, coalesced); vertexCount is the final size
+        bool                 streaming = false;
+        std::vector<GLint>   streamFirsts;
+        std::vector<GLsizei> streamCounts;
+        size_t               streamedVertices = 0;
+    };
+
+    // A linked program and its uniform locations (-1 = not in this program)
+    struct Shader {
+        GLuint program = 0;
+        GLint  uModel = -1, uMVP = -1, uNormalMat = -1;
+        GLint  uModelColor = -1, uLightDir = -1, uViewPos = -1;
+        GLint  uAmbient = -1, uDiffuse = -1, uSpecular = -1, uShininess = -1;
+        GLint  uViewport = -1, uEdgeColor = -1, uEdgeWidth = -1;   // Edge shader only
+
+        void cacheUniforms();
+    };
+
+    // Per-mesh and scene (instanced) builds of each variant
+    struct ShaderSet {
+        Shader solid;
+        Shader edge;   // Solid plus single-pass wireframe; 0 if it failed to build
+        Shader line;   // Flat colour for the GL_LINE overlay
+    };
+    ShaderSet meshShaders;
+    ShaderSet sceneShaders;
     GLuint fbo = 0, rbo = 0, fboTex = 0;
+    GLuint viewFbo = 0, viewDepth = 0, viewColor = 0;   // drawViewport()'s cached image
+    int    viewWidth = 0, viewHeight = 0;
+    uint64_t generation = 1;
+    int    fboWidth = 0, fboHeight = 0;   // Size of the current offscreen target
+    bool   fboComplete = false;
+    GLint  maxTargetSize = 0;             // min(GL_MAX_TEXTURE_SIZE, GL_MAX_RENDERBUFFER_SIZE)
+
+    std::unordered_map<MeshHandle, GpuMesh> meshes;
+    MeshHandle   currentMesh   = 0;
+    uint64_t     streamCounter = 0;   // Streamed handles: kStreamHandleBit | counter
+    uint64_t     useCounter    = 0;
+    size_t       residentTotal = 0;
+    size_t       vramBudget    = size_t(1) << 30;   // 1 GB
+    VertexFormat vertexFormat  = VertexFormat::Float;
+
+    // Scene mode: mesh holds the shared VAO / buffers and the framing of the
+    // whole scene; one draw per distinct mesh, indexed ones first
+    struct SceneDraw {
+        bool    indexed       = false;
+        GLuint  count         = 0;   // Indices or vertices
+        GLuint  instanceCount = 0;
+        GLuint  first         = 0;   // First index or vertex
+        GLint   baseVertex    = 0;
+        GLuint  baseInstance  = 0;
+    };
+    struct Scene {
+        GpuMesh                mesh;
+        GLuint                 instanceVbo    = 0;
+        GLuint                 indirectBuffer = 0;   // Elements commands, then arrays commands
+        std::vector<SceneDraw> draws;
+        size_t                 elementDraws   = 0;
+        SceneStats             stats;
+
+        // Distinct meshes in the shared buffers, which have room for
+        // vertexCapacity / indexCapacity; new meshes are appended at the ends
+        struct Resident {
+            uint64_t revision    = 0;   // Model it was uploaded from
+            size_t   firstVertex = 0;
+            size_t   vertexCount = 0;
+            size_t   firstIndex  = 0;
+            size_t   indexCount  = 0;
+        };
+        std::vector<Resident> resident;
+        size_t vertexCapacity = 0, indexCapacity = 0;
+        size_t vertexEnd      = 0, indexEnd      = 0;
+    };
+    Scene scene;
+
+    // Content key of every model in the last scene build, by revision (a
+    // revision's contents never change). sameAs: a revision with identical
+    // contents, already confirmed byte for byte.
+    struct SceneKey {
+        uint64_t hash   = 0;
+        uint64_t sameAs = 0;
+    };
+    std::unordered_map<uint64_t, SceneKey> sceneKeys;
+    bool  multiDrawIndirect = false;   // Checked in init()
+
+    // Frustum culling: the last setUniforms() clip matrix (projection * view
+    // * model, STL coordinates in) and the visible triangle ranges, reused
+    // between draws so culling allocates nothing per frame
+    std::array<float, 16> clipMatrix{};
+    std::vector<GLint>       drawFirsts;    // First vertex / byte offset per range
+    std::vector<GLsizei>     drawCounts;
+    std::vector<const void*> drawOffsets;
+    size_t drawnTriangles = 0;
+    size_t totalTriangles = 0;
 
-    size_t currentVertexCount = 0;
-    float  modelCenterX = 0, modelCenterY = 0, modelCenterZ = 0;
-    float  modelSpan = 1.0f;
+    // Level of detail: at most this many triangles per covered pixel, and
+    // at most interactiveTriangles while moving
+    bool   lodEnabled           = true;
+    bool   interactive          = false;
+    float  lodTrianglesPerPixel = 1.0f;
+    size_t interactiveTriangles = 1000000;
+    int    drawnLod             = 0;
 
-    // Shader uniform locations
-    GLint uModel, uView, uProjection;
-    GLint uModelColor, uLightDir, uViewPos;
-    GLint uAmbient, uDiffuse, uSpecular, uShininess;
+    // GPU timing: one GL_TIME_ELAPSED query per pass for each frame in flight
+    static constexpr int kGpuFrames = 3;
+    static constexpr int kGpuPasses = 2;   // Solid, wireframe
+    bool     gpuTiming = false;
+    GLuint   gpuQueries[kGpuFrames][kGpuPasses] = {};
+    bool     gpuPending[kGpuFrames][kGpuPasses] = {};
+    int      gpuFrame  = 0;    // Slot the next render() records into
+    int      gpuActive = -1;   // Slot being recorded, -1 = not timing
+    GpuTimes gpuTimes;
 
     bool compileShaders();
-    void setupBuffers();
-    void setupFBO(int width, int height);
+    bool ensureFBO(int width, int height);   // false if incomplete
+    void uploadMesh(const STLModel& model, GpuMesh& mesh);
+    void setFraming(GpuMesh& mesh, const BoundingBox& bounds);
+    void releaseMesh(GpuMesh& mesh);
+    void enforceBudget(MeshHandle keep);
+    bool cullMesh(const GpuMesh& mesh);   // false = everything visible
+    MeshHandle pickLod(MeshHandle base, const RenderSettings& settings, int vpWidth, int vpHeight);
+    void drawMesh(const GpuMesh& mesh, bool culled);
+    void drawScene();
+    bool buildShaderSet(ShaderSet& set, const char* defines);
+    void startGpuFrame();
+    void finishGpuFrame();
+    void collectGpuTimes(int frame);
+    void beginGpuPass(int pass);
+    void endGpuPass(int pass);
 
-    void setUniforms(const RenderSettings& settings, int vpWidth, int vpHeight);
+    void setUniforms(const Shader& shader, const GpuMesh& mesh, const RenderSettings& settings,
+                     int vpWidth, int vpHeight, const ClipTransform& clip);
+    // Draw into the viewport at (x, y)
+    void renderMesh(MeshHandle handle, const RenderSettings& settings,
+                    int x, int y, int vpWidth, int vpHeight, const ClipTransform& clip);
 };
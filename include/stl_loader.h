@@ -3,7 +3,12 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 struct Triangle {
     std::array<float, 3> normal;
@@ -18,22 +23,173 @@ struct BoundingBox {
     float centerY() const { return (minY + maxY) * 0.5f; }
     float centerZ() const { return (minZ + maxZ) * 0.5f; }
     float span()    const;
+
+    void reset();                          // Empty box, ready to accumulate points
+    void include(const std::array<float, 3>& v);
+    void merge(const BoundingBox& other);
+};
+
+enum class NormalMode {
+    Flat,     // Keep facet normals; only coplanar neighbours share vertices
+    Smooth    // One area-weighted normal per welded position
+};
+
+struct WeldOptions {
+    float      epsilon  = 1e-5f;   // Snap distance as a fraction of the bounding span (0 = exact match)
+    NormalMode normals  = NormalMode::Smooth;
+    bool       parallel = true;
+    unsigned   threads  = 0;       // 0 = hardware concurrency
+};
+
+// Bounding volume hierarchy over a model's triangles. buildBVH() reorders
+// the triangles so every node covers a contiguous run [first, first + count)
+// of them in draw order; a culled draw is then a handful of ranges.
+struct BVHNode {
+    float    min[3], max[3];
+    uint32_t first;      // First triangle under this node
+    uint32_t count;      // Triangles under this node
+    uint32_t left;       // Child nodes; 0 = leaf (the root is never a child)
+    uint32_t right;
+
+    bool isLeaf() const { return left == 0; }
+};
+
+struct MeshBVH {
+    std::vector<BVHNode> nodes;   // nodes[0] is the root
+
+    size_t memoryBytes() const { return nodes.capacity() * sizeof(BVHNode); }
+};
+
+struct RayHit {
+    float                t = 0.0f;          // Distance along the (normalized) ray
+    size_t               triangle = 0;      // In draw order
+    std::array<float, 3> point{};
+};
+
+// Shared between a running load() and whoever watches it (e.g. the UI thread)
+struct LoadProgress {
+    std::atomic<float> fraction{0.0f};   // 0..1
+    std::atomic<bool>  cancel{false};    // Set to abort; load() then returns false
+};
+
+// Partial geometry of a load in progress, so a viewer can draw a large file
+// while it decodes (LoadOptions::stream). The decoder writes glVertices in
+// place and publishes each finished run of triangles; the consumer drains
+// new runs, copying them out. Binary files stream as they decode; ASCII
+// publishes everything once parsing ends. Either way the stream closes
+// before weld() / buildBVH() rewrite the arrays.
+class LoadStream {
+public:
+    struct Range {
+        size_t first;   // Triangles
+        size_t count;
+    };
+
+    // Consumer: calls fn(vertices, range) for each run published since the
+    // last drain. `vertices` is the whole interleaved array (18 floats per
+    // triangle) and only valid during the call. False until opened, and
+    // again once closed.
+    bool drain(const std::function<void(const float* vertices, const Range& range)>& fn);
+
+    size_t      triangles() const;   // Final count; 0 until opened
+    bool        closed()    const;   // Nothing more will arrive
+    BoundingBox bounds()    const;   // Estimate, grown as runs arrive
+
+    // Loader side. close() gives the consumer a moment to drain what's
+    // pending when `drainFirst` is set, so the last runs aren't lost.
+    void open(const float* vertices, size_t triangles, const BoundingBox& estimate);
+    void publish(size_t first, size_t count, const BoundingBox& box);
+    void close(bool drainFirst);
+
+private:
+    mutable std::mutex      mutex_;
+    std::condition_variable drained_;
+    const float*            vertices_  = nullptr;
+    size_t                  triangles_ = 0;
+    BoundingBox             bounds_{};
+    std::vector<Range>      pending_;
+    bool                    closed_ = false;
+};
+
+struct LoadOptions {
+    bool     parallel = true;   // Split decoding of large files across threads
+    unsigned threads  = 0;      // Worker count when parallel (0 = hardware concurrency)
+
+    // Decoders write straight into glVertices. Set this to also fill
+    // `triangles` up front; otherwise call ensureTriangles() when needed.
+    bool     keepTriangles = false;
+
+    // Run weld() after decoding
+    bool        weld = false;
+    WeldOptions weldOptions;
+
+    // Run buildBVH() last (frustum culling and picking in the viewer)
+    bool        buildBVH = false;
+
+    // Directory of processed-mesh cache files (see mesh_cache.h); empty = off.
+    // A hit maps the cached GL data instead of parsing the STL again.
+    std::string cacheDir;
+
+    // Optional progress reporting / cancellation; must outlive the load() call
+    LoadProgress* progress = nullptr;
+
+    // Optional progressive display; shared because the consumer may outlive
+    // the load (or give up on it first). Not used on a cache hit.
+    std::shared_ptr<LoadStream> stream;
 };
 
 struct STLModel {
     std::string           filename;
     std::string           fullpath;   // Full path to the original STL file
-    std::vector<Triangle> triangles;
+    std::vector<Triangle> triangles;  // Optional; see ensureTriangles()
     BoundingBox           bounds;
 
     // OpenGL buffer data (interleaved: normal + vertex)
     std::vector<float>    glVertices;   // nx,ny,nz, vx,vy,vz per vertex
     size_t                vertexCount = 0;
+    std::vector<uint32_t> indices;      // 3 per triangle after weld(); empty = unindexed
+
+    // Process-unique id of the current GL data; changes whenever glVertices
+    // or indices are rebuilt, so GPU-side caches can key on it
+    uint64_t              revision = 0;
 
-    bool load(const std::string& filepath);
+    // Optional spatial index; shared so GPU copies keep it after the CPU
+    // mesh is dropped. Only valid for the triangle order it was built on.
+    std::shared_ptr<const MeshBVH> bvh;
+
+    bool load(const std::string& filepath, const LoadOptions& options = {});
     void computeBounds();
     void buildGLData();
+
+    // Merge coincident vertices into a shared vertex buffer + index buffer
+    void weld(const WeldOptions& options = {});
+
+    // Rebuild `triangles` from glVertices if the load didn't keep them
+    void ensureTriangles();
+
+    // Build `bvh` (in parallel) and reorder the triangles to match it
+    void buildBVH(unsigned threads = 0);
+
+    // Nearest triangle hit by the ray (dir need not be normalized); uses the
+    // BVH when there is one, else tests every triangle
+    bool raycast(const std::array<float, 3>& origin, const std::array<float, 3>& dir, RayHit& hit) const;
+
+    // Stamp a new revision after editing glVertices / indices by hand
+    void touch();
+
+    // Heap bytes held by the mesh arrays (for memory caps)
+    size_t memoryBytes() const;
+
+    bool   isIndexed()     const { return !indices.empty(); }
+    size_t triangleCount() const { return isIndexed() ? indices.size() / 3 : vertexCount / 3; }
+};
+
+// Cheap per-file metadata for listing a model without parsing it
+struct STLFileInfo {
+    uint64_t fileSize  = 0;
+    size_t   triangles = 0;       // Binary: from the header. ASCII: rough estimate
+    bool     binary    = false;
 };
 
-// Utility: collect all .stl files in a directory (optionally recursive)
-std::vector<std::string> findSTLFiles(const std::string& directory, bool recursive = false);
+// Read just the 84-byte header; false if the file can't be opened
+bool probeSTLFile(const std::string& filepath, STLFileInfo& info);
@@ -0,0 +1,573 @@
+#include "batch_cli.h"
+#include "stl_loader.h"
+#include "dir_scanner.h"
+#include "renderer.h"
+#include "exporter.h"
+#include "export_pipeline.h"
+#include "export_farm.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace BatchCLI {
+
+namespace {
+
+enum class Backend { Auto, Window, EGL, OSMesa };
+
+struct Options {
+    std::vector<std::string> inputs;        // Files or directories
+    std::string              outputDir;     // Empty = next to each STL
+    bool                     recursive = false;
+    bool                     compact   = false;
+    unsigned                 workers   = 0;
+    Backend                  backend   = Backend::Auto;
+    RenderSettings           settings;
+    LoadOptions              loadOptions;
+    Exporter::ExportFormat   format;
+    int                      views        = 0;   // Turntable poses; 0 = single image
+    int                      sheetColumns = 0;
+    bool                     splitViews   = false;
+    int                      tileSize     = 0;   // > 0 forces tiled rendering
+    unsigned                 contexts     = 1;   // GL contexts exporting in parallel
+    unsigned                 shardIndex   = 0;   // This process takes every shardCount-th file
+    unsigned                 shardCount   = 1;
+    bool                     help      = false;
+};
+
+const char* kUsage =
+    "Usage: stl_viewer --export <dir|file> [--export ...] [options]\n"
+    "\n"
+    "Input / output\n"
+    "  --export PATH         STL file or folder to render (repeatable)\n"
+    "  --out DIR             Output folder (default: next to each STL)\n"
+    "                        With --format raw: output file, or - for stdout (default)\n"
+    "  --recursive           Include subfolders; keeps their layout under --out\n"
+    "  --config FILE         Read 'key = value' lines using the option names below\n"
+    "\n"
+    "Rendering\n"
+    "  --size WxH            Image size (default 1920x1080)\n"
+    "  --color R,G,B         Model color, 0-1 floats or #RRGGBB\n"
+    "  --bg R,G,B[,A]        Background color\n"
+    "  --wireframe           Draw edges; --edge-color, --edge-width (pixels)\n"
+    "  --wire-lines          Edges as a second GL_LINE pass instead of in the shader\n"
+    "  --elevation DEG  --azimuth DEG  --distance D  --fov DEG\n"
+    "  --light X,Y,Z  --ambient F  --diffuse F  --specular F  --shininess F\n"
+    "  --views N             Turntable: N azimuths around the model, one upload and\n"
+    "                        one readback per model, written as a sprite sheet with\n"
+    "                        --size per tile (--sheet-columns C, default ~square)\n"
+    "  --split-views         Write the views as <name>_000, _001, ... instead\n"
+    "  --tile N              Render in N x N tiles, streaming rows to the PNG; used\n"
+    "                        automatically past the GPU's size limit (16K+ posters)\n"
+    "\n"
+    "Output format\n"
+    "  --format png|qoi|jpeg|webp|raw\n"
+    "                        raw streams headerless top-down frames in input order\n"
+    "                        (RGBA, or RGB with --alpha drop), e.g. into ffmpeg\n"
+    "  --png fast|balanced|small   PNG compression (default balanced)\n"
+    "  --quality N           JPEG / WebP quality, 1-100 (default 90)\n"
+    "  --alpha auto|keep|drop      auto writes RGB when the image is opaque\n"
+    "\n"
+    "Loading\n"
+    "  --weld                Weld vertices; --normals flat|smooth, --weld-epsilon E\n"
+    "  --compact             Compact GPU vertex format\n"
+    "  --cache DIR           Keep processed meshes in DIR; unchanged files then load\n"
+    "                        from there instead of being parsed again\n"
+    "  --threads N           Files decoded concurrently (default min(4, cores))\n"
+    "  --contexts N          Export on N GL contexts at once, each with its own\n"
+    "                        renderer, sharing one work queue (default 1)\n"
+    "  --shard I/N           Take only files I, I+N, I+2N, ... (0-based); run one\n"
+    "                        process per GPU to spread a batch over several\n"
+    "  --backend auto|window|egl|osmesa\n"
+    "                        GL context source; auto tries a hidden window, then\n"
+    "                        EGL and OSMesa without a display (GLFW 3.4+)\n"
+    "\n"
+    "Exit status: 0 all exported, 1 some failed, 2 usage error, 3 no GL context\n";
+
+// ── Value parsing ───────────────────────────────────────────────────────────
+
+bool parseFloat(const std::string& text, float& out) {
+    char* end = nullptr;
+    out = std::strtof(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+bool parseInt(const std::string& text, int& out) {
+    char* end = nullptr;
+    long v = std::strtol(text.c_str(), &end, 10);
+    out = int(v);
+    return end != text.c_str() && *end == '\0';
+}
+
+bool parseBool(const std::string& text, bool& out) {
+    if (text.empty() || text == "1" || text == "true" || text == "on" || text == "yes") {
+        out = true;
+        return true;
+    }
+    if (text == "0" || text == "false" || text == "off" || text == "no") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+// Comma-separated floats; between `minCount` and `maxCount` of them
+bool parseFloatList(const std::string& text, float* out, int minCount, int maxCount) {
+    int count = 0;
+    size_t pos = 0;
+    for (;;) {
+        size_t comma = text.find(',', pos);
+        if (count == maxCount) return false;
+        if (!parseFloat(text.substr(pos, comma == std::string::npos ? comma : comma - pos), out[count])) return false;
+        ++count;
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    return count >= minCount;
+}
+
+bool parseColor(const std::string& text, float* out, int maxCount) {
+    if (!text.empty() && text[0] == '#' && (text.size() == 7 || text.size() == 9)) {
+        for (size_t i = 0; i * 2 + 1 < text.size(); ++i) {
+            char* end = nullptr;
+            std::string byte = text.substr(1 + i * 2, 2);
+            long v = std::strtol(byte.c_str(), &end, 16);
+            if (*end != '\0' || int(i) >= maxCount) return false;
+            out[i] = float(v) / 255.0f;
+        }
+        return true;
+    }
+    return parseFloatList(text, out, 3, maxCount);
+}
+
+bool parseSize(const std::string& text, int& w, int& h) {
+    size_t x = text.find_first_of("xX");
+    if (x == std::string::npos) return false;
+    return parseInt(text.substr(0, x), w) && parseInt(text.substr(x + 1), h) && w > 0 && h > 0;
+}
+
+// ── Options ─────────────────────────────────────────────────────────────────
+
+bool isFlag(const std::string& key) {
+    return key == "recursive" || key == "wireframe" || key == "weld" ||
+           key == "compact"   || key == "split-views" || key == "help" ||
+           key == "wire-lines";
+}
+
+bool loadConfig(const std::string& path, Options& opts);
+
+// Apply one option (CLI flag without dashes, or config key)
+bool applyOption(const std::string& key, const std::string& value, Options& opts) {
+    RenderSettings& s = opts.settings;
+    bool ok = true;
+
+    if      (key == "export")       opts.inputs.push_back(value);
+    else if (key == "out")          opts.outputDir = value;
+    else if (key == "config")       ok = loadConfig(value, opts);
+    else if (key == "recursive")    ok = parseBool(value, opts.recursive);
+    else if (key == "compact")      ok = parseBool(value, opts.compact);
+    else if (key == "help")         ok = parseBool(value, opts.help);
+    else if (key == "size")         ok = parseSize(value, s.exportWidth, s.exportHeight);
+    else if (key == "width")        ok = parseInt(value, s.exportWidth) && s.exportWidth > 0;
+    else if (key == "height")       ok = parseInt(value, s.exportHeight) && s.exportHeight > 0;
+    else if (key == "color")        ok = parseColor(value, s.modelColor, 3);
+    else if (key == "bg")           ok = parseColor(value, s.bgColor, 4);
+    else if (key == "edge-color")   ok = parseColor(value, s.edgeColor, 3);
+    else if (key == "wireframe")    ok = parseBool(value, s.wireframe);
+    else if (key == "edge-width")   ok = parseFloat(value, s.edgeWidth);
+    else if (key == "wire-lines")   ok = parseBool(value, s.lineWireframe);
+    else if (key == "elevation")    ok = parseFloat(value, s.elevation);
+    else if (key == "azimuth")      ok = parseFloat(value, s.azimuth);
+    else if (key == "distance")     ok = parseFloat(value, s.distance);
+    else if (key == "fov")          ok = parseFloat(value, s.fov);
+    else if (key == "light")        ok = parseFloatList(value, s.lightDir, 3, 3);
+    else if (key == "ambient")      ok = parseFloat(value, s.ambientStr);
+    else if (key == "diffuse")      ok = parseFloat(value, s.diffuseStr);
+    else if (key == "specular")     ok = parseFloat(value, s.specularStr);
+    else if (key == "shininess")    ok = parseFloat(value, s.shininess);
+    else if (key == "weld")         ok = parseBool(value, opts.loadOptions.weld);
+    else if (key == "weld-epsilon") ok = parseFloat(value, opts.loadOptions.weldOptions.epsilon);
+    else if (key == "cache")        opts.loadOptions.cacheDir = value;
+    else if (key == "png")          ok = Exporter::parseCompression(value, opts.format.png.compression);
+    else if (key == "views")         ok = parseInt(value, opts.views) && opts.views >= 0;
+    else if (key == "sheet-columns") ok = parseInt(value, opts.sheetColumns) && opts.sheetColumns >= 0;
+    else if (key == "split-views")   ok = parseBool(value, opts.splitViews);
+    else if (key == "tile")          ok = parseInt(value, opts.tileSize) && opts.tileSize >= 0;
+    else if (key == "contexts") {
+        int n = 0;
+        ok = parseInt(value, n) && n >= 1;
+        opts.contexts = unsigned(n);
+    }
+    else if (key == "shard") {
+        int index = 0, count = 0;
+        size_t slash = value.find('/');
+        ok = slash != std::string::npos &&
+             parseInt(value.substr(0, slash), index) && parseInt(value.substr(slash + 1), count) &&
+             count >= 1 && index >= 0 && index < count;
+        opts.shardIndex = unsigned(index);
+        opts.shardCount = unsigned(count);
+    }
+    else if (key == "format")       ok = Exporter::parseFormat(value, opts.format.format);
+    else if (key == "quality")      ok = parseInt(value, opts.format.quality) &&
+                                         opts.format.quality >= 1 && opts.format.quality <= 100;
+    else if (key == "alpha") {
+        if      (value == "auto") opts.format.png.alpha = Exporter::AlphaMode::Auto;
+        else if (value == "keep") opts.format.png.alpha = Exporter::AlphaMode::Keep;
+        else if (value == "drop") opts.format.png.alpha = Exporter::AlphaMode::Drop;
+        else ok = false;
+    }
+    else if (key == "normals") {
+        if      (value == "flat")   opts.loadOptions.weldOptions.normals = NormalMode::Flat;
+        else if (value == "smooth") opts.loadOptions.weldOptions.normals = NormalMode::Smooth;
+        else ok = false;
+    }
+    else if (key == "threads") {
+        int n = 0;
+        ok = parseInt(value, n) && n >= 0;
+        opts.workers = unsigned(n);
+    }
+    else if (key == "backend") {
+        if      (value == "auto")   opts.backend = Backend::Auto;
+        else if (value == "window") opts.backend = Backend::Window;
+        else if (value == "egl")    opts.backend = Backend::EGL;
+        else if (value == "osmesa") opts.backend = Backend::OSMesa;
+        else ok = false;
+    }
+    else {
+        std::cerr << "Unknown option: " << key << std::endl;
+        return false;
+    }
+
+    if (!ok) std::cerr << "Invalid value for " << key << ": '" << value << "'" << std::endl;
+    return ok;
+}
+
+bool loadConfig(const std::string& path, Options& opts) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open config: " << path << std::endl;
+        return false;
+    }
+
+    auto trim = [](std::string str) {
+        size_t b = str.find_first_not_of(" \t\r");
+        size_t e = str.find_last_not_of(" \t\r");
+        return b == std::string::npos ? std::string() : str.substr(b, e - b + 1);
+    };
+
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(file, line)) {
+        ++lineNo;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        size_t split = line.find_first_of("= \t");
+        std::string key   = trim(line.substr(0, split));
+        std::string value = split == std::string::npos ? "" : trim(line.substr(split + 1));
+        if (!value.empty() && value[0] == '=') value = trim(value.substr(1));
+
+        if (!applyOption(key, value, opts)) {
+            std::cerr << "  at " << path << ":" << lineNo << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Flags are applied in order, so later flags override an earlier --config
+bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h") arg = "--help";
+        if (arg.rfind("--", 0) != 0) {
+            std::cerr << "Unexpected argument: " << arg << std::endl;
+            return false;
+        }
+
+        std::string key = arg.substr(2);
+        std::string value;
+        size_t eq = key.find('=');
+        if (eq != std::string::npos) {
+            value = key.substr(eq + 1);
+            key   = key.substr(0, eq);
+        } else if (!isFlag(key)) {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for --" << key << std::endl;
+                return false;
+            }
+            value = argv[++i];
+        }
+
+        if (!applyOption(key, value, opts)) return false;
+    }
+    return true;
+}
+
+// ── Jobs ────────────────────────────────────────────────────────────────────
+
+// Expand inputs into (stl, image) pairs. With --out, files found under a
+// directory keep their relative subfolder so same-named parts don't collide.
+std::vector<ExportItem> collectJobs(const Options& opts) {
+    std::vector<ExportItem> jobs;
+    for (const auto& input : opts.inputs) {
+        std::error_code ec;
+        if (!fs::is_directory(input, ec)) {
+            jobs.push_back({input, Exporter::deriveOutputPath(input, opts.outputDir, opts.format.format),
+                            nullptr});
+            continue;
+        }
+
+        for (const auto& file : findSTLFiles(input, opts.recursive)) {
+            std::string outDir = opts.outputDir;
+            if (!outDir.empty()) {
+                fs::path rel = fs::path(file).lexically_relative(input).parent_path();
+                if (!rel.empty()) outDir = (fs::path(outDir) / rel).string();
+            }
+            jobs.push_back({file, Exporter::deriveOutputPath(file, outDir, opts.format.format), nullptr});
+        }
+    }
+
+    if (opts.shardCount > 1) {
+        std::vector<ExportItem> shard;
+        for (size_t i = opts.shardIndex; i < jobs.size(); i += opts.shardCount) {
+            shard.push_back(std::move(jobs[i]));
+        }
+        jobs = std::move(shard);
+    }
+    return jobs;
+}
+
+// ── GL context ──────────────────────────────────────────────────────────────
+
+void glfwErrorCallback(int code, const char* description) {
+    std::cerr << "GLFW error " << code << ": " << description << std::endl;
+}
+
+// One attempt at a GL 3.3 core context on a tiny invisible window
+GLFWwindow* tryContext(Backend backend) {
+#ifdef GLFW_PLATFORM_NULL
+    // The null platform needs no display server; contexts come from EGL
+    // (surfaceless) or OSMesa.
+    if (backend == Backend::EGL || backend == Backend::OSMesa) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+#else
+    if (backend == Backend::EGL || backend == Backend::OSMesa) return nullptr;
+#endif
+#ifdef __APPLE__
+    glfwInitHint(GLFW_COCOA_MENUBAR, GLFW_FALSE);
+#endif
+    if (!glfwInit()) return nullptr;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    if (backend == Backend::EGL)    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#ifdef GLFW_OSMESA_CONTEXT_API
+    if (backend == Backend::OSMesa) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+
+    // Rendering goes to the renderer's FBO, so the default framebuffer can be tiny
+    GLFWwindow* window = glfwCreateWindow(16, 16, "stl_viewer", nullptr, nullptr);
+    if (!window) {
+        glfwTerminate();
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+#endif
+    }
+    return window;
+}
+
+GLFWwindow* createContext(Backend backend) {
+    glfwSetErrorCallback(glfwErrorCallback);
+
+    const Backend order[] = {Backend::Window, Backend::EGL, Backend::OSMesa};
+    for (Backend b : order) {
+        if (backend != Backend::Auto && backend != b) continue;
+        if (GLFWwindow* window = tryContext(b)) {
+            glfwMakeContextCurrent(window);
+            return window;
+        }
+    }
+    return nullptr;
+}
+
+bool initGLEW() {
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLX-only GLEW builds report this under EGL/OSMesa even though the core
+    // entry points loaded fine
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+    if (err != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW: " << glewGetErrorString(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// ── Entry points ────────────────────────────────────────────────────────────
+
+bool requested(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        // "--export <dir>" or "--export=<dir>"; other "--export..." words aren't ours
+        if (std::strcmp(argv[i], "--export") == 0 || std::strncmp(argv[i], "--export=", 9) == 0 ||
+            std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int run(int argc, char** argv) {
+#ifdef _WIN32
+    // Release builds are GUI-subsystem; reattach to the invoking console
+    if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+        std::freopen("CONOUT$", "w", stdout);
+        std::freopen("CONOUT$", "w", stderr);
+    }
+#endif
+
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        std::cerr << "Run with --help for usage." << std::endl;
+        return kExitUsage;
+    }
+    if (opts.help) {
+        std::cout << kUsage;
+        return kExitOk;
+    }
+    if (opts.inputs.empty()) {
+        std::cerr << "No --export input given." << std::endl;
+        return kExitUsage;
+    }
+    if (!Exporter::formatAvailable(opts.format.format)) {
+        std::cerr << "This build has no WebP support (configure with STL_VIEWER_WITH_WEBP)." << std::endl;
+        return kExitUsage;
+    }
+
+    if (opts.contexts > 1 && opts.format.format == Exporter::ImageFormat::Raw) {
+        std::cerr << "--format raw needs a single context (frames must stay in order)." << std::endl;
+        return kExitUsage;
+    }
+
+    // Raw frames go to one stream; everything we'd normally print moves to
+    // stderr so stdout carries nothing but pixels
+    const bool raw = opts.format.format == Exporter::ImageFormat::Raw;
+    FILE* rawSink = nullptr;
+    bool  rawToStdout = raw && (opts.outputDir.empty() || opts.outputDir == "-");
+    if (rawToStdout) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        rawSink = stdout;
+    } else if (raw) {
+        rawSink = std::fopen(opts.outputDir.c_str(), "wb");
+        if (!rawSink) {
+            std::cerr << "Cannot open " << opts.outputDir << " for writing." << std::endl;
+            return kExitFailed;
+        }
+    }
+
+    // Scan before touching GL: an empty job list shouldn't pay for a context
+    std::vector<ExportItem> jobs = collectJobs(opts);
+    if (jobs.empty()) {
+        std::cerr << "No STL files found." << std::endl;
+        if (rawSink && !rawToStdout) std::fclose(rawSink);
+        return kExitFailed;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    GLFWwindow* window = createContext(opts.backend);
+    if (!window) {
+        std::cerr << "Could not create an OpenGL 3.3 context." << std::endl;
+        if (rawSink && !rawToStdout) std::fclose(rawSink);
+        return kExitNoContext;
+    }
+
+    size_t exported = 0, failed = 0;
+    {
+        Renderer renderer;
+        if (!initGLEW() || !renderer.init()) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            if (rawSink && !rawToStdout) std::fclose(rawSink);
+            return kExitNoContext;
+        }
+        renderer.setVertexFormat(opts.compact ? VertexFormat::Compact : VertexFormat::Float);
+
+        ExportPipelineOptions pipelineOptions;
+        pipelineOptions.loadWorkers = opts.workers;
+        pipelineOptions.loadOptions = opts.loadOptions;
+        pipelineOptions.format      = opts.format;
+        pipelineOptions.rawSink     = rawSink;
+        pipelineOptions.tileSize    = opts.tileSize;
+        if (opts.views > 0) {
+            pipelineOptions.views        = turntablePoses(opts.settings, opts.views);
+            pipelineOptions.sheetColumns = opts.sheetColumns;
+            pipelineOptions.splitViews   = opts.splitViews;
+        }
+        if (opts.contexts > 1) {
+            // This thread's context just initialised GLEW; the workers bring their own
+            ExportFarm farm(opts.contexts, opts.settings, std::move(jobs), pipelineOptions,
+                            opts.compact ? VertexFormat::Compact : VertexFormat::Float);
+            farm.wait();
+            exported = farm.succeeded();
+            failed   = farm.failed() + (farm.total() - farm.completed());
+        } else {
+            ExportPipeline pipeline(renderer, opts.settings, std::move(jobs), pipelineOptions);
+            pipeline.run();
+            exported = pipeline.succeeded();
+            failed   = pipeline.failed();
+        }
+
+        renderer.shutdown();
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    if (rawSink) {
+        if (std::fflush(rawSink) != 0) failed++;
+        if (!rawToStdout) std::fclose(rawSink);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "Batch export: " << exported << " exported, " << failed << " failed ("
+              << seconds << " s)" << std::endl;
+
+    return failed > 0 ? kExitFailed : kExitOk;
+}
+
+} // namespace BatchCLI
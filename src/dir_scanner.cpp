@@ -0,0 +1,225 @@
+#include "dir_scanner.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Hits handed on per task: big enough to keep lock traffic low, small
+// enough that a 100k-file folder spreads its header reads over every worker
+constexpr size_t kFilesPerTask = 32;
+
+// Case-insensitive ".stl" suffix on a native path string (char or wchar_t).
+// The name must be more than the extension: ".stl" alone is a dotfile.
+template <typename String>
+bool hasSTLSuffix(const String& s) {
+    size_t n = s.size();
+    if (n < 5 || s[n - 5] == '/' || s[n - 5] == '\\') return false;
+    return s[n - 4] == '.' && (s[n - 3] | 0x20) == 's' && (s[n - 2] | 0x20) == 't' &&
+           (s[n - 1] | 0x20) == 'l';
+}
+
+} // namespace
+
+bool isSTLPath(const std::string& path) {
+    return hasSTLSuffix(path);
+}
+
+DirScanner::DirScanner(unsigned workers) {
+    // Listing and header reads wait on the disk (or the network) far more
+    // than they compute, so oversubscribe the cores
+    unsigned count = workers > 0 ? workers : std::min(16u, 2 * Parallel::threadCount());
+    workers_.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+DirScanner::~DirScanner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for (auto& scan : scans_) scan->cancel = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+uint64_t DirScanner::scan(const std::string& directory, bool recursive, bool probe) {
+    auto scan = std::make_shared<Scan>();
+    scan->recursive = recursive;
+    scan->probe     = probe;
+    scan->tasks     = 1;
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = scan->id = nextId_++;
+        scans_.push_back(scan);
+        dirs_.push_back({scan, directory, {}});
+    }
+    wake_.notify_one();
+    return id;
+}
+
+void DirScanner::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& scan : scans_) {
+        if (scan->id == id) scan->cancel = true;
+    }
+    found_.erase(std::remove_if(found_.begin(), found_.end(),
+                                [id](const ScanHit& h) { return h.scanId == id; }),
+                 found_.end());
+}
+
+void DirScanner::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& scan : scans_) scan->cancel = true;
+    found_.clear();
+}
+
+std::vector<ScanHit> DirScanner::takeFound() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<ScanHit> out;
+    out.swap(found_);
+    return out;
+}
+
+std::vector<ScanHit> DirScanner::waitFound() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    foundCv_.wait(lock, [this] { return !found_.empty() || scans_.empty(); });
+    std::vector<ScanHit> out;
+    out.swap(found_);
+    return out;
+}
+
+bool DirScanner::scanning(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& scan : scans_) {
+        if (scan->id == id) return true;
+    }
+    return false;
+}
+
+size_t DirScanner::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scans_.size();
+}
+
+void DirScanner::workerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !files_.empty() || !dirs_.empty(); });
+            if (stopping_) return;
+            std::deque<Task>& from = files_.empty() ? dirs_ : files_;
+            task = std::move(from.front());
+            from.pop_front();
+        }
+
+        if (!task.scan->cancel) {
+            if (task.files.empty()) listDirectory(task.scan, task.directory);
+            else probeFiles(task.scan, task.files);
+        }
+        finishTask(task.scan);
+    }
+}
+
+// List one folder. Subfolders and hits are handed back in batches as the
+// listing goes, so other workers start on them before a huge folder is done.
+void DirScanner::listDirectory(const std::shared_ptr<Scan>& scan, const std::string& directory) {
+    std::vector<std::string> subdirs;
+    std::vector<std::string> hits;
+
+    auto flush = [&] {
+        if (subdirs.empty() && hits.empty()) return;
+        size_t tasks = subdirs.size();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!scan->cancel) {
+                for (auto& dir : subdirs) dirs_.push_back({scan, std::move(dir), {}});
+                if (scan->probe && !hits.empty()) {
+                    files_.push_back({scan, {}, std::move(hits)});
+                    tasks++;
+                } else {
+                    for (auto& path : hits) found_.push_back({scan->id, std::move(path), {}, false});
+                }
+                scan->tasks += tasks;
+            }
+        }
+        if (tasks > 1) wake_.notify_all();
+        else if (tasks == 1) wake_.notify_one();
+        if (!scan->probe && !hits.empty()) foundCv_.notify_all();
+        subdirs.clear();
+        hits.clear();
+    };
+
+    // Errors skip the folder (or the rest of it) rather than the whole scan:
+    // one unreadable share shouldn't hide everything else
+    std::error_code ec;
+    fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (scan->cancel) return;
+        const fs::directory_entry& entry = *it;
+        std::error_code typeEc;
+
+        // Like recursive_directory_iterator, don't follow directory symlinks
+        if (entry.is_directory(typeEc)) {
+            if (scan->recursive && !entry.is_symlink(typeEc)) subdirs.push_back(entry.path().string());
+        } else if (hasSTLSuffix(entry.path().native()) && entry.is_regular_file(typeEc)) {
+            hits.push_back(entry.path().string());
+        }
+        if (hits.size() >= kFilesPerTask || subdirs.size() >= kFilesPerTask) flush();
+    }
+    if (ec) std::cerr << "Cannot read directory: " << directory << " (" << ec.message() << ")" << std::endl;
+    flush();
+}
+
+void DirScanner::probeFiles(const std::shared_ptr<Scan>& scan, const std::vector<std::string>& files) {
+    std::vector<ScanHit> hits;
+    hits.reserve(files.size());
+    for (const auto& path : files) {
+        if (scan->cancel) return;
+        ScanHit hit;
+        hit.scanId = scan->id;
+        hit.path   = path;
+        hit.probed = probeSTLFile(path, hit.info);   // Unreadable files still list
+        hits.push_back(std::move(hit));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (scan->cancel) return;
+        found_.insert(found_.end(), std::make_move_iterator(hits.begin()),
+                      std::make_move_iterator(hits.end()));
+    }
+    foundCv_.notify_all();
+}
+
+void DirScanner::finishTask(const std::shared_ptr<Scan>& scan) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--scan->tasks > 0) return;
+        scans_.erase(std::remove(scans_.begin(), scans_.end(), scan), scans_.end());
+    }
+    foundCv_.notify_all();
+}
+
+// ── Blocking listing ────────────────────────────────────────────────────────
+
+std::vector<std::string> findSTLFiles(const std::string& directory, bool recursive) {
+    std::vector<std::string> files;
+    DirScanner scanner;
+    scanner.scan(directory, recursive, false);
+    for (auto hits = scanner.waitFound(); !hits.empty(); hits = scanner.waitFound()) {
+        for (auto& hit : hits) files.push_back(std::move(hit.path));
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
@@ -0,0 +1,103 @@
+#include "export_farm.h"
+#include "parallel.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <iostream>
+
+ExportFarm::ExportFarm(unsigned contexts, const RenderSettings& settings, std::vector<ExportItem> items,
+                       const ExportPipelineOptions& options, VertexFormat vertexFormat)
+    : settings_(settings),
+      options_(options),
+      vertexFormat_(vertexFormat),
+      queue_(std::make_shared<ExportQueue>(std::move(items))) {
+    contexts = std::max(1u, contexts);
+
+    // Split the CPU between the pipelines rather than giving each a full set
+    unsigned hw = Parallel::threadCount();
+    if (options_.loadWorkers == 0)   options_.loadWorkers   = std::max(1u, std::min(4u, hw) / contexts);
+    if (options_.encodeThreads == 0) options_.encodeThreads = std::max(1u, (hw > 1 ? hw - 1 : 1) / contexts);
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    for (unsigned i = 0; i < contexts; ++i) {
+        GLFWwindow* window = glfwCreateWindow(16, 16, "stl_viewer export", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Export context " << i + 1 << " of " << contexts << " could not be created" << std::endl;
+            break;
+        }
+        auto worker = std::make_unique<Worker>();
+        worker->window = window;
+        workers_.push_back(std::move(worker));
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    for (auto& worker : workers_) {
+        Worker* w = worker.get();
+        w->thread = std::thread([this, w] { workerLoop(*w); });
+    }
+}
+
+ExportFarm::~ExportFarm() {
+    cancel();
+    wait();
+    for (auto& worker : workers_) glfwDestroyWindow(worker->window);
+}
+
+void ExportFarm::workerLoop(Worker& worker) {
+    glfwMakeContextCurrent(worker.window);
+
+    Renderer renderer;
+    if (renderer.init()) {
+        renderer.setVertexFormat(vertexFormat_);
+        {
+            ExportPipeline pipeline(renderer, settings_, queue_, options_);
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.pipeline = &pipeline;
+            }
+            pipeline.run(&stop_);
+
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.succeeded = pipeline.succeeded();
+            worker.failed    = pipeline.failed();
+            worker.pipeline  = nullptr;
+        }
+        renderer.shutdown();
+    } else {
+        // The other workers pick up its share
+        std::cerr << "Export context failed to initialize its renderer" << std::endl;
+    }
+
+    glfwMakeContextCurrent(nullptr);
+    worker.done = true;
+}
+
+size_t ExportFarm::succeeded() const {
+    size_t n = 0;
+    for (const auto& w : workers_) {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        n += w->pipeline ? w->pipeline->succeeded() : w->succeeded;
+    }
+    return n;
+}
+
+size_t ExportFarm::failed() const {
+    size_t n = 0;
+    for (const auto& w : workers_) {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        n += w->pipeline ? w->pipeline->failed() : w->failed;
+    }
+    return n;
+}
+
+bool ExportFarm::finished() const {
+    return std::all_of(workers_.begin(), workers_.end(),
+                       [](const std::unique_ptr<Worker>& w) { return w->done.load(); });
+}
+
+void ExportFarm::wait() {
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+}
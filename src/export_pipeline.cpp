@@ -0,0 +1,438 @@
+#include "export_pipeline.h"
+#include "exporter.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+ExportPipeline::ExportPipeline(Renderer& renderer, const RenderSettings& settings,
+                               std::vector<ExportItem> items, const ExportPipelineOptions& options)
+    : ExportPipeline(renderer, settings, std::make_shared<ExportQueue>(std::move(items)), options) {}
+
+ExportPipeline::ExportPipeline(Renderer& renderer, const RenderSettings& settings,
+                               std::shared_ptr<ExportQueue> queue, const ExportPipelineOptions& options)
+    : renderer_(renderer),
+      settings_(settings),
+      queue_(std::move(queue)),
+      options_(options),
+      loader_(options.loadWorkers) {
+    if (options_.views.empty()) options_.splitViews = false;
+    layout_ = options_.views.empty()
+        ? sheetLayout(1, settings_.exportWidth, settings_.exportHeight, 1)
+        : sheetLayout(options_.views.size(), settings_.exportWidth, settings_.exportHeight,
+                      options_.sheetColumns);
+    frameBytes_ = size_t(layout_.width()) * size_t(layout_.height()) * 4;
+    if (options_.format.png.threads == 0) options_.format.png.threads = 1;
+    encoder_ = Exporter::makeEncoder(options_.format);
+    if (!encoder_) {
+        failAll("Export format not available in this build");
+        return;
+    }
+
+    // Past the GL size limit each image is drawn in tiles and streamed out a
+    // band at a time on the GL thread; there's no whole frame to hand off
+    int limit = renderer_.getMaxTargetSize();
+    tiled_ = options_.views.empty() &&
+             (options_.tileSize > 0 ||
+              (limit > 0 && (layout_.width() > limit || layout_.height() > limit)));
+    if (tiled_) {
+        // Each tile then draws only the BVH nodes inside its sub-frustum
+        options_.loadOptions.buildBVH = true;
+        auto format = options_.format.format;
+        if (format != Exporter::ImageFormat::PNG && format != Exporter::ImageFormat::Raw) {
+            failAll("Tiled export (images past the GL size limit, or --tile) writes PNG or raw only");
+        }
+        return;
+    }
+    if (!options_.views.empty() && limit > 0 && (layout_.width() > limit || layout_.height() > limit)) {
+        std::cerr << "Sprite sheet " << layout_.width() << "x" << layout_.height()
+                  << " exceeds the GL limit of " << limit << "; use --split-views with a smaller size" << std::endl;
+    }
+
+    // Readback ring: each PBO holds one frame until its fence signals
+    slots_.resize(std::max<size_t>(1, options_.readbackSlots));
+    for (auto& slot : slots_) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes_, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Leave a core for the GL thread; compression is the usual bottleneck
+    unsigned threads = options_.encodeThreads;
+    if (threads == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 1;
+    }
+    encodeLimit_ = size_t(threads) * 2;
+    encoders_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        encoders_.emplace_back([this] { encoderLoop(); });
+    }
+}
+
+ExportPipeline::~ExportPipeline() {
+    cancel();
+
+    for (auto& slot : slots_) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        if (slot.pbo) glDeleteBuffers(1, &slot.pbo);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(encodeMutex_);
+        stopping_ = true;
+    }
+    encodeWake_.notify_all();
+    for (auto& t : encoders_) t.join();
+}
+
+bool ExportPipeline::finished() const {
+    if (cancelled_) return slotsBusy_ == 0 && encoding_ == 0;
+    return queue_->exhausted() && loading_.empty() && ready_.empty() &&
+           slotsBusy_ == 0 && encoding_ == 0;
+}
+
+void ExportPipeline::failAll(const char* reason) {
+    std::cerr << reason << std::endl;
+    size_t index;
+    while (queue_->take(index)) failed_++;
+}
+
+void ExportPipeline::cancel() {
+    if (cancelled_) return;
+    cancelled_ = true;
+
+    loader_.cancelAll();
+    loading_.clear();
+    ready_.clear();
+
+    // Frames already written keep going; queued ones are dropped
+    std::lock_guard<std::mutex> lock(encodeMutex_);
+    encoding_ -= encodeQueue_.size();
+    encodeQueue_.clear();
+}
+
+// ── Load stage ──────────────────────────────────────────────────────────────
+
+bool ExportPipeline::feedLoads() {
+    bool progressed = false;
+    size_t index;
+    while (!cancelled_ && loading_.size() + ready_.size() < options_.prefetch && queue_->take(index)) {
+        const ExportItem& item = (*queue_)[index];
+        if (item.model) {
+            ready_.push_back({index, item.model});
+        } else {
+            loading_[loader_.enqueue(item.input, options_.loadOptions)] = index;
+        }
+        progressed = true;
+    }
+    return progressed;
+}
+
+bool ExportPipeline::collectLoads(bool block) {
+    std::vector<LoadResult> results = block ? loader_.waitFinished() : loader_.takeFinished();
+    for (auto& r : results) {
+        auto it = loading_.find(r.id);
+        if (it == loading_.end()) continue;   // Cancelled
+        size_t item = it->second;
+        loading_.erase(it);
+
+        if (r.state == LoadState::Done) {
+            ready_.push_back({item, std::make_shared<const STLModel>(std::move(r.model))});
+        } else {
+            // Still queued so a raw stream can step past it in order
+            std::cerr << "Failed to load: " << (*queue_)[item].input << std::endl;
+            ready_.push_back({item, nullptr});
+        }
+    }
+    return !results.empty();
+}
+
+// ── Render + readback stages ────────────────────────────────────────────────
+
+bool ExportPipeline::renderReady() {
+    if (tiled_) return renderTiledReady();
+
+    bool progressed = false;
+    const int w = layout_.width();
+    const int h = layout_.height();
+
+    while (!ready_.empty() && slotsBusy_ < slots_.size()) {
+        {
+            // Don't outrun the encoders; finished frames would pile up in RAM
+            std::lock_guard<std::mutex> lock(encodeMutex_);
+            if (encodeQueue_.size() >= encodeLimit_) break;
+        }
+
+        // Files can be rendered in any order; a raw stream can't
+        auto it = ready_.begin();
+        if (options_.rawSink) {
+            it = std::find_if(ready_.begin(), ready_.end(),
+                              [this](const Ready& r) { return r.item == nextRender_; });
+            if (it == ready_.end()) break;
+            nextRender_++;
+        }
+        Ready next = std::move(*it);
+        ready_.erase(it);
+        progressed = true;
+
+        if (!next.model) {
+            failed_++;
+            continue;
+        }
+
+        // Meshes that weren't cached before are drawn once; don't let them
+        // push the viewer's models out of VRAM
+        bool wasResident = renderer_.isResident(next.model->revision);
+        bool drawn = options_.views.empty()
+            ? renderer_.renderOffscreen(*next.model, settings_, w, h)
+            : renderer_.renderViewsOffscreen(*next.model, settings_, options_.views, layout_);
+        if (!drawn) {
+            failed_++;
+            continue;
+        }
+
+        // Asynchronous readback: the copy lands in the PBO while we go on
+        Slot& slot = slots_[slotTail_];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.item  = next.item;
+        slot.busy  = true;
+        renderer_.endOffscreen();
+        if (!wasResident) renderer_.evict(next.model->revision);
+
+        slotTail_ = (slotTail_ + 1) % slots_.size();
+        slotsBusy_++;
+    }
+
+    if (progressed) glFlush();   // Get the queued frames to the GPU now
+    return progressed;
+}
+
+bool ExportPipeline::renderTiledReady() {
+    // One image per call: a poster can take seconds, and the GUI should get
+    // a frame in between
+    auto it = ready_.begin();
+    if (options_.rawSink) {
+        it = std::find_if(ready_.begin(), ready_.end(),
+                          [this](const Ready& r) { return r.item == nextRender_; });
+    }
+    if (it == ready_.end()) return false;
+    Ready next = std::move(*it);
+    ready_.erase(it);
+    if (options_.rawSink) nextRender_++;
+
+    if (!next.model) {
+        failed_++;
+        return true;
+    }
+
+    const int w = settings_.exportWidth;
+    const int h = settings_.exportHeight;
+    bool wasResident = renderer_.isResident(next.model->revision);
+    bool ok;
+
+    if (options_.rawSink) {
+        std::vector<unsigned char> band, frame;
+        ok = renderer_.renderTiled(*next.model, settings_, w, h, options_.tileSize,
+            [&](const unsigned char* rgba, int rows) {
+                band.assign(rgba, rgba + size_t(w) * rows * 4);
+                if (!encoder_->encode(w, rows, band, frame)) return false;
+                return std::fwrite(frame.data(), 1, frame.size(), options_.rawSink) == frame.size();
+            });
+        if (!ok) {
+            std::cerr << "Raw output write failed" << std::endl;
+            cancel();
+        }
+    } else {
+        // The header goes out before any pixels, so Auto alpha is decided
+        // from the colors: nothing is blended, output alpha is theirs
+        Exporter::PNGOptions png = options_.format.png;
+        png.threads = 0;   // The GL thread waits on this anyway
+        if (png.alpha == Exporter::AlphaMode::Auto) {
+            const auto& s = settings_;
+            bool opaque = s.bgColor[3] >= 1.0f && s.modelColor[3] >= 1.0f &&
+                          (!s.wireframe || s.edgeColor[3] >= 1.0f);
+            png.alpha = opaque ? Exporter::AlphaMode::Drop : Exporter::AlphaMode::Keep;
+        }
+
+        Exporter::PNGStreamWriter writer;
+        ok = writer.open((*queue_)[next.item].output, w, h, png) &&
+             renderer_.renderTiled(*next.model, settings_, w, h, options_.tileSize,
+                 [&](const unsigned char* rgba, int rows) { return writer.writeRows(rgba, rows); }) &&
+             writer.finish();
+    }
+    if (!wasResident) renderer_.evict(next.model->revision);
+
+    if (ok) succeeded_++;
+    else    failed_++;
+    return true;
+}
+
+bool ExportPipeline::retireReadbacks(bool block) {
+    bool progressed = false;
+
+    while (slotsBusy_ > 0) {
+        Slot& slot = slots_[slotHead_];
+
+        // Only the first wait may block; later slots are taken if already done
+        GLuint64 timeout = block && !progressed ? GLuint64(1000000000) : 0;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            if (block && !progressed) continue;
+            break;
+        }
+
+        bool ok = status != GL_WAIT_FAILED;
+        EncodeTask task;
+        if (ok && !cancelled_) {
+            PROFILE_SCOPE("export.readback");
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            auto* src = static_cast<const unsigned char*>(
+                glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes_, GL_MAP_READ_BIT));
+            if (src) {
+                // renderOffscreen() already drew top-down
+                task.pixels.assign(src, src + frameBytes_);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            } else {
+                ok = false;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        slot.busy  = false;
+        slotHead_  = (slotHead_ + 1) % slots_.size();
+        slotsBusy_--;
+        progressed = true;
+
+        if (cancelled_) continue;
+        if (!ok) {
+            std::cerr << "Readback failed: " << (*queue_)[slot.item].output << std::endl;
+            failed_++;
+            continue;
+        }
+        if (options_.rawSink) {
+            // Ring order is render order, so the stream stays in item order
+            if (writeRaw(task)) succeeded_++;
+            else                failed_++;
+            continue;
+        }
+        task.path = (*queue_)[slot.item].output;
+        submitEncode(std::move(task));
+    }
+    return progressed;
+}
+
+// ── Encode stage ────────────────────────────────────────────────────────────
+
+bool ExportPipeline::writeRaw(const EncodeTask& task) {
+    // Raw "encoding" is at most an RGBA -> RGB pack; not worth a thread hop
+    const size_t frames = options_.splitViews ? options_.views.size() : 1;
+    std::vector<unsigned char> tile, frame;
+    for (size_t i = 0; i < frames; ++i) {
+        int fw = layout_.width(), fh = layout_.height();
+        const std::vector<unsigned char>* src = &task.pixels;
+        if (options_.splitViews) {
+            fw = layout_.tileWidth;
+            fh = layout_.tileHeight;
+            Exporter::cropImage(task.pixels, layout_.width(),
+                                int(i % layout_.columns) * fw, int(i / layout_.columns) * fh, fw, fh, tile);
+            src = &tile;
+        }
+        {
+            PROFILE_SCOPE("export.encode");
+            if (!encoder_->encode(fw, fh, *src, frame)) return false;
+        }
+        PROFILE_SCOPE("export.write");
+        if (std::fwrite(frame.data(), 1, frame.size(), options_.rawSink) != frame.size()) {
+            std::cerr << "Raw output write failed" << std::endl;
+            cancel();   // The reader has gone away; nothing downstream can use more frames
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ExportPipeline::writeFile(const EncodeTask& task) {
+    if (!options_.splitViews) {
+        return Exporter::saveImage(task.path, layout_.width(), layout_.height(), task.pixels, *encoder_);
+    }
+
+    // One readback, cut into frames here on the encoder thread
+    bool ok = true;
+    std::vector<unsigned char> tile;
+    for (size_t i = 0; i < options_.views.size(); ++i) {
+        Exporter::cropImage(task.pixels, layout_.width(),
+                            int(i % layout_.columns) * layout_.tileWidth,
+                            int(i / layout_.columns) * layout_.tileHeight,
+                            layout_.tileWidth, layout_.tileHeight, tile);
+        ok = Exporter::saveImage(Exporter::framePath(task.path, i),
+                                 layout_.tileWidth, layout_.tileHeight, tile, *encoder_) && ok;
+    }
+    return ok;
+}
+
+void ExportPipeline::submitEncode(EncodeTask task) {
+    encoding_++;
+    {
+        std::lock_guard<std::mutex> lock(encodeMutex_);
+        encodeQueue_.push_back(std::move(task));
+    }
+    encodeWake_.notify_one();
+}
+
+void ExportPipeline::encoderLoop() {
+    for (;;) {
+        EncodeTask task;
+        {
+            std::unique_lock<std::mutex> lock(encodeMutex_);
+            encodeWake_.wait(lock, [this] { return stopping_ || !encodeQueue_.empty(); });
+            if (encodeQueue_.empty()) return;
+            task = std::move(encodeQueue_.front());
+            encodeQueue_.pop_front();
+        }
+
+        bool ok = writeFile(task);
+        if (ok) succeeded_++;
+        else    failed_++;
+
+        {
+            std::lock_guard<std::mutex> lock(encodeMutex_);
+            encoding_--;
+        }
+        encodeDone_.notify_all();
+    }
+}
+
+// ── Driving ─────────────────────────────────────────────────────────────────
+
+bool ExportPipeline::step() {
+    // Retire first so render has free slots, and feed after collecting so
+    // the prefetch window refills as soon as models land
+    retireReadbacks(false);
+    collectLoads(false);
+    feedLoads();
+    renderReady();
+    return !finished();
+}
+
+void ExportPipeline::run(const std::atomic<bool>* stop) {
+    while (step()) {
+        if (stop && *stop) cancel();
+        // Block on whichever stage is holding things up
+        if (slotsBusy_ > 0 && (ready_.empty() || slotsBusy_ == slots_.size())) {
+            retireReadbacks(true);
+        } else if (ready_.empty() && !loading_.empty()) {
+            collectLoads(true);
+        } else {
+            std::unique_lock<std::mutex> lock(encodeMutex_);
+            encodeDone_.wait_for(lock, std::chrono::milliseconds(5));
+        }
+    }
+}
@@ -1,43 +1,717 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 #include "exporter.h"
+#include "parallel.h"
+#include "profiler.h"
 
+#include <zlib.h>
+#ifdef STL_VIEWER_HAS_WEBP
+#include <webp/encode.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 
 namespace fs = std::filesystem;
 
 namespace Exporter {
 
-bool savePNG(const std::string& filepath,
-             int width, int height,
-             const std::vector<unsigned char>& pixels) {
-    // Ensure output directory exists
+// ── PNG encoding ────────────────────────────────────────────────────────────
+
+namespace {
+
+constexpr size_t kMinStripBytes = 256 * 1024;   // Smaller strips lose too much ratio
+constexpr size_t kWindowSize    = 32 * 1024;    // Deflate window / priming dictionary
+
+struct DeflateParams {
+    int  level;
+    int  strategy;
+    bool adaptiveFilter;
+};
+
+DeflateParams paramsFor(PNGCompression c) {
+    switch (c) {
+        case PNGCompression::Fast:  return {1, Z_RLE, false};
+        case PNGCompression::Small: return {9, Z_DEFAULT_STRATEGY, true};
+        default:                    return {6, Z_DEFAULT_STRATEGY, true};
+    }
+}
+
+void putU32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+void writeChunk(std::vector<unsigned char>& out, const char type[4],
+                const unsigned char* data, size_t size) {
+    putU32(out, uint32_t(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size) out.insert(out.end(), data, data + size);
+    uLong crc = crc32(0L, out.data() + start, uInt(size + 4));
+    putU32(out, uint32_t(crc));
+}
+
+inline unsigned char paeth(int a, int b, int c) {
+    int p  = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return (unsigned char)a;
+    return (unsigned char)(pb <= pc ? b : c);
+}
+
+// Filter one scanline into out[0] = filter type, out[1..rowBytes] = data.
+// `prev` is null for the first row.
+void filterRow(const unsigned char* cur, const unsigned char* prev, size_t rowBytes, int bpp,
+               bool adaptive, unsigned char* out, std::vector<unsigned char>& scratch) {
+    const size_t lead = std::min(size_t(bpp), rowBytes);
+    auto apply = [&](int type, unsigned char* dst) {
+        switch (type) {
+            case 0:
+                std::memcpy(dst, cur, rowBytes);
+                break;
+            case 1:
+                std::memcpy(dst, cur, lead);
+                for (size_t i = lead; i < rowBytes; ++i) dst[i] = (unsigned char)(cur[i] - cur[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < rowBytes; ++i) dst[i] = (unsigned char)(cur[i] - prev[i]);
+                break;
+            case 3:
+                for (size_t i = 0; i < lead; ++i) dst[i] = (unsigned char)(cur[i] - (prev[i] >> 1));
+                for (size_t i = lead; i < rowBytes; ++i)
+                    dst[i] = (unsigned char)(cur[i] - ((cur[i - bpp] + prev[i]) >> 1));
+                break;
+            case 4:
+                for (size_t i = 0; i < lead; ++i) dst[i] = (unsigned char)(cur[i] - prev[i]);
+                for (size_t i = lead; i < rowBytes; ++i)
+                    dst[i] = (unsigned char)(cur[i] - paeth(cur[i - bpp], prev[i], prev[i - bpp]));
+                break;
+        }
+    };
+
+    if (!adaptive) {
+        out[0] = 1;
+        apply(1, out + 1);
+        return;
+    }
+
+    // Minimum sum of absolute (signed) differences, as libpng does
+    scratch.resize(rowBytes);
+    uint64_t best = UINT64_MAX;
+    for (int type = 0; type <= 4; ++type) {
+        if (type >= 2 && !prev) break;   // Up/Avg/Paeth degrade to None/Sub on row 0
+        apply(type, scratch.data());
+        uint64_t sum = 0;
+        for (size_t i = 0; i < rowBytes; ++i) sum += std::abs(int(int8_t(scratch[i])));
+        if (sum < best) {
+            best = sum;
+            out[0] = (unsigned char)type;
+            std::memcpy(out + 1, scratch.data(), rowBytes);
+        }
+    }
+}
+
+// Raw-deflate one strip. All but the last end on a byte boundary
+// (Z_SYNC_FLUSH) so the strips concatenate into a single stream.
+bool deflateStrip(const unsigned char* data, size_t size,
+                  const unsigned char* dict, size_t dictSize,
+                  const DeflateParams& params, bool last,
+                  std::vector<unsigned char>& out) {
+    z_stream zs{};
+    if (deflateInit2(&zs, params.level, Z_DEFLATED, -15, 8, params.strategy) != Z_OK) return false;
+    if (dictSize) deflateSetDictionary(&zs, dict, uInt(dictSize));
+
+    out.resize(deflateBound(&zs, uLong(size)) + 64);
+    zs.next_in   = const_cast<Bytef*>(data);
+    zs.avail_in  = uInt(size);
+    zs.next_out  = out.data();
+    zs.avail_out = uInt(out.size());
+
+    // Spare output space after a call means the flush / finish completed
+    int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    int rc;
+    for (;;) {
+        rc = deflate(&zs, flush);
+        if (rc == Z_STREAM_ERROR || zs.avail_out > 0) break;
+        size_t used = out.size() - zs.avail_out;
+        out.resize(out.size() * 2);
+        zs.next_out  = out.data() + used;
+        zs.avail_out = uInt(out.size() - used);
+    }
+    out.resize(out.size() - zs.avail_out);
+    deflateEnd(&zs);
+    return last ? rc == Z_STREAM_END : rc == Z_OK;
+}
+
+} // namespace
+
+bool parseCompression(const std::string& name, PNGCompression& out) {
+    if      (name == "fast")     out = PNGCompression::Fast;
+    else if (name == "balanced") out = PNGCompression::Balanced;
+    else if (name == "small")    out = PNGCompression::Small;
+    else return false;
+    return true;
+}
+
+namespace {
+
+// Filters and deflates rows band by band into one zlib stream, emitting an
+// IDAT per strip. encodePNG() feeds the whole image as one band;
+// PNGStreamWriter feeds it a band at a time. Strips within a band deflate in
+// parallel, each primed with the preceding 32 KB of filtered data, including
+// across band boundaries.
+class BandEncoder {
+public:
+    using Sink = std::function<bool(const unsigned char*, size_t)>;
+
+    BandEncoder(int width, int height, bool keepAlpha, const PNGOptions& options, Sink sink)
+        : width_(width), height_(height),
+          bpp_(keepAlpha ? 4 : 3),
+          rowBytes_(size_t(width) * bpp_),
+          lineSize_(rowBytes_ + 1),
+          threads_(Parallel::threadCount(options.threads)),
+          params_(paramsFor(options.compression)),
+          sink_(std::move(sink)),
+          adler_(adler32(0L, nullptr, 0)) {}
+
+    // Signature + IHDR
+    bool begin() {
+        static const unsigned char kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        std::vector<unsigned char> out(kSignature, kSignature + 8);
+
+        unsigned char ihdr[13];
+        ihdr[0] = (unsigned char)(width_ >> 24);  ihdr[1] = (unsigned char)(width_ >> 16);
+        ihdr[2] = (unsigned char)(width_ >> 8);   ihdr[3] = (unsigned char)width_;
+        ihdr[4] = (unsigned char)(height_ >> 24); ihdr[5] = (unsigned char)(height_ >> 16);
+        ihdr[6] = (unsigned char)(height_ >> 8);  ihdr[7] = (unsigned char)height_;
+        ihdr[8]  = 8;                      // Bit depth
+        ihdr[9]  = bpp_ == 4 ? 6 : 2;      // RGBA / RGB
+        ihdr[10] = ihdr[11] = ihdr[12] = 0;
+        writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+        return sink_(out.data(), out.size());
+    }
+
+    // `rows` packed scanlines (bpp 3 or 4, matching keepAlpha); the band
+    // that reaches `height` also closes the zlib stream and writes IEND
+    bool addRows(const unsigned char* image, size_t rows) {
+        if (rows == 0 || rowsDone_ + rows > size_t(height_)) return false;
+        const bool last = rowsDone_ + rows == size_t(height_);
+
+        // 1. Filter every row. A row depends only on itself and the raw row
+        //    above, so rows filter independently.
+        //    Layout: [window from earlier bands][this band's filtered rows]
+        const size_t dictSize = window_.size();
+        filtered_.resize(dictSize + lineSize_ * rows);
+        std::copy(window_.begin(), window_.end(), filtered_.begin());
+        unsigned char* band = filtered_.data() + dictSize;
+
+        size_t minRows = std::max<size_t>(1, kMinStripBytes / lineSize_);
+        Parallel::forChunks(rows, minRows, threads_, [&](size_t b, size_t e, size_t) {
+            std::vector<unsigned char> scratch;
+            for (size_t y = b; y < e; ++y) {
+                const unsigned char* cur  = image + y * rowBytes_;
+                const unsigned char* prev = y > 0 ? cur - rowBytes_
+                                          : rowsDone_ > 0 ? prevRow_.data() : nullptr;
+                filterRow(cur, prev, rowBytes_, bpp_, params_.adaptiveFilter, band + y * lineSize_, scratch);
+            }
+        });
+
+        // 2. Deflate strips in parallel; each is primed with the preceding
+        //    window so back-references across strip boundaries still work
+        size_t numStrips = Parallel::chunkCount(rows, minRows, threads_);
+        std::vector<std::vector<unsigned char>> strips(numStrips);
+        std::vector<uLong>  adlers(numStrips);
+        std::vector<size_t> lengths(numStrips);
+        std::vector<char>   ok(numStrips, 0);
+        Parallel::forChunks(rows, minRows, threads_, [&](size_t b, size_t e, size_t s) {
+            const unsigned char* data = band + b * lineSize_;
+            size_t size = (e - b) * lineSize_;
+            size_t primed = std::min(size_t(data - filtered_.data()), kWindowSize);
+            ok[s] = deflateStrip(data, size, data - primed, primed, params_,
+                                 last && s + 1 == numStrips, strips[s]);
+            adlers[s]  = adler32(adler32(0L, nullptr, 0), data, uInt(size));
+            lengths[s] = size;
+        });
+        if (std::find(ok.begin(), ok.end(), 0) != ok.end()) return false;
+        for (size_t s = 0; s < numStrips; ++s) adler_ = adler32_combine(adler_, adlers[s], z_off_t(lengths[s]));
+
+        // 3. zlib header before the first strip, adler32 after the last
+        if (rowsDone_ == 0) {
+            strips.front().insert(strips.front().begin(),
+                                  {0x78, (unsigned char)(params_.level <= 1 ? 0x01 : params_.level >= 9 ? 0xDA : 0x9C)});
+        }
+        if (last) {
+            auto& tail = strips.back();
+            tail.push_back((unsigned char)(adler_ >> 24));
+            tail.push_back((unsigned char)(adler_ >> 16));
+            tail.push_back((unsigned char)(adler_ >> 8));
+            tail.push_back((unsigned char)adler_);
+        }
+
+        size_t total = 12;
+        for (const auto& s : strips) total += s.size() + 12;
+        std::vector<unsigned char> out;
+        out.reserve(total);
+        for (const auto& s : strips) writeChunk(out, "IDAT", s.data(), s.size());
+        if (last) writeChunk(out, "IEND", nullptr, 0);
+        if (!sink_(out.data(), out.size())) return false;
+
+        // Carry the dictionary window and the last raw row into the next band
+        if (!last) {
+            size_t keep = std::min(filtered_.size(), kWindowSize);
+            window_.assign(filtered_.end() - keep, filtered_.end());
+            prevRow_.assign(image + (rows - 1) * rowBytes_, image + rows * rowBytes_);
+        }
+        rowsDone_ += rows;
+        return true;
+    }
+
+    size_t rowsDone() const { return rowsDone_; }
+
+private:
+    int           width_, height_;
+    int           bpp_;
+    size_t        rowBytes_, lineSize_;
+    unsigned      threads_;
+    DeflateParams params_;
+    Sink          sink_;
+
+    size_t                     rowsDone_ = 0;
+    uLong                      adler_;
+    std::vector<unsigned char> window_;     // Last <= 32 KB of filtered data
+    std::vector<unsigned char> prevRow_;    // Last raw row of the previous band
+    std::vector<unsigned char> filtered_;
+};
+
+// RGBA -> RGB
+void packRGB(const unsigned char* rgba, size_t numPixels, unsigned threads, std::vector<unsigned char>& out) {
+    out.resize(numPixels * 3);
+    Parallel::forChunks(numPixels, 1 << 18, threads, [&](size_t b, size_t e, size_t) {
+        for (size_t i = b; i < e; ++i) {
+            out[i * 3 + 0] = rgba[i * 4 + 0];
+            out[i * 3 + 1] = rgba[i * 4 + 1];
+            out[i * 3 + 2] = rgba[i * 4 + 2];
+        }
+    });
+}
+
+} // namespace
+
+bool encodePNG(int width, int height,
+               const std::vector<unsigned char>& pixels,
+               const PNGOptions& options,
+               std::vector<unsigned char>& out) {
+    if (width <= 0 || height <= 0 || pixels.size() < size_t(width) * height * 4) return false;
+
+    const size_t numPixels = size_t(width) * height;
+    const unsigned threads = Parallel::threadCount(options.threads);
+
+    bool keepAlpha = options.alpha == AlphaMode::Keep;
+    if (options.alpha == AlphaMode::Auto) {
+        for (size_t i = 3; i < numPixels * 4; i += 4) {
+            if (pixels[i] != 255) { keepAlpha = true; break; }
+        }
+    }
+
+    // Pack to RGB if alpha is dropped
+    std::vector<unsigned char> rgb;
+    const unsigned char* image = pixels.data();
+    if (!keepAlpha) {
+        packRGB(pixels.data(), numPixels, threads, rgb);
+        image = rgb.data();
+    }
+
+    out.clear();
+    out.reserve(numPixels * (keepAlpha ? 4 : 3) / 2);
+    BandEncoder encoder(width, height, keepAlpha, options, [&](const unsigned char* data, size_t size) {
+        out.insert(out.end(), data, data + size);
+        return true;
+    });
+    return encoder.begin() && encoder.addRows(image, size_t(height));
+}
+
+// ── Streaming PNG ───────────────────────────────────────────────────────────
+
+struct PNGStreamWriter::State {
+    FILE*                      file = nullptr;
+    std::unique_ptr<BandEncoder> encoder;
+    std::vector<unsigned char> rgb;
+    unsigned                   threads = 1;
+    int                        width = 0, height = 0;
+    size_t                     bytes = 0;
+};
+
+PNGStreamWriter::PNGStreamWriter() = default;
+
+PNGStreamWriter::~PNGStreamWriter() {
+    if (state_ && state_->file) {
+        // Never finished: don't leave a truncated image behind
+        std::fclose(state_->file);
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+}
+
+bool PNGStreamWriter::open(const std::string& filepath, int width, int height,
+                           const PNGOptions& options) {
+    if (width <= 0 || height <= 0) return false;
+
     auto parent = fs::path(filepath).parent_path();
     if (!parent.empty()) {
-        fs::create_directories(parent);
+        std::error_code ec;
+        fs::create_directories(parent, ec);
+    }
+
+    state_ = std::make_unique<State>();
+    path_  = filepath;
+    state_->file = std::fopen(filepath.c_str(), "wb");
+    if (!state_->file) {
+        std::cerr << "Failed to write: " << filepath << std::endl;
+        return false;
     }
 
-    int ok = stbi_write_png(filepath.c_str(), width, height, 4, pixels.data(), width * 4);
+    // Rows arrive before we could scan them, so Auto can't look at the data
+    // and keeps alpha; only an explicit Drop writes RGB
+    keepAlpha_ = options.alpha != AlphaMode::Drop;
+    state_->threads = Parallel::threadCount(options.threads);
+    state_->width   = width;
+    state_->height  = height;
+    State* st = state_.get();
+    state_->encoder = std::make_unique<BandEncoder>(width, height, keepAlpha_, options,
+        [st](const unsigned char* data, size_t size) {
+            st->bytes += size;
+            return std::fwrite(data, 1, size, st->file) == size;
+        });
+    return state_->encoder->begin();
+}
+
+bool PNGStreamWriter::writeRows(const unsigned char* rgba, int rows) {
+    if (!state_ || !state_->file || rows <= 0) return false;
+    const unsigned char* image = rgba;
+    if (!keepAlpha_) {
+        packRGB(rgba, size_t(state_->width) * rows, state_->threads, state_->rgb);
+        image = state_->rgb.data();
+    }
+    return state_->encoder->addRows(image, size_t(rows));
+}
+
+bool PNGStreamWriter::finish() {
+    if (!state_ || !state_->file) return false;
+    bool complete = state_->encoder->rowsDone() == size_t(state_->height);
+    bool ok = std::fclose(state_->file) == 0 && complete;
+    state_->file = nullptr;
+
     if (ok) {
-        auto size = fs::file_size(filepath);
-        std::cout << "Exported: " << filepath << " (" << size / 1024 << " KB)" << std::endl;
+        std::cout << "Exported: " << path_ << " (" << state_->bytes / 1024 << " KB)" << std::endl;
+    } else {
+        std::cerr << "Failed to write: " << path_ << std::endl;
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+    return ok;
+}
+
+// ── Other formats ───────────────────────────────────────────────────────────
+
+namespace {
+
+bool isOpaque(const std::vector<unsigned char>& pixels, size_t numPixels) {
+    for (size_t i = 3; i < numPixels * 4; i += 4) {
+        if (pixels[i] != 255) return false;
+    }
+    return true;
+}
+
+// Every format except PNG (which decides internally) resolves Auto here
+int channelsFor(AlphaMode mode, const std::vector<unsigned char>& pixels, size_t numPixels) {
+    if (mode == AlphaMode::Keep) return 4;
+    if (mode == AlphaMode::Drop) return 3;
+    return isOpaque(pixels, numPixels) ? 3 : 4;
+}
+
+void appendCallback(void* ctx, void* data, int size) {
+    auto* out = static_cast<std::vector<unsigned char>*>(ctx);
+    auto* bytes = static_cast<unsigned char*>(data);
+    out->insert(out->end(), bytes, bytes + size);
+}
+
+class PNGEncoder : public ImageEncoder {
+public:
+    explicit PNGEncoder(const PNGOptions& o) : options(o) {}
+    const char* extension() const override { return "png"; }
+    bool encode(int w, int h, const std::vector<unsigned char>& px,
+                std::vector<unsigned char>& out) const override {
+        return encodePNG(w, h, px, options, out);
+    }
+private:
+    PNGOptions options;
+};
+
+// QOI (qoiformat.org): one pass, a 64-entry color cache, runs and small deltas
+class QOIEncoder : public ImageEncoder {
+public:
+    explicit QOIEncoder(AlphaMode a) : alpha(a) {}
+    const char* extension() const override { return "qoi"; }
+
+    bool encode(int w, int h, const std::vector<unsigned char>& px,
+                std::vector<unsigned char>& out) const override {
+        const size_t numPixels = size_t(w) * h;
+        if (w <= 0 || h <= 0 || px.size() < numPixels * 4) return false;
+        const int channels = channelsFor(alpha, px, numPixels);
+
+        out.clear();
+        out.reserve(numPixels * 2 + 22);
+        const unsigned char header[14] = {
+            'q', 'o', 'i', 'f',
+            (unsigned char)(w >> 24), (unsigned char)(w >> 16), (unsigned char)(w >> 8), (unsigned char)w,
+            (unsigned char)(h >> 24), (unsigned char)(h >> 16), (unsigned char)(h >> 8), (unsigned char)h,
+            (unsigned char)channels, 0};
+        out.insert(out.end(), header, header + 14);
+
+        struct Px { unsigned char r, g, b, a; };
+        Px index[64] = {};
+        Px prev{0, 0, 0, 255};
+        int run = 0;
+
+        for (size_t i = 0; i < numPixels; ++i) {
+            const unsigned char* p = &px[i * 4];
+            Px cur{p[0], p[1], p[2], channels == 4 ? p[3] : (unsigned char)255};
+
+            if (cur.r == prev.r && cur.g == prev.g && cur.b == prev.b && cur.a == prev.a) {
+                if (++run == 62 || i + 1 == numPixels) {
+                    out.push_back((unsigned char)(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back((unsigned char)(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            int slot = (cur.r * 3 + cur.g * 5 + cur.b * 7 + cur.a * 11) % 64;
+            const Px& cached = index[slot];
+            if (cached.r == cur.r && cached.g == cur.g && cached.b == cur.b && cached.a == cur.a) {
+                out.push_back((unsigned char)slot);
+            } else {
+                index[slot] = cur;
+                if (cur.a == prev.a) {
+                    int dr = int8_t(cur.r - prev.r);
+                    int dg = int8_t(cur.g - prev.g);
+                    int db = int8_t(cur.b - prev.b);
+                    int drg = dr - dg, dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back((unsigned char)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out.push_back((unsigned char)(0x80 | (dg + 32)));
+                        out.push_back((unsigned char)((drg + 8) << 4 | (dbg + 8)));
+                    } else {
+                        out.insert(out.end(), {0xFE, cur.r, cur.g, cur.b});
+                    }
+                } else {
+                    out.insert(out.end(), {0xFF, cur.r, cur.g, cur.b, cur.a});
+                }
+            }
+            prev = cur;
+        }
+
+        out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+        return true;
+    }
+
+private:
+    AlphaMode alpha;
+};
+
+class JPEGEncoder : public ImageEncoder {
+public:
+    explicit JPEGEncoder(int q) : quality(q) {}
+    const char* extension() const override { return "jpg"; }
+    bool encode(int w, int h, const std::vector<unsigned char>& px,
+                std::vector<unsigned char>& out) const override {
+        out.clear();
+        // stb drops the fourth channel; JPEG has no alpha
+        return stbi_write_jpg_to_func(appendCallback, &out, w, h, 4, px.data(), quality) != 0;
+    }
+private:
+    int quality;
+};
+
+#ifdef STL_VIEWER_HAS_WEBP
+class WebPEncoder : public ImageEncoder {
+public:
+    WebPEncoder(int q, AlphaMode a) : quality(q), alpha(a) {}
+    const char* extension() const override { return "webp"; }
+    bool encode(int w, int h, const std::vector<unsigned char>& px,
+                std::vector<unsigned char>& out) const override {
+        uint8_t* data = nullptr;
+        size_t size;
+        if (channelsFor(alpha, px, size_t(w) * h) == 4) {
+            size = WebPEncodeRGBA(px.data(), w, h, w * 4, float(quality), &data);
+        } else {
+            // libwebp takes RGBX input only through the RGBA entry point, so
+            // pack to RGB rather than encode an all-opaque alpha plane
+            std::vector<unsigned char> rgb(size_t(w) * h * 3);
+            for (size_t i = 0, n = size_t(w) * h; i < n; ++i) {
+                std::memcpy(&rgb[i * 3], &px[i * 4], 3);
+            }
+            size = WebPEncodeRGB(rgb.data(), w, h, w * 3, float(quality), &data);
+        }
+        if (size == 0) return false;
+        out.assign(data, data + size);
+        WebPFree(data);
+        return true;
+    }
+private:
+    int       quality;
+    AlphaMode alpha;
+};
+#endif
+
+// Tightly packed frames, no header: `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -`
+class RawEncoder : public ImageEncoder {
+public:
+    explicit RawEncoder(AlphaMode a) : alpha(a) {}
+    const char* extension() const override { return "rgba"; }
+    bool encode(int w, int h, const std::vector<unsigned char>& px,
+                std::vector<unsigned char>& out) const override {
+        const size_t numPixels = size_t(w) * h;
+        if (px.size() < numPixels * 4) return false;
+        // A stream needs one pixel format throughout, so Auto keeps alpha
+        if (alpha != AlphaMode::Drop) {
+            out.assign(px.begin(), px.begin() + numPixels * 4);
+            return true;
+        }
+        out.resize(numPixels * 3);
+        for (size_t i = 0; i < numPixels; ++i) std::memcpy(&out[i * 3], &px[i * 4], 3);
+        return true;
+    }
+private:
+    AlphaMode alpha;
+};
+
+} // namespace
+
+std::unique_ptr<ImageEncoder> makeEncoder(const ExportFormat& f) {
+    int quality = std::clamp(f.quality, 1, 100);
+    switch (f.format) {
+        case ImageFormat::PNG:  return std::make_unique<PNGEncoder>(f.png);
+        case ImageFormat::QOI:  return std::make_unique<QOIEncoder>(f.png.alpha);
+        case ImageFormat::JPEG: return std::make_unique<JPEGEncoder>(quality);
+#ifdef STL_VIEWER_HAS_WEBP
+        case ImageFormat::WebP: return std::make_unique<WebPEncoder>(quality, f.png.alpha);
+#endif
+        case ImageFormat::Raw:  return std::make_unique<RawEncoder>(f.png.alpha);
+        default:                return nullptr;
+    }
+}
+
+bool formatAvailable(ImageFormat format) {
+#ifdef STL_VIEWER_HAS_WEBP
+    (void)format;
+    return true;
+#else
+    return format != ImageFormat::WebP;
+#endif
+}
+
+const char* formatExtension(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::QOI:  return "qoi";
+        case ImageFormat::JPEG: return "jpg";
+        case ImageFormat::WebP: return "webp";
+        case ImageFormat::Raw:  return "rgba";
+        default:                return "png";
+    }
+}
+
+bool parseFormat(const std::string& name, ImageFormat& out) {
+    if      (name == "png")                   out = ImageFormat::PNG;
+    else if (name == "qoi")                   out = ImageFormat::QOI;
+    else if (name == "jpeg" || name == "jpg") out = ImageFormat::JPEG;
+    else if (name == "webp")                  out = ImageFormat::WebP;
+    else if (name == "raw")                   out = ImageFormat::Raw;
+    else return false;
+    return true;
+}
+
+// ── Files ───────────────────────────────────────────────────────────────────
+
+bool saveImage(const std::string& filepath,
+               int width, int height,
+               const std::vector<unsigned char>& pixels,
+               const ImageEncoder& encoder) {
+    // Ensure output directory exists (may race with other encoder threads)
+    auto parent = fs::path(filepath).parent_path();
+    if (!parent.empty()) {
+        std::error_code ec;
+        fs::create_directories(parent, ec);
+    }
+
+    std::vector<unsigned char> data;
+    bool ok;
+    {
+        PROFILE_SCOPE("export.encode");
+        ok = encoder.encode(width, height, pixels, data);
+    }
+    if (ok) {
+        PROFILE_SCOPE("export.write");
+        FILE* f = std::fopen(filepath.c_str(), "wb");
+        ok = f && std::fwrite(data.data(), 1, data.size(), f) == data.size();
+        if (f) ok = std::fclose(f) == 0 && ok;
+    }
+
+    if (ok) {
+        std::cout << "Exported: " << filepath << " (" << data.size() / 1024 << " KB)" << std::endl;
     } else {
         std::cerr << "Failed to write: " << filepath << std::endl;
     }
-    return ok != 0;
+    return ok;
+}
+
+bool savePNG(const std::string& filepath,
+             int width, int height,
+             const std::vector<unsigned char>& pixels,
+             const PNGOptions& options) {
+    return saveImage(filepath, width, height, pixels, PNGEncoder(options));
 }
 
-std::string deriveOutputPath(const std::string& stlPath, const std::string& outputDir) {
+std::string deriveOutputPath(const std::string& stlPath, const std::string& outputDir,
+                             ImageFormat format) {
     fs::path p(stlPath);
-    std::string stem = p.stem().string();
+    std::string name = p.stem().string() + "." + formatExtension(format);
 
     if (outputDir.empty()) {
         // Save next to original
-        return (p.parent_path() / (stem + ".png")).string();
+        return (p.parent_path() / name).string();
     } else {
-        return (fs::path(outputDir) / (stem + ".png")).string();
+        return (fs::path(outputDir) / name).string();
+    }
+}
+
+void cropImage(const std::vector<unsigned char>& pixels, int imageWidth,
+               int x, int y, int w, int h, std::vector<unsigned char>& out) {
+    const size_t srcStride = size_t(imageWidth) * 4;
+    const size_t rowBytes  = size_t(w) * 4;
+    out.resize(rowBytes * h);
+    for (int row = 0; row < h; ++row) {
+        std::memcpy(&out[row * rowBytes], &pixels[(size_t(y) + row) * srcStride + size_t(x) * 4], rowBytes);
     }
 }
 
+std::string framePath(const std::string& path, size_t index) {
+    fs::path p(path);
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%03zu", index);
+    return (p.parent_path() / (p.stem().string() + suffix + p.extension().string())).string();
+}
+
 } // namespace Exporter
@@ -0,0 +1,127 @@
+#include "load_queue.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+LoadQueue::LoadQueue(unsigned workers) {
+    unsigned count = workers > 0 ? workers : std::min(4u, Parallel::threadCount());
+    workers_.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        workers_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+LoadQueue::~LoadQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for (auto& job : active_) job->progress.cancel = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+uint64_t LoadQueue::enqueue(const std::string& path, const LoadOptions& options, bool select,
+                            uint64_t sizeHint) {
+    auto job = std::make_shared<Job>();
+    job->path     = path;
+    job->options  = options;
+    job->select   = select;
+    job->sizeHint = sizeHint;
+    job->options.progress = &job->progress;
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = job->id = nextId_++;
+        queued_.push(job);
+        active_.push_back(job);
+    }
+    wake_.notify_one();
+    return id;
+}
+
+void LoadQueue::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& job : active_) {
+        if (job->id == id) job->progress.cancel = true;
+    }
+}
+
+void LoadQueue::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& job : active_) job->progress.cancel = true;
+}
+
+std::vector<LoadResult> LoadQueue::takeFinished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LoadResult> out;
+    out.swap(finished_);
+    return out;
+}
+
+std::vector<LoadResult> LoadQueue::waitFinished() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finishedCv_.wait(lock, [this] { return !finished_.empty() || active_.empty(); });
+    std::vector<LoadResult> out;
+    out.swap(finished_);
+    return out;
+}
+
+std::vector<LoadJobStatus> LoadQueue::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LoadJobStatus> out;
+    out.reserve(active_.size());
+    for (const auto& job : active_) {
+        LoadJobStatus s;
+        s.id       = job->id;
+        s.filename = fs::path(job->path).filename().string();
+        s.state    = job->state;
+        s.progress = job->progress.fraction.load(std::memory_order_relaxed);
+        out.push_back(std::move(s));
+    }
+    return out;
+}
+
+size_t LoadQueue::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_.size();
+}
+
+void LoadQueue::workerLoop() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queued_.empty(); });
+            if (stopping_) return;
+            job = queued_.top();
+            queued_.pop();
+            job->state = LoadState::Loading;
+        }
+
+        LoadResult result;
+        result.id     = job->id;
+        result.path   = job->path;
+        result.select = job->select;
+
+        if (job->progress.cancel) {
+            result.state = LoadState::Cancelled;
+        } else if (result.model.load(job->path, job->options)) {
+            result.state = LoadState::Done;
+        } else {
+            result.state = job->progress.cancel ? LoadState::Cancelled : LoadState::Failed;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->state = result.state;
+            active_.erase(std::remove(active_.begin(), active_.end(), job), active_.end());
+            finished_.push_back(std::move(result));
+        }
+        finishedCv_.notify_all();
+    }
+}
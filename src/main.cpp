@@ -1,15 +1,21 @@
 /*
  * STL Viewer & Exporter
  * =====================
- * A C++ GUI application for viewing and exporting STL files to PNG images.
+ * A C++ GUI application for viewing and exporting STL files to images.
  *
  * Features:
  *   - Real-time 3D preview with Phong shading
  *   - Mouse orbit/zoom controls
  *   - Load single files or entire folders
- *   - Batch export all loaded STLs to PNG
+ *   - Optional on-demand loading for very large folders
+ *   - Batch export all loaded STLs to PNG / QOI / JPEG / WebP
  *   - Adjustable colors, lighting, camera, resolution
  *   - Wireframe overlay toggle
+ *   - Performance overlay: frame / GPU / stage timings, memory, Chrome traces
+ *
+ * Headless batch export:
+ *   stl_viewer --export <dir> --out <dir> --size 1920x1080 --recursive
+ *   (see --help for all flags)
  *
  * Controls:
  *   - Left-click drag:  Orbit camera
@@ -18,6 +24,7 @@
  *   - Ctrl+Shift+O:     Open folder
  *   - Ctrl+E:           Export current
  *   - Ctrl+Shift+E:     Export all
+ *   - F3:               Performance overlay
  */
 
 #ifdef _WIN32
@@ -37,13 +44,26 @@
 #include "imgui_impl_opengl3.h"
 
 #include "stl_loader.h"
+#include "load_queue.h"
+#include "dir_scanner.h"
 #include "renderer.h"
 #include "exporter.h"
+#include "batch_cli.h"
+#include "export_pipeline.h"
+#include "export_farm.h"
+#include "mesh_lod.h"
+#include "mesh_cache.h"
+#include "profiler.h"
 
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <memory>
 
 namespace fs = std::filesystem;
 
@@ -52,8 +72,48 @@ float g_panelWidth = 320.0f;
 
 // ── App State ───────────────────────────────────────────────────────────────
 
+// One row of the model list. The metadata is always present; mesh data is
+// loaded when the model is selected or exported and may be dropped again
+// under the memory cap.
+struct ModelEntry {
+    std::string               path;
+    std::string               filename;
+    STLFileInfo               info;
+    std::shared_ptr<STLModel> model;          // Null until loaded / after eviction
+    uint64_t                  revision = 0;   // Of the last loaded mesh (GPU cache key)
+    uint64_t                  loadId   = 0;   // Pending LoadQueue job, 0 = none
+    bool                      lazy     = false;  // Listed without loading; kept if a load is cancelled
+    uint64_t                  scanId   = 0;   // Folder scan still listing it (see pumpScans())
+    uint64_t                  lastUse  = 0;
+    uint64_t                  lodId    = 0;   // Pending LodBuilder job, 0 = none
+    std::vector<std::shared_ptr<const STLModel>> lods;   // Viewport stand-ins, finest first
+
+    // Progressive display while a large file loads (see pumpStreams())
+    std::shared_ptr<LoadStream>           stream;
+    MeshHandle                            streamHandle = 0;
+    bool                                  streamSelect = false;   // Show it once geometry arrives
+    std::chrono::steady_clock::time_point loadStart;
+    double                                firstGeometryMs = -1.0; // Time to first pixel, < 0 = not yet
+
+    size_t triangleCount() const { return model ? model->triangleCount() : info.triangles; }
+    size_t memoryBytes() const {
+        size_t bytes = model ? model->memoryBytes() : 0;
+        for (const auto& lod : lods) bytes += lod->memoryBytes();
+        return bytes;
+    }
+};
+
+// A folder being listed; its entries arrive in discovery order
+struct FolderScan {
+    uint64_t    id = 0;
+    std::string directory;
+    bool        lazy   = false;
+    bool        select = false;   // Show the first hit when it's ready
+    size_t      found  = 0;
+};
+
 struct AppState {
-    std::vector<STLModel>  models;
+    std::vector<ModelEntry> models;
     int                    currentModel   = -1;
     RenderSettings         settings;
     Renderer               renderer;
@@ -62,17 +122,71 @@ struct AppState {
     char inputPath[512]    = "";
     char outputDir[512]    = "";
     bool recursive         = false;
-    bool exportToSourceDir = true;  // Export PNGs next to their source STL files
+    bool exportToSourceDir = true;  // Export images next to their source STL files
+    Exporter::ExportFormat exportFormat;
+    int  exportViews = 1;          // > 1: turntable sprite sheet per model
+    bool splitViews  = false;      // Write the views as separate frames
+
+    // Loader
+    LoadOptions loadOptions;
+    bool        meshCache   = true;   // loadOptions.cacheDir = MeshCache::defaultDirectory()
+    LoadQueue   loader;
+    DirScanner  scanner;
+    std::vector<FolderScan> folderScans;
+    int         batchTotal  = 0;   // Files queued since the queue was last idle
+    int         batchLoaded = 0;
+    int         batchFailed = 0;
+    bool        lazyLoad    = false;            // Folders list files and load on selection
+    size_t      memoryCap   = size_t(2048) << 20;   // CPU mesh bytes before LRU eviction
+    bool        streamLoads = true;                 // Draw big files while they decode
+    uint64_t    streamMinBytes = uint64_t(64) << 20;
+    uint64_t    useCounter  = 0;
+
+    // Level of detail, built in the background for models past the threshold
+    LodBuilder  lodBuilder;
+    bool        buildLods    = true;
+    int         lodThreshold = 1000000;   // Triangles
+    bool        useLods      = true;
+    bool        coarseWhileOrbiting = true;
+
+    // Scene mode: every model in memory drawn together (see pumpScene())
+    bool                  sceneMode   = false;
+    int                   sceneLayout = 0;       // 0 = as exported (shared coordinates), 1 = grid
+    bool                  sceneDirty  = false;   // Rebuild on the next pump regardless
+    std::vector<uint64_t> sceneRevisions;        // Meshes in the current scene, sorted
+    std::chrono::steady_clock::time_point sceneBuilt;
 
     // Mouse orbit
     bool   dragging        = false;
     double lastMouseX      = 0, lastMouseY = 0;
 
+    // Ctrl+click picks on the current model (STL coordinates); two make a measurement
+    std::vector<std::array<float, 3>> measurePoints;
+
     // Status
     std::string statusMsg  = "Ready. Load an STL file or folder to begin.";
     int         exportedCount = 0;
     int         totalToExport = 0;
     bool        exporting     = false;
+    std::unique_ptr<ExportPipeline> exportJob;   // Running "Export All" on the UI context
+    std::unique_ptr<ExportFarm>     exportFarm;  // ... or on background contexts
+    int  exportContexts = 1;
+
+    // Performance overlay (F3); frameMs is a ring, oldest entry at frameHead
+    bool                   showPerf  = false;
+    bool                   gpuTiming = false;   // Renderer timer queries follow showPerf
+    std::array<float, 240> frameMs{};
+    int                    frameHead = 0;
+    float                  lastFrameMs = 0.0f;   // Work of the previous frame, before the swap
+    std::string            traceMsg;
+
+    // On-demand redraw (see waitForEvents()): what the cached viewport image
+    // shows, and how many frames to run after input before sleeping again
+    RenderSettings viewSettings;
+    uint64_t       viewGeneration = 0;
+    bool           viewScene      = false;
+    size_t         viewRedraws    = 0;
+    int            settleFrames   = 2;
 };
 
 // ── Native file dialogs (cross-platform) ────────────────────────────────────
@@ -128,11 +242,13 @@ static std::string nativeSaveFile(const std::string& defaultName) {
     OPENFILENAMEA ofn{};
     ofn.lStructSize = sizeof(ofn);
     ofn.hwndOwner = nullptr;
-    ofn.lpstrFilter = "PNG Files\0*.png\0";
+    std::string ext = fs::path(defaultName).extension().string();
+    if (!ext.empty()) ext.erase(0, 1);
+    ofn.lpstrFilter = "Images\0*.png;*.qoi;*.jpg;*.webp\0All Files\0*.*\0";
     ofn.lpstrFile = filename;
     ofn.nMaxFile = MAX_PATH;
     ofn.Flags = OFN_OVERWRITEPROMPT | OFN_NOCHANGEDIR;
-    ofn.lpstrDefExt = "png";
+    ofn.lpstrDefExt = ext.c_str();
     if (GetSaveFileNameA(&ofn)) return std::string(filename);
     return "";
 }
@@ -145,43 +261,348 @@ static std::string nativeSaveFile(const std::string&) { return ""; }
 
 // ── Load helpers ────────────────────────────────────────────────────────────
 
-static void loadSingleFile(AppState& app, const std::string& path) {
-    STLModel model;
-    if (model.load(path)) {
-        app.models.push_back(std::move(model));
-        app.currentModel = (int)app.models.size() - 1;
-        app.renderer.uploadModel(app.models[app.currentModel]);
-        app.statusMsg = "Loaded: " + app.models.back().filename +
-                        " (" + std::to_string(app.models.back().triangles.size()) + " triangles)";
-    } else {
-        app.statusMsg = "Failed to load: " + path;
+// Loading is asynchronous: these only queue work for the LoadQueue workers,
+// and pumpLoadQueue() (called every frame) hands finished models to the GL thread.
+// Every file gets a list entry up front; its mesh arrives later.
+
+static void beginLoadBatch(AppState& app) {
+    if (app.loader.pending() == 0) {
+        app.batchLoaded = app.batchFailed = app.batchTotal = 0;
+    }
+}
+
+static ModelEntry makeEntry(const std::string& path, bool lazy) {
+    ModelEntry entry;
+    entry.path     = path;
+    entry.filename = fs::path(path).filename().string();
+    entry.lazy     = lazy;
+    probeSTLFile(path, entry.info);   // Unreadable files just list 0 triangles until loaded
+    return entry;
+}
+
+// The scanner has already read the header
+static ModelEntry makeEntry(ScanHit&& hit, bool lazy) {
+    ModelEntry entry;
+    entry.path     = std::move(hit.path);
+    entry.filename = fs::path(entry.path).filename().string();
+    entry.info     = hit.info;
+    entry.lazy     = lazy;
+    entry.scanId   = hit.scanId;
+    return entry;
+}
+
+static int findEntryByLoad(const AppState& app, uint64_t id) {
+    for (int i = 0; i < (int)app.models.size(); ++i) {
+        if (app.models[i].loadId == id) return i;
+    }
+    return -1;
+}
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void requestLoad(AppState& app, ModelEntry& entry, bool select) {
+    if (entry.model || entry.loadId) return;
+    beginLoadBatch(app);
+
+    // Only the model headed for the viewport streams; the rest load whole
+    LoadOptions options = app.loadOptions;
+    bool onScreen = select || (app.currentModel >= 0 && &app.models[app.currentModel] == &entry);
+    if (app.streamLoads && onScreen && entry.info.fileSize >= app.streamMinBytes) {
+        entry.stream       = std::make_shared<LoadStream>();
+        entry.streamSelect = select;
+        options.stream     = entry.stream;
+    }
+    entry.loadStart       = std::chrono::steady_clock::now();
+    entry.firstGeometryMs = -1.0;
+    entry.loadId = app.loader.enqueue(entry.path, options, select, entry.info.fileSize);
+    app.batchTotal++;
+}
+
+// The finished mesh (or a failed load) replaces the partial one
+static void dropStream(AppState& app, ModelEntry& entry) {
+    if (entry.streamHandle) app.renderer.evict(entry.streamHandle);
+    entry.streamHandle = 0;
+    entry.stream.reset();
+}
+
+static void removeEntry(AppState& app, int index) {
+    ModelEntry& entry = app.models[index];
+    dropStream(app, entry);
+    if (entry.loadId) app.loader.cancel(entry.loadId);
+    if (entry.lodId) app.lodBuilder.cancel(entry.lodId);
+    if (entry.revision) app.renderer.evict(entry.revision);
+    app.models.erase(app.models.begin() + index);
+    app.sceneDirty = true;
+    if (app.currentModel == index) app.currentModel = -1;
+    else if (app.currentModel > index) app.currentModel--;
+}
+
+// Install freshly loaded mesh data, dropping the GPU copy of any older load
+static void setEntryModel(AppState& app, ModelEntry& entry, std::shared_ptr<STLModel> model) {
+    if (entry.revision && entry.revision != model->revision) app.renderer.evict(entry.revision);
+    entry.model    = std::move(model);
+    entry.revision = entry.model->revision;
+    entry.lastUse  = ++app.useCounter;
+
+    // Levels are rebuilt with the mesh; the full-resolution view is usable meanwhile
+    if (entry.lodId) app.lodBuilder.cancel(entry.lodId);
+    entry.lodId = 0;
+    entry.lods.clear();
+    if (app.buildLods && entry.model->triangleCount() >= size_t(app.lodThreshold)) {
+        entry.lodId = app.lodBuilder.enqueue(entry.model);
     }
 }
 
+// Drop the CPU mesh data of the least recently used models until under the
+// cap. The viewport model is kept; GPU copies stay until the VRAM budget
+// evicts them, so re-selecting a dropped model is usually still instant.
+static void enforceMemoryCap(AppState& app) {
+    size_t total = 0;
+    for (const auto& entry : app.models) {
+        total += entry.memoryBytes();
+    }
+
+    while (total > app.memoryCap) {
+        int victim = -1;
+        for (int i = 0; i < (int)app.models.size(); ++i) {
+            const auto& entry = app.models[i];
+            if (i == app.currentModel || !entry.model) continue;
+            if (victim < 0 || entry.lastUse < app.models[victim].lastUse) victim = i;
+        }
+        if (victim < 0) break;
+        total -= app.models[victim].memoryBytes();
+        app.models[victim].model.reset();
+        app.models[victim].lods.clear();   // The GPU copies stay attached
+    }
+}
+
+// Put entry `index` in the viewport: upload if its mesh is in memory, reuse
+// the GPU copy if that survived, otherwise fetch it in the background.
+static void showModel(AppState& app, int index) {
+    if (index < 0 || index >= (int)app.models.size()) return;
+    if (index != app.currentModel) app.measurePoints.clear();
+    app.currentModel = index;
+
+    ModelEntry& entry = app.models[index];
+    entry.lastUse = ++app.useCounter;
+    if (entry.model) {
+        app.renderer.uploadModel(*entry.model);
+        if (!entry.lods.empty()) app.renderer.attachLods(entry.revision, entry.lods);
+    } else if (entry.streamHandle && app.renderer.select(entry.streamHandle)) {
+        // Still loading; keep drawing what has arrived
+    } else if (!app.renderer.select(entry.revision)) {
+        requestLoad(app, entry, false);
+        app.statusMsg = "Loading: " + entry.filename;
+    }
+}
+
+static void selectModel(AppState& app, int index) {
+    // Stop fetching a lazily listed model the user has already moved past
+    if (app.currentModel >= 0 && app.currentModel != index) {
+        ModelEntry& prev = app.models[app.currentModel];
+        if (prev.lazy && prev.loadId && !prev.model) app.loader.cancel(prev.loadId);
+    }
+    showModel(app, index);
+}
+
+static void loadSingleFile(AppState& app, const std::string& path) {
+    app.models.push_back(makeEntry(path, false));
+    requestLoad(app, app.models.back(), true);
+    app.statusMsg = "Loading: " + app.models.back().filename;
+}
+
+// Folders are walked by the DirScanner; pumpScans() lists (and, unless lazy,
+// queues) the parts as they turn up, largest loads first
 static void loadFolder(AppState& app, const std::string& dir, bool recursive) {
-    auto files = findSTLFiles(dir, recursive);
-    if (files.empty()) {
-        app.statusMsg = "No STL files found in: " + dir;
-        return;
+    FolderScan scan;
+    scan.id        = app.scanner.scan(dir, recursive);
+    scan.directory = dir;
+    scan.lazy      = app.lazyLoad;
+    scan.select    = app.currentModel < 0;
+    app.folderScans.push_back(scan);
+    app.statusMsg = "Scanning: " + dir;
+}
+
+// Put a finished scan's entries in path order, in the slots they already
+// hold (other entries may be interleaved), keeping the current model current
+static void sortScanEntries(AppState& app, uint64_t scanId) {
+    std::vector<int> slots;
+    for (int i = 0; i < (int)app.models.size(); ++i) {
+        if (app.models[i].scanId == scanId) slots.push_back(i);
+    }
+
+    std::string current;
+    if (std::find(slots.begin(), slots.end(), app.currentModel) != slots.end()) {
+        current = app.models[app.currentModel].path;
+    }
+
+    std::vector<ModelEntry> entries;
+    entries.reserve(slots.size());
+    for (int slot : slots) entries.push_back(std::move(app.models[slot]));
+    std::sort(entries.begin(), entries.end(),
+              [](const ModelEntry& a, const ModelEntry& b) { return a.path < b.path; });
+
+    for (size_t k = 0; k < slots.size(); ++k) {
+        ModelEntry& entry = app.models[slots[k]];
+        entry = std::move(entries[k]);
+        entry.scanId = 0;
+        if (!current.empty() && entry.path == current) app.currentModel = slots[k];
     }
+    app.sceneDirty = true;   // The grid layout follows list order
+}
 
-    int loaded = 0;
-    for (const auto& f : files) {
-        STLModel model;
-        if (model.load(f)) {
-            app.models.push_back(std::move(model));
-            loaded++;
+static void pumpScans(AppState& app) {
+    if (app.folderScans.empty()) return;
+
+    // Check for finished scans first: once a scan is done all its hits are
+    // already waiting in takeFound()
+    std::vector<bool> done(app.folderScans.size());
+    for (size_t i = 0; i < app.folderScans.size(); ++i) {
+        done[i] = !app.scanner.scanning(app.folderScans[i].id);
+    }
+
+    std::vector<ScanHit> hits = app.scanner.takeFound();
+    for (auto& hit : hits) {
+        auto scan = std::find_if(app.folderScans.begin(), app.folderScans.end(),
+                                 [&](const FolderScan& s) { return s.id == hit.scanId; });
+        if (scan == app.folderScans.end()) continue;
+        scan->found++;
+
+        app.models.push_back(makeEntry(std::move(hit), scan->lazy));
+        int index = (int)app.models.size() - 1;
+        if (scan->lazy) {
+            if (app.currentModel < 0) showModel(app, index);
+        } else {
+            requestLoad(app, app.models[index], scan->select);
+            scan->select = false;
         }
+        app.statusMsg = "Scanning " + scan->directory + ": " + std::to_string(scan->found) + " STL files found";
     }
 
-    if (loaded > 0) {
-        app.currentModel = (int)app.models.size() - 1;
-        app.renderer.uploadModel(app.models[app.currentModel]);
-        app.statusMsg = "Loaded " + std::to_string(loaded) + " of " +
-                        std::to_string(files.size()) + " STL files from: " + dir;
-    } else {
-        app.statusMsg = "Failed to load any files from: " + dir;
+    for (size_t i = app.folderScans.size(); i-- > 0;) {
+        if (!done[i]) continue;
+        const FolderScan& scan = app.folderScans[i];
+        sortScanEntries(app, scan.id);
+        if (scan.found == 0) {
+            app.statusMsg = "No STL files found in: " + scan.directory;
+        } else if (scan.lazy) {
+            app.statusMsg = "Listed " + std::to_string(scan.found) + " STL files from: " + scan.directory;
+        } else if (app.loader.pending() > 0) {
+            app.statusMsg = "Loading " + std::to_string(scan.found) + " STL files from: " + scan.directory;
+        }
+        app.folderScans.erase(app.folderScans.begin() + i);
+    }
+}
+
+static void pumpLoadQueue(AppState& app) {
+    std::vector<LoadResult> results = app.loader.takeFinished();
+    if (results.empty()) return;
+
+    for (auto& r : results) {
+        int index = findEntryByLoad(app, r.id);
+        if (index < 0) continue;   // Removed while it was loading
+        ModelEntry& entry = app.models[index];
+        entry.loadId = 0;
+
+        if (r.state != LoadState::Done) {
+            dropStream(app, entry);
+            if (r.state == LoadState::Failed) app.batchFailed++;
+            if (app.batchTotal == 1) app.statusMsg = "Failed to load: " + r.path;
+            if (r.state == LoadState::Failed || !entry.lazy) removeEntry(app, index);
+            continue;
+        }
+
+        setEntryModel(app, entry, std::make_shared<STLModel>(std::move(r.model)));
+        app.batchLoaded++;
+        if (r.select || app.currentModel < 0) app.currentModel = index;
+        if (index == app.currentModel) app.renderer.uploadModel(*entry.model);
+        dropStream(app, entry);
+        if (app.batchTotal == 1) {
+            app.statusMsg = "Loaded: " + entry.filename +
+                            " (" + std::to_string(entry.triangleCount()) + " triangles)";
+            if (entry.firstGeometryMs >= 0.0) {
+                char timing[96];
+                std::snprintf(timing, sizeof(timing), " in %.0f ms, first geometry after %.0f ms",
+                              msSince(entry.loadStart), entry.firstGeometryMs);
+                app.statusMsg += timing;
+            }
+        }
+    }
+
+    if (app.batchTotal > 1) {
+        app.statusMsg = "Loaded " + std::to_string(app.batchLoaded) + " of " +
+                        std::to_string(app.batchTotal) + " STL files";
+        if (app.batchFailed > 0) app.statusMsg += " (" + std::to_string(app.batchFailed) + " failed)";
+    }
+
+    enforceMemoryCap(app);
+}
+
+// Upload what streaming loads have decoded so far. A streamed mesh is drawn
+// in place of the model until pumpLoadQueue() installs the finished one.
+static void pumpStreams(AppState& app) {
+    for (int i = 0; i < (int)app.models.size(); ++i) {
+        ModelEntry& entry = app.models[i];
+        if (!entry.stream) continue;
+
+        if (!entry.streamHandle) {
+            entry.streamHandle = app.renderer.beginStream(*entry.stream);
+            if (!entry.streamHandle) {
+                if (entry.stream->closed()) entry.stream.reset();   // E.g. a mesh cache hit
+                continue;
+            }
+            if (entry.streamSelect || i == app.currentModel) {
+                if (i != app.currentModel) app.measurePoints.clear();
+                app.currentModel = i;
+                app.renderer.select(entry.streamHandle);
+            }
+        } else if (!app.renderer.updateStream(entry.streamHandle, *entry.stream)) {
+            entry.streamHandle = 0;   // Evicted under the VRAM budget
+            entry.stream.reset();
+            continue;
+        }
+
+        if (entry.firstGeometryMs < 0.0 && app.renderer.streamedTriangles(entry.streamHandle) > 0) {
+            entry.firstGeometryMs = msSince(entry.loadStart);
+            if (i == app.currentModel) {
+                char msg[64];
+                std::snprintf(msg, sizeof(msg), " (first geometry after %.0f ms)", entry.firstGeometryMs);
+                app.statusMsg = "Loading: " + entry.filename + msg;
+            }
+        }
+    }
+}
+
+// Attach finished LOD chains; the viewport switches to them from the next frame
+static void pumpLods(AppState& app) {
+    std::vector<LodResult> results = app.lodBuilder.takeFinished();
+    if (results.empty()) return;
+
+    for (auto& r : results) {
+        for (int i = 0; i < (int)app.models.size(); ++i) {
+            ModelEntry& entry = app.models[i];
+            if (entry.lodId != r.id) continue;
+            entry.lodId = 0;
+            entry.lods  = std::move(r.levels);
+            if (!entry.lods.empty()) app.renderer.attachLods(entry.revision, entry.lods);
+            break;
+        }
     }
+    enforceMemoryCap(app);
+}
+
+// Exports need the mesh in memory; load synchronously if it was listed
+// lazily or evicted
+static const STLModel* requireModel(AppState& app, ModelEntry& entry) {
+    if (!entry.model) {
+        auto model = std::make_shared<STLModel>();
+        if (!model->load(entry.path, app.loadOptions)) return nullptr;
+        setEntryModel(app, entry, std::move(model));
+    }
+    entry.lastUse = ++app.useCounter;
+    return entry.model.get();
 }
 
 // ── Export helpers ──────────────────────────────────────────────────────────
@@ -189,77 +610,178 @@ static void loadFolder(AppState& app, const std::string& dir, bool recursive) {
 static void exportCurrent(AppState& app) {
     if (app.currentModel < 0 || app.currentModel >= (int)app.models.size()) return;
 
-    auto& model = app.models[app.currentModel];
+    auto& entry = app.models[app.currentModel];
+    const STLModel* model = requireModel(app, entry);
+    if (!model) {
+        app.statusMsg = "Failed to load: " + entry.path;
+        return;
+    }
 
     std::string outPath;
     if (app.exportToSourceDir) {
         // Export next to the original STL file
-        outPath = Exporter::deriveOutputPath(model.fullpath, "");
+        outPath = Exporter::deriveOutputPath(model->fullpath, "", app.exportFormat.format);
     } else {
-        outPath = Exporter::deriveOutputPath(model.fullpath, app.outputDir);
+        outPath = Exporter::deriveOutputPath(model->fullpath, app.outputDir, app.exportFormat.format);
     }
 
     // Try native save-as dialog on Windows
     std::string nativePath = nativeSaveFile(outPath);
     if (!nativePath.empty()) outPath = nativePath;
 
+    // Turntables and posters past the GL size limit (tiled) take the same
+    // path as Export All, run to completion for the one model
+    int limit = app.renderer.getMaxTargetSize();
+    bool tiled = std::max(app.settings.exportWidth, app.settings.exportHeight) > limit;
+    if (app.exportViews > 1 || tiled) {
+        ExportPipelineOptions options;
+        options.format = app.exportFormat;
+        if (app.exportViews > 1) {
+            options.views      = turntablePoses(app.settings, app.exportViews);
+            options.splitViews = app.splitViews;
+        }
+        std::vector<ExportItem> items{{entry.path, outPath, entry.model}};
+        ExportPipeline job(app.renderer, app.settings, std::move(items), options);
+        job.run();
+        app.statusMsg = (job.failed() ? "Export failed: " : "Exported: ") + outPath;
+        return;
+    }
+
+    auto encoder = Exporter::makeEncoder(app.exportFormat);
+    if (!encoder) return;
+
     std::vector<unsigned char> pixels;
-    if (app.renderer.renderToBuffer(model, app.settings,
+    if (app.renderer.renderToBuffer(*model, app.settings,
                                      app.settings.exportWidth, app.settings.exportHeight,
                                      pixels)) {
-        if (Exporter::savePNG(outPath, app.settings.exportWidth, app.settings.exportHeight, pixels)) {
+        if (Exporter::saveImage(outPath, app.settings.exportWidth, app.settings.exportHeight, pixels, *encoder)) {
             app.statusMsg = "Exported: " + outPath;
         } else {
             app.statusMsg = "Export failed: " + outPath;
         }
     }
-
-    // Re-upload current model for viewport display
-    app.renderer.uploadModel(app.models[app.currentModel]);
 }
 
+// Export All runs as a pipeline advanced once per frame (pumpExport), so the
+// UI stays live. Models already in memory are rendered as-is; the rest are
+// parsed on the pipeline's own workers and dropped after rendering.
 static void exportAll(AppState& app) {
-    if (app.models.empty()) return;
+    if (app.models.empty() || app.exporting) return;
+
+    std::vector<ExportItem> items;
+    items.reserve(app.models.size());
+    for (const auto& entry : app.models) {
+        ExportItem item;
+        item.input  = entry.path;
+        item.output = Exporter::deriveOutputPath(entry.path, app.exportToSourceDir ? "" : app.outputDir,
+                                                 app.exportFormat.format);
+        item.model  = entry.model;
+        items.push_back(std::move(item));
+    }
+
+    ExportPipelineOptions options;
+    options.loadOptions = app.loadOptions;
+    options.loadOptions.buildBVH = false;   // Whole-model shots cull nothing; tiled runs turn it back on
+    options.format      = app.exportFormat;
+    if (app.exportViews > 1) {
+        options.views      = turntablePoses(app.settings, app.exportViews);
+        options.splitViews = app.splitViews;
+    }
+    if (app.exportContexts > 1) {
+        // Background contexts leave the UI context free to keep drawing
+        app.exportFarm = std::make_unique<ExportFarm>(app.exportContexts, app.settings, std::move(items),
+                                                      options, app.renderer.getVertexFormat());
+        app.totalToExport = (int)app.exportFarm->total();
+    } else {
+        app.exportJob = std::make_unique<ExportPipeline>(app.renderer, app.settings, std::move(items), options);
+        app.totalToExport = (int)app.exportJob->total();
+    }
 
     app.exporting = true;
     app.exportedCount = 0;
-    app.totalToExport = (int)app.models.size();
+    app.statusMsg = "Exporting " + std::to_string(app.totalToExport) + " models...";
+}
 
-    int success = 0, failed = 0;
+static void pumpExport(AppState& app) {
+    size_t success, failed, total;
+    if (app.exportFarm) {
+        app.exportedCount = (int)app.exportFarm->completed();
+        if (!app.exportFarm->finished()) return;
+        success = app.exportFarm->succeeded();
+        failed  = app.exportFarm->failed();
+        total   = app.exportFarm->total();
+        app.exportFarm.reset();
+    } else if (app.exportJob) {
+        bool running = app.exportJob->step();
+        app.exportedCount = (int)app.exportJob->completed();
+        if (running) return;
+        success = app.exportJob->succeeded();
+        failed  = app.exportJob->failed();
+        total   = app.exportJob->total();
+        app.exportJob.reset();
+    } else {
+        return;
+    }
 
-    for (size_t i = 0; i < app.models.size(); ++i) {
-        auto& model = app.models[i];
+    size_t skipped = total - success - failed;
+    app.exporting = false;
+    app.statusMsg = "Batch export: " + std::to_string(success) + " exported, " +
+                    std::to_string(failed) + " failed";
+    if (skipped > 0) app.statusMsg += ", " + std::to_string(skipped) + " cancelled";
+}
 
-        std::string outPath;
-        if (app.exportToSourceDir) {
-            outPath = Exporter::deriveOutputPath(model.fullpath, "");
-        } else {
-            outPath = Exporter::deriveOutputPath(model.fullpath, app.outputDir);
+// ── Event loop pacing ───────────────────────────────────────────────────────
+// Idle, the loop sleeps in glfwWaitEvents(); input wakes it and a couple of
+// extra frames let ImGui settle hover and release states. Loads, streams and
+// LOD builds report back through queues, so while any is in flight the loop
+// wakes every kBusyWaitSeconds to pump them. A UI-context export advances a
+// step per frame and keeps the loop running. None of this redraws the mesh
+// by itself: that happens only when viewportChanged() says so.
+
+static constexpr double kBusyWaitSeconds    = 1.0 / 60.0;
+static constexpr double kOverlayWaitSeconds = 0.25;   // Keeps the performance overlay live
+
+// Some model in memory isn't in the scene yet
+static bool sceneBehind(const AppState& app) {
+    for (const auto& entry : app.models) {
+        if (!entry.model || entry.model->vertexCount == 0) continue;
+        if (!std::binary_search(app.sceneRevisions.begin(), app.sceneRevisions.end(), entry.model->revision)) {
+            return true;
         }
+    }
+    return false;
+}
 
-        std::vector<unsigned char> pixels;
-        if (app.renderer.renderToBuffer(model, app.settings,
-                                         app.settings.exportWidth, app.settings.exportHeight,
-                                         pixels)) {
-            if (Exporter::savePNG(outPath, app.settings.exportWidth, app.settings.exportHeight, pixels)) {
-                success++;
-            } else {
-                failed++;
-            }
-        } else {
-            failed++;
-        }
-        app.exportedCount = (int)i + 1;
+static bool backgroundWork(const AppState& app) {
+    if (app.loader.pending() > 0 || app.lodBuilder.pending() > 0) return true;
+    if (!app.folderScans.empty()) return true;
+    // A grown scene waits out pumpScene()'s throttle; keep pumping until it's rebuilt
+    if (app.sceneMode && app.renderer.hasScene() && sceneBehind(app)) return true;
+    for (const auto& entry : app.models) {
+        if (entry.stream || entry.loadId || entry.lodId) return true;
     }
+    return false;
+}
 
-    // Restore viewport model
-    if (app.currentModel >= 0 && app.currentModel < (int)app.models.size()) {
-        app.renderer.uploadModel(app.models[app.currentModel]);
+static void waitForEvents(AppState& app) {
+    if (app.exporting || app.dragging || app.settleFrames > 0) {
+        glfwPollEvents();
+        if (app.settleFrames > 0) app.settleFrames--;
+        return;
+    }
+    if (backgroundWork(app)) {
+        glfwWaitEventsTimeout(kBusyWaitSeconds);
+    } else if (app.showPerf) {
+        glfwWaitEventsTimeout(kOverlayWaitSeconds);
+    } else {
+        glfwWaitEvents();
+        app.settleFrames = 2;
     }
+}
 
-    app.exporting = false;
-    app.statusMsg = "Batch export: " + std::to_string(success) + " exported, " +
-                    std::to_string(failed) + " failed";
+static bool viewportChanged(const AppState& app, bool scene) {
+    return scene != app.viewScene || app.renderer.drawGeneration() != app.viewGeneration ||
+           !sameView(app.viewSettings, app.settings);
 }
 
 // ── Mouse orbit handling (polled in main loop, not via callbacks) ────────────
@@ -267,6 +789,220 @@ static void exportAll(AppState& app) {
 // callbacks via ImGui_ImplGlfw_InitForOpenGL(window, true). Overwriting them
 // prevents ImGui from receiving input, which breaks all buttons/sliders/etc.
 
+// Framebuffer pixels per window unit (HiDPI), and the 3D viewport size as
+// the main loop lays it out
+static void viewportMetrics(GLFWwindow* window, float& scaleX, float& scaleY, int& vpW, int& vpH) {
+    int winW, winH, fbW, fbH;
+    glfwGetWindowSize(window, &winW, &winH);
+    glfwGetFramebufferSize(window, &fbW, &fbH);
+    scaleX = winW > 0 ? float(fbW) / winW : 1.0f;
+    scaleY = winH > 0 ? float(fbH) / winH : 1.0f;
+    vpW = fbW - (int)g_panelWidth;
+    vpH = fbH;
+}
+
+// Cast a ray through the cursor into the current model; a third pick starts
+// a new measurement
+static void pickPoint(GLFWwindow* window, AppState& app, double mouseX, double mouseY) {
+    if (app.sceneMode) {
+        app.statusMsg = "Picking works on one model; turn off scene mode to measure.";
+        return;
+    }
+    if (app.currentModel < 0) return;
+    const ModelEntry& entry = app.models[app.currentModel];
+    if (!entry.model) {
+        app.statusMsg = "Picking needs the mesh in memory: " + entry.filename;
+        return;
+    }
+
+    float scaleX, scaleY;
+    int vpW, vpH;
+    viewportMetrics(window, scaleX, scaleY, vpW, vpH);
+
+    // render() draws the viewport from framebuffer x = 0 (the panel covers the left)
+    std::array<float, 3> origin, dir;
+    if (!app.renderer.pickRay(app.settings, vpW, vpH, float(mouseX) * scaleX, float(mouseY) * scaleY,
+                              origin, dir)) {
+        return;
+    }
+    RayHit hit;
+    if (!entry.model->raycast(origin, dir, hit)) return;
+
+    if (app.measurePoints.size() >= 2) app.measurePoints.clear();
+    app.measurePoints.push_back(hit.point);
+}
+
+// Mark the picked points (and the segment between them) over the viewport
+static void drawMeasureOverlay(GLFWwindow* window, AppState& app) {
+    if (app.measurePoints.empty() || app.sceneMode) return;
+
+    float scaleX, scaleY;
+    int vpW, vpH;
+    viewportMetrics(window, scaleX, scaleY, vpW, vpH);
+
+    ImDrawList* draw = ImGui::GetBackgroundDrawList();
+    const ImU32 color = IM_COL32(255, 200, 40, 255);
+    ImVec2 screen[2];
+    bool   visible[2] = {false, false};
+    for (size_t i = 0; i < app.measurePoints.size(); ++i) {
+        float px, py;
+        if (!app.renderer.projectPoint(app.settings, vpW, vpH, app.measurePoints[i], px, py)) continue;
+        screen[i]  = ImVec2(px / scaleX, py / scaleY);
+        visible[i] = true;
+        draw->AddCircleFilled(screen[i], 4.0f, color);
+        draw->AddText(ImVec2(screen[i].x + 6.0f, screen[i].y - 16.0f), color, i == 0 ? "A" : "B");
+    }
+    if (visible[0] && visible[1]) draw->AddLine(screen[0], screen[1], color, 1.5f);
+}
+
+// ── Scene mode ──────────────────────────────────────────────────────────────
+// The scene is rebuilt when a mesh it doesn't have arrives (at most once a
+// second while a folder loads; each rebuild uploads only the new meshes) or
+// when models are removed or the layout changes. Models evicted under the
+// RAM cap stay in the scene's GPU buffers until the next rebuild.
+
+static void rebuildScene(AppState& app) {
+    std::vector<Renderer::SceneItem> items;
+    for (const auto& entry : app.models) {
+        if (!entry.model || entry.model->vertexCount == 0) continue;
+        Renderer::SceneItem item;
+        item.model = entry.model.get();
+        items.push_back(item);
+    }
+
+    if (app.sceneLayout == 1 && !items.empty()) {
+        // Grid: cells sized to the largest part, each part centred in its cell
+        float cell = 0.0f;
+        for (const auto& item : items) cell = std::max(cell, item.model->bounds.span());
+        cell *= 1.1f;
+        int columns = (int)std::ceil(std::sqrt((double)items.size()));
+        for (size_t i = 0; i < items.size(); ++i) {
+            const BoundingBox& b = items[i].model->bounds;
+            float x = float(i % columns) * cell, y = -float(i / columns) * cell;
+            items[i].offset = {x - b.centerX(), y - b.centerY(), -b.centerZ()};
+        }
+    }
+
+    app.sceneRevisions.clear();
+    for (const auto& item : items) app.sceneRevisions.push_back(item.model->revision);
+    std::sort(app.sceneRevisions.begin(), app.sceneRevisions.end());
+    app.sceneDirty = false;
+    app.sceneBuilt = std::chrono::steady_clock::now();
+
+    if (!app.renderer.buildScene(items)) app.renderer.clearScene();
+}
+
+static void pumpScene(AppState& app) {
+    if (!app.sceneMode) {
+        if (app.renderer.hasScene()) app.renderer.clearScene();
+        app.sceneRevisions.clear();
+        return;
+    }
+
+    bool due = msSince(app.sceneBuilt) >= 1000.0 || !app.renderer.hasScene();
+    if (app.sceneDirty || (due && sceneBehind(app))) rebuildScene(app);
+}
+
+// ── Performance overlay ─────────────────────────────────────────────────────
+// Load and viewport stages are those of the latest run (one model load, one
+// redraw); a stage that run skipped (a cache hit's parse, the upload when the
+// mesh was already resident) shows its older time dimmed. Export stages
+// overlap across models and threads, so they have no runs: each is simply
+// the latest time of that stage.
+
+static void drawStageTimes(const char* title, const char* group) {
+    std::vector<Profiler::StageTime> times = Profiler::lastTimes(group);
+    ImGui::Text("%s", title);
+    if (times.empty()) {
+        ImGui::TextDisabled("  none yet");
+        return;
+    }
+
+    for (const auto& t : times) {
+        if (t.stale) ImGui::TextDisabled("  %-12s %9.2f ms", t.name.c_str(), t.ms);
+        else                   ImGui::Text("  %-12s %9.2f ms", t.name.c_str(), t.ms);
+    }
+}
+
+static void drawPerfOverlay(AppState& app) {
+    ImGuiIO& io = ImGui::GetIO();
+    app.frameMs[app.frameHead] = app.lastFrameMs;
+    app.frameHead = (app.frameHead + 1) % (int)app.frameMs.size();
+
+    if (app.gpuTiming != app.showPerf) {
+        app.gpuTiming = app.showPerf;
+        app.renderer.setGpuTiming(app.gpuTiming);
+    }
+    if (!app.showPerf) return;
+
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 10.0f, 10.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    ImGuiWindowFlags flags = ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse |
+                             ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+                             ImGuiWindowFlags_NoFocusOnAppearing;
+    if (!ImGui::Begin("Performance (F3)", &app.showPerf, flags)) {
+        ImGui::End();
+        return;
+    }
+
+    float sum = 0.0f, worst = 0.0f;
+    int   frames = 0;
+    for (float ms : app.frameMs) {
+        if (ms <= 0.0f) continue;
+        sum += ms;
+        worst = std::max(worst, ms);
+        frames++;
+    }
+    float avg = frames > 0 ? sum / frames : 0.0f;
+    // Frames only run on input or background work, so FPS is the rate while active
+    ImGui::Text("%.0f FPS  %.2f ms work avg, %.2f ms worst", io.Framerate, avg, worst);
+    ImGui::PlotLines("##frames", app.frameMs.data(), (int)app.frameMs.size(), app.frameHead,
+                     nullptr, 0.0f, std::max(worst, 1000.0f / 30.0f), ImVec2(280, 50));
+
+    Renderer::GpuTimes gpu = app.renderer.lastGpuTimes();
+    if (gpu.solidMs >= 0.0f) ImGui::Text("GPU solid %.2f ms", gpu.solidMs);
+    else                     ImGui::TextDisabled("GPU solid -");
+    ImGui::SameLine();
+    if (gpu.wireMs >= 0.0f) ImGui::Text("  wireframe %.2f ms", gpu.wireMs);
+    else                    ImGui::TextDisabled("  wireframe -");
+
+    ImGui::TextDisabled("Viewport redraws: %zu", app.viewRedraws);
+
+    ImGui::Separator();
+    drawStageTimes("Last load", "load");
+    drawStageTimes("Viewport", "render");
+    drawStageTimes("Export (latest of each stage)", "export");
+
+    // Only models holding memory somewhere; bounded by the RAM cap / VRAM budget
+    ImGui::Separator();
+    ImGui::Text("Memory (CPU / VRAM)");
+    for (const auto& entry : app.models) {
+        size_t cpu  = entry.memoryBytes();
+        size_t vram = app.renderer.meshBytes(entry.revision) + app.renderer.meshBytes(entry.streamHandle);
+        if (cpu == 0 && vram == 0) continue;
+        ImGui::Text("  %-24s %8.1f / %8.1f MB", entry.filename.c_str(),
+                    cpu / (1024.0 * 1024.0), vram / (1024.0 * 1024.0));
+    }
+
+    ImGui::Separator();
+    bool trace = Profiler::tracing();
+    if (ImGui::Checkbox("Record trace", &trace)) Profiler::setTracing(trace);
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu events", Profiler::traceEventCount());
+    if (ImGui::Button("Save Chrome trace")) {
+        const std::string path = "stl_viewer_trace.json";
+        app.traceMsg = Profiler::writeChromeTrace(path) ? "Wrote " + path : "Failed to write " + path;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        Profiler::clearTrace();
+        app.traceMsg.clear();
+    }
+    if (!app.traceMsg.empty()) ImGui::TextDisabled("%s", app.traceMsg.c_str());
+
+    ImGui::End();
+}
+
 static void handleMouseInput(GLFWwindow* window, AppState& app) {
     ImGuiIO& io = ImGui::GetIO();
 
@@ -281,6 +1017,12 @@ static void handleMouseInput(GLFWwindow* window, AppState& app) {
     double mouseX, mouseY;
     glfwGetCursorPos(window, &mouseX, &mouseY);
 
+    // Ctrl+click picks instead of orbiting
+    if (io.KeyCtrl) {
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) pickPoint(window, app, mouseX, mouseY);
+        leftDown = false;
+    }
+
     if (leftDown) {
         if (app.dragging) {
             double dx = mouseX - app.lastMouseX;
@@ -311,11 +1053,7 @@ static void dropCallback(GLFWwindow* window, int count, const char** paths) {
         if (fs::is_directory(path)) {
             loadFolder(*app, path, app->recursive);
         } else {
-            auto ext = fs::path(path).extension().string();
-            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            if (ext == ".stl") {
-                loadSingleFile(*app, path);
-            }
+            if (isSTLPath(path)) loadSingleFile(*app, path);
         }
     }
 }
@@ -365,6 +1103,32 @@ static void drawUI(AppState& app) {
         }
 
         ImGui::Checkbox("Include subfolders", &app.recursive);
+        ImGui::Checkbox("Load folders on demand", &app.lazyLoad);
+
+        // Welding applies to models loaded from now on
+        ImGui::Checkbox("Weld vertices (indexed mesh)", &app.loadOptions.weld);
+        if (app.loadOptions.weld) {
+            bool smooth = app.loadOptions.weldOptions.normals == NormalMode::Smooth;
+            if (ImGui::Checkbox("Smooth normals", &smooth)) {
+                app.loadOptions.weldOptions.normals = smooth ? NormalMode::Smooth : NormalMode::Flat;
+            }
+            ImGui::InputFloat("Weld epsilon", &app.loadOptions.weldOptions.epsilon, 0.0f, 0.0f, "%.1e");
+            app.loadOptions.weldOptions.epsilon = std::max(app.loadOptions.weldOptions.epsilon, 0.0f);
+        }
+        ImGui::Checkbox("Build BVH (culling, picking)", &app.loadOptions.buildBVH);
+        ImGui::Checkbox("Show large files while loading", &app.streamLoads);
+
+        // Processed meshes are reused until the STL changes on disk
+        if (ImGui::Checkbox("Cache parsed meshes", &app.meshCache)) {
+            app.loadOptions.cacheDir = app.meshCache ? MeshCache::defaultDirectory() : "";
+        }
+        if (app.meshCache) {
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Clear cache")) {
+                size_t removed = MeshCache::clear(app.loadOptions.cacheDir);
+                app.statusMsg = "Removed " + std::to_string(removed) + " cached mesh(es)";
+            }
+        }
 
         ImGui::Spacing();
         ImGui::Separator();
@@ -395,20 +1159,114 @@ static void drawUI(AppState& app) {
         ImGui::Text("%d model(s) loaded", (int)app.models.size());
 
         if (ImGui::BeginListBox("##models", ImVec2(-1, 150))) {
-            for (int i = 0; i < (int)app.models.size(); ++i) {
-                bool selected = (i == app.currentModel);
-                std::string label = app.models[i].filename +
-                    " (" + std::to_string(app.models[i].triangles.size()) + " tri)";
-                if (ImGui::Selectable(label.c_str(), selected)) {
-                    app.currentModel = i;
-                    app.renderer.uploadModel(app.models[i]);
+            // Folders can list thousands of files; only build the visible rows
+            int clicked = -1;
+            ImGuiListClipper clipper;
+            clipper.Begin((int)app.models.size());
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    const auto& entry = app.models[i];
+                    bool selected = (i == app.currentModel);
+                    // ASCII counts are estimated from the file size until loaded
+                    bool estimate = !entry.model && !entry.info.binary;
+                    std::string label = entry.filename +
+                        (estimate ? " (~" : " (") + std::to_string(entry.triangleCount()) + " tri)";
+
+                    // Dim entries whose mesh isn't in memory
+                    ImGui::PushID(i);
+                    if (!entry.model) ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+                    if (ImGui::Selectable(label.c_str(), selected)) clicked = i;
+                    if (!entry.model) ImGui::PopStyleColor();
+                    ImGui::PopID();
                 }
             }
             ImGui::EndListBox();
+            if (clicked >= 0) selectModel(app, clicked);
+        }
+
+        // Mesh data beyond the cap is dropped least-recently-used first
+        size_t inMemory = 0, memBytes = 0;
+        for (const auto& entry : app.models) {
+            if (!entry.model) continue;
+            inMemory++;
+            memBytes += entry.memoryBytes();
+        }
+        int capMB = (int)(app.memoryCap >> 20);
+        if (ImGui::SliderInt("RAM cap (MB)", &capMB, 128, 16384)) {
+            app.memoryCap = size_t(capMB) << 20;
+            enforceMemoryCap(app);
+        }
+        ImGui::TextDisabled("%d in memory, %.1f MB", (int)inMemory, memBytes / (1024.0 * 1024.0));
+
+        // Recently viewed models stay on the GPU until the budget is exceeded
+        int budgetMB = (int)(app.renderer.getVramBudget() / (1024 * 1024));
+        if (ImGui::SliderInt("VRAM budget (MB)", &budgetMB, 64, 8192)) {
+            app.renderer.setVramBudget(size_t(budgetMB) * 1024 * 1024);
+        }
+        ImGui::TextDisabled("%d resident, %.1f MB",
+                            (int)app.renderer.residentCount(),
+                            app.renderer.residentBytes() / (1024.0 * 1024.0));
+        if (app.renderer.lastTotalTriangles() > 0) {
+            ImGui::TextDisabled("Drawn %zu of %zu triangles (LOD %d)", app.renderer.lastDrawnTriangles(),
+                                app.renderer.lastTotalTriangles(), app.renderer.lastLodLevel());
+        }
+        ImGui::Checkbox("Performance overlay (F3)", &app.showPerf);
+
+        // Everything in memory at once; repeated parts are drawn instanced
+        if (ImGui::Checkbox("Show all loaded models (scene)", &app.sceneMode)) app.sceneDirty = true;
+        if (app.sceneMode) {
+            static const char* layouts[] = {"As exported", "Grid"};
+            if (ImGui::Combo("Layout", &app.sceneLayout, layouts, 2)) app.sceneDirty = true;
+            Renderer::SceneStats scene = app.renderer.sceneStats();
+            ImGui::TextDisabled("%zu parts (%zu meshes), %d draw call(s), %.1f MB", scene.items,
+                                scene.meshes, scene.drawCalls, scene.bytes / (1024.0 * 1024.0));
+        }
+
+        // Coarser meshes for orbiting huge models; exports stay full resolution
+        ImGui::Checkbox("Build LODs for large models", &app.buildLods);
+        if (app.buildLods) {
+            ImGui::SliderInt("LOD above (tris)", &app.lodThreshold, 100000, 10000000, "%d",
+                             ImGuiSliderFlags_Logarithmic);
+        }
+        if (ImGui::Checkbox("Use LODs in the viewport", &app.useLods)) app.renderer.setLodEnabled(app.useLods);
+        ImGui::Checkbox("Coarse LOD while orbiting", &app.coarseWhileOrbiting);
+        if (app.lodBuilder.pending() > 0) {
+            ImGui::TextDisabled("Building LODs for %d model(s)...", (int)app.lodBuilder.pending());
+        }
+
+        // Files still being parsed in the background
+        auto jobs = app.loader.status();
+        if (!jobs.empty()) {
+            ImGui::Spacing();
+            ImGui::Text("Loading %d file(s)...", (int)jobs.size());
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Cancel all")) app.loader.cancelAll();
+
+            const size_t maxShown = 8;
+            for (size_t i = 0; i < jobs.size() && i < maxShown; ++i) {
+                const auto& job = jobs[i];
+                ImGui::PushID((int)job.id);
+                if (ImGui::SmallButton("x")) app.loader.cancel(job.id);
+                ImGui::SameLine();
+                std::string overlay = job.filename;
+                if (job.state == LoadState::Queued) overlay += " (queued)";
+                ImGui::ProgressBar(job.progress, ImVec2(-1, 0), overlay.c_str());
+                ImGui::PopID();
+            }
+            if (jobs.size() > maxShown) {
+                ImGui::TextDisabled("...and %d more", (int)(jobs.size() - maxShown));
+            }
+            ImGui::Spacing();
         }
 
         if (ImGui::Button("Clear All")) {
+            app.scanner.cancelAll();
+            app.folderScans.clear();
+            app.loader.cancelAll();
+            app.lodBuilder.cancelAll();
             app.models.clear();
+            app.renderer.evictAll();
+            app.sceneDirty = true;
             app.currentModel = -1;
             app.statusMsg = "All models cleared.";
         }
@@ -424,6 +1282,16 @@ static void drawUI(AppState& app) {
         if (app.settings.wireframe) {
             ImGui::ColorEdit3("Edge Color", app.settings.edgeColor);
             ImGui::SliderFloat("Edge Width", &app.settings.edgeWidth, 0.5f, 5.0f);
+            ImGui::Checkbox("Line overlay (second pass)", &app.settings.lineWireframe);
+        }
+
+        // Halves VRAM per vertex; drop cached meshes in the old format and
+        // re-upload so the viewport switches immediately
+        bool compact = app.renderer.getVertexFormat() == VertexFormat::Compact;
+        if (ImGui::Checkbox("Compact GPU vertices", &compact)) {
+            app.renderer.setVertexFormat(compact ? VertexFormat::Compact : VertexFormat::Float);
+            app.renderer.evictAll();
+            showModel(app, app.currentModel);
         }
     }
 
@@ -442,6 +1310,24 @@ static void drawUI(AppState& app) {
         }
     }
 
+    // ── Measure ─────────────────────────────────────────
+    if (ImGui::CollapsingHeader("Measure")) {
+        ImGui::TextDisabled("Ctrl+click the model to place A, then B");
+        const char* names[2] = {"A", "B"};
+        for (size_t i = 0; i < app.measurePoints.size(); ++i) {
+            const auto& p = app.measurePoints[i];
+            ImGui::Text("%s: %.4g, %.4g, %.4g", names[i], p[0], p[1], p[2]);
+        }
+        if (app.measurePoints.size() == 2) {
+            const auto& a = app.measurePoints[0];
+            const auto& b = app.measurePoints[1];
+            float dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+            ImGui::Text("Distance: %.4g", std::sqrt(dx * dx + dy * dy + dz * dz));
+            ImGui::TextDisabled("dx %.4g  dy %.4g  dz %.4g", dx, dy, dz);
+        }
+        if (!app.measurePoints.empty() && ImGui::Button("Clear points")) app.measurePoints.clear();
+    }
+
     // ── Lighting ────────────────────────────────────────
     if (ImGui::CollapsingHeader("Lighting")) {
         ImGui::SliderFloat3("Light Dir", app.settings.lightDir, -1.0f, 1.0f);
@@ -459,6 +1345,46 @@ static void drawUI(AppState& app) {
         ImGui::InputInt("Height", &app.settings.exportHeight);
         app.settings.exportWidth  = std::max(app.settings.exportWidth, 64);
         app.settings.exportHeight = std::max(app.settings.exportHeight, 64);
+        if (std::max(app.settings.exportWidth, app.settings.exportHeight) > app.renderer.getMaxTargetSize()) {
+            ImGui::TextDisabled("Past the %d px GPU limit: rendered in tiles, PNG only",
+                                app.renderer.getMaxTargetSize());
+        }
+
+        // Raw streams are CLI-only; WebP shows up when it's compiled in
+        const char* formats[] = {"PNG", "QOI", "JPEG", "WebP"};
+        int formatCount = Exporter::formatAvailable(Exporter::ImageFormat::WebP) ? 4 : 3;
+        int format = (int)app.exportFormat.format;
+        if (ImGui::Combo("Format", &format, formats, formatCount)) {
+            app.exportFormat.format = (Exporter::ImageFormat)format;
+        }
+
+        auto& fmt = app.exportFormat;
+        if (fmt.format == Exporter::ImageFormat::PNG) {
+            const char* levels[] = {"Fast", "Balanced", "Small"};
+            int level = (int)fmt.png.compression;
+            if (ImGui::Combo("PNG compression", &level, levels, 3)) {
+                fmt.png.compression = (Exporter::PNGCompression)level;
+            }
+        } else if (fmt.format == Exporter::ImageFormat::JPEG || fmt.format == Exporter::ImageFormat::WebP) {
+            ImGui::SliderInt("Quality", &fmt.quality, 1, 100);
+        }
+
+        // Opaque exports are written as RGB unless alpha is kept explicitly
+        if (fmt.format != Exporter::ImageFormat::JPEG) {
+            bool keepAlpha = fmt.png.alpha == Exporter::AlphaMode::Keep;
+            if (ImGui::Checkbox("Keep alpha channel", &keepAlpha)) {
+                fmt.png.alpha = keepAlpha ? Exporter::AlphaMode::Keep : Exporter::AlphaMode::Auto;
+            }
+        }
+
+        // Turntable: width x height is per view; one upload and readback per model
+        ImGui::SliderInt("Views", &app.exportViews, 1, 36);
+        if (app.exportViews > 1) {
+            ImGui::Checkbox("Separate files per view", &app.splitViews);
+        }
+
+        // > 1 runs Export All on hidden contexts with their own renderers
+        ImGui::SliderInt("Export contexts", &app.exportContexts, 1, 8);
 
         ImGui::Spacing();
 
@@ -475,7 +1401,7 @@ static void drawUI(AppState& app) {
                 }
             }
         } else {
-            ImGui::TextDisabled("PNGs will be saved in the same folder as each STL.");
+            ImGui::TextDisabled("Images will be saved in the same folder as each STL.");
         }
 
         ImGui::Spacing();
@@ -490,16 +1416,21 @@ static void drawUI(AppState& app) {
 
         ImGui::SameLine();
 
-        if (app.models.empty()) ImGui::BeginDisabled();
+        bool canExportAll = !app.models.empty() && !app.exporting;
+        if (!canExportAll) ImGui::BeginDisabled();
         if (ImGui::Button("Export All", ImVec2(145, 0))) {
             exportAll(app);
         }
-        if (app.models.empty()) ImGui::EndDisabled();
+        if (!canExportAll) ImGui::EndDisabled();
 
         if (app.exporting) {
             float progress = app.totalToExport > 0
                 ? (float)app.exportedCount / (float)app.totalToExport : 0;
             ImGui::ProgressBar(progress);
+            if (ImGui::Button("Cancel export")) {
+                if (app.exportJob)  app.exportJob->cancel();
+                if (app.exportFarm) app.exportFarm->cancel();
+            }
         }
     }
 
@@ -518,6 +1449,9 @@ static void drawUI(AppState& app) {
 // Shared logic in appMain(); main() and WinMain() both call it.
 
 static int appMain(int argc, char** argv) {
+    // `--export ...` runs headless: no visible window, no ImGui
+    if (BatchCLI::requested(argc, argv)) return BatchCLI::run(argc, argv);
+
     // Init GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -567,6 +1501,8 @@ static int appMain(int argc, char** argv) {
 
     // App state
     AppState app;
+    app.loadOptions.buildBVH = true;
+    app.loadOptions.cacheDir = MeshCache::defaultDirectory();
     if (!app.renderer.init()) {
         std::cerr << "Failed to initialize renderer" << std::endl;
         return 1;
@@ -588,13 +1524,22 @@ static int appMain(int argc, char** argv) {
 
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        waitForEvents(app);
+        auto frameStart = std::chrono::steady_clock::now();
 
         // Start ImGui frame (must happen before checking ImGui state)
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        // Pick up models the background loader finished since last frame
+        pumpStreams(app);
+        pumpScans(app);
+        pumpLoadQueue(app);
+        pumpLods(app);
+        pumpScene(app);
+        pumpExport(app);
+
         // Handle mouse orbit/zoom (polled, not via callbacks)
         handleMouseInput(window, app);
 
@@ -612,8 +1557,11 @@ static int appMain(int argc, char** argv) {
             if (io.KeyShift) exportAll(app);
             else exportCurrent(app);
         }
+        if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) app.showPerf = !app.showPerf;
 
         drawUI(app);
+        drawMeasureOverlay(window, app);
+        drawPerfOverlay(app);
 
         ImGui::Render();
 
@@ -641,7 +1589,16 @@ static int appMain(int argc, char** argv) {
             glScissor(vpX, 0, vpW, vpH);
             glEnable(GL_SCISSOR_TEST);
             glEnable(GL_DEPTH_TEST);
-            app.renderer.render(app.settings, vpW, vpH);
+            // The mesh is redrawn only when something it shows changed;
+            // otherwise the cached image is composited under the UI
+            app.renderer.setInteractive(app.dragging && app.coarseWhileOrbiting);
+            bool scene = app.sceneMode && app.renderer.hasScene();
+            if (app.renderer.drawViewport(app.settings, vpW, vpH, scene, viewportChanged(app, scene))) {
+                app.viewSettings   = app.settings;
+                app.viewGeneration = app.renderer.drawGeneration();
+                app.viewScene      = scene;
+                app.viewRedraws++;
+            }
             glDisable(GL_SCISSOR_TEST);
         }
 
@@ -650,10 +1607,13 @@ static int appMain(int argc, char** argv) {
         glViewport(0, 0, winW, winH);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        app.lastFrameMs = (float)msSince(frameStart);
         glfwSwapBuffers(window);
     }
 
-    // Cleanup
+    // Cleanup (the pipeline owns GL objects, so it goes while the context is alive)
+    app.exportJob.reset();
+    app.exportFarm.reset();
     app.renderer.shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
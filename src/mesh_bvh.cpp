@@ -0,0 +1,350 @@
+#include "stl_loader.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+// ── Bounding volume hierarchy ───────────────────────────────────────────────
+// Top-down build with binned SAH on the widest centroid axis. Partitioning
+// happens in a triangle order array, so each subtree ends up owning a
+// contiguous run of it; the mesh is then reordered to match, which lets the
+// renderer draw any set of visible nodes as a few merged index ranges.
+// Large subtrees are built on their own threads into private node arrays
+// and spliced in afterwards.
+
+namespace {
+
+constexpr size_t   kFloatsPerVertex   = 6;        // nx,ny,nz, vx,vy,vz
+constexpr size_t   kFloatsPerTriangle = 3 * kFloatsPerVertex;
+constexpr uint32_t kLeafSize          = 8;        // Always a leaf at or below this
+constexpr uint32_t kMaxLeafSize       = 32;       // SAH may stop splitting up to this
+constexpr int      kBins              = 16;
+constexpr uint32_t kMinParallelTris   = 64 * 1024;
+constexpr size_t   kMinChunkTris      = 64 * 1024;
+
+struct Box {
+    float min[3] = { std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),
+                     std::numeric_limits<float>::max()};
+    float max[3] = {-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                    -std::numeric_limits<float>::max()};
+
+    void grow(const float* lo, const float* hi) {
+        for (int a = 0; a < 3; ++a) {
+            min[a] = std::min(min[a], lo[a]);
+            max[a] = std::max(max[a], hi[a]);
+        }
+    }
+    void grow(const Box& b) { grow(b.min, b.max); }
+
+    float area() const {
+        float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+        if (dx < 0.0f) return 0.0f;   // Empty
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+class Builder {
+public:
+    Builder(const std::vector<float>& boxes, const std::vector<float>& centroids,
+            std::vector<uint32_t>& order, unsigned threads)
+        : boxes_(boxes), centroids_(centroids), order_(order), spare_(threads > 0 ? threads - 1 : 0) {}
+
+    // Builds the subtree over order[first, first + count) into `nodes`;
+    // returns its root's index there
+    uint32_t build(std::vector<BVHNode>& nodes, uint32_t first, uint32_t count) {
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back({});
+
+        Box bounds, centroidBounds;
+        for (uint32_t i = first; i < first + count; ++i) {
+            uint32_t t = order_[i];
+            bounds.grow(&boxes_[size_t(t) * 6], &boxes_[size_t(t) * 6 + 3]);
+            centroidBounds.grow(&centroids_[size_t(t) * 3], &centroids_[size_t(t) * 3]);
+        }
+        BVHNode& node = nodes[index];
+        std::memcpy(node.min, bounds.min, sizeof(node.min));
+        std::memcpy(node.max, bounds.max, sizeof(node.max));
+        node.first = first;
+        node.count = count;
+        node.left = node.right = 0;
+
+        if (count <= kLeafSize) return index;
+
+        uint32_t mid = split(first, count, bounds, centroidBounds);
+        if (mid == first) return index;   // SAH says a leaf is cheaper
+
+        uint32_t leftCount = mid - first, rightCount = count - leftCount;
+        uint32_t left, right;
+        if (std::min(leftCount, rightCount) >= kMinParallelTris && claimThread()) {
+            std::vector<BVHNode> sub;
+            sub.reserve(size_t(leftCount) / kLeafSize * 2);
+            std::thread worker([&] { build(sub, first, leftCount); });
+            right = build(nodes, mid, rightCount);
+            worker.join();
+            spare_.fetch_add(1);
+
+            left = uint32_t(nodes.size());
+            for (BVHNode n : sub) {
+                if (!n.isLeaf()) {
+                    n.left  += left;
+                    n.right += left;
+                }
+                nodes.push_back(n);
+            }
+        } else {
+            left  = build(nodes, first, leftCount);
+            right = build(nodes, mid, rightCount);
+        }
+        nodes[index].left  = left;
+        nodes[index].right = right;
+        return index;
+    }
+
+private:
+    bool claimThread() {
+        unsigned n = spare_.load();
+        while (n > 0) {
+            if (spare_.compare_exchange_weak(n, n - 1)) return true;
+        }
+        return false;
+    }
+
+    // Partitions the range and returns the first triangle of the right half,
+    // or `first` to make a leaf
+    uint32_t split(uint32_t first, uint32_t count, const Box& bounds, const Box& centroidBounds) {
+        int axis = 0;
+        float extent[3];
+        for (int a = 0; a < 3; ++a) extent[a] = centroidBounds.max[a] - centroidBounds.min[a];
+        if (extent[1] > extent[axis]) axis = 1;
+        if (extent[2] > extent[axis]) axis = 2;
+
+        uint32_t* begin = order_.data() + first;
+        uint32_t* end   = begin + count;
+        auto centroid = [&](uint32_t t) { return centroids_[size_t(t) * 3 + axis]; };
+
+        if (!(extent[axis] > 0.0f)) {
+            // Every centroid in one spot: halve by order so huge piles still split
+            if (count <= kMaxLeafSize) return first;
+            return first + count / 2;
+        }
+
+        const float lo = centroidBounds.min[axis];
+        const float scale = kBins / extent[axis];
+        auto binOf = [&](uint32_t t) {
+            return std::min(kBins - 1, int((centroid(t) - lo) * scale));
+        };
+
+        Box      binBox[kBins];
+        uint32_t binCount[kBins] = {};
+        for (uint32_t* p = begin; p != end; ++p) {
+            int b = binOf(*p);
+            binBox[b].grow(&boxes_[size_t(*p) * 6], &boxes_[size_t(*p) * 6 + 3]);
+            binCount[b]++;
+        }
+
+        // Sweep from the right for suffix areas, then from the left for the cost
+        float    rightArea[kBins];
+        uint32_t rightCount[kBins];
+        Box acc;
+        uint32_t n = 0;
+        for (int b = kBins - 1; b > 0; --b) {
+            acc.grow(binBox[b]);
+            n += binCount[b];
+            rightArea[b]  = acc.area();
+            rightCount[b] = n;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        int   bestSplit = -1;
+        acc = Box();
+        n = 0;
+        for (int b = 1; b < kBins; ++b) {
+            acc.grow(binBox[b - 1]);
+            n += binCount[b - 1];
+            if (n == 0 || rightCount[b] == 0) continue;
+            float cost = acc.area() * n + rightArea[b] * rightCount[b];
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit < 0) {
+            // All centroids in one bin (float rounding): median split
+            if (count <= kMaxLeafSize) return first;
+            uint32_t* m = begin + count / 2;
+            std::nth_element(begin, m, end, [&](uint32_t a, uint32_t b) { return centroid(a) < centroid(b); });
+            return first + count / 2;
+        }
+        // Traversal costs about as much as one triangle test
+        if (count <= kMaxLeafSize && bestCost >= bounds.area() * (count - 1)) return first;
+
+        uint32_t* m = std::partition(begin, end, [&](uint32_t t) { return binOf(t) < bestSplit; });
+        return first + uint32_t(m - begin);
+    }
+
+    const std::vector<float>& boxes_;       // min xyz, max xyz per triangle
+    const std::vector<float>& centroids_;
+    std::vector<uint32_t>&    order_;
+    std::atomic<unsigned>     spare_;
+};
+
+// Slab test; true if the ray enters the box before `limit`
+inline bool hitBox(const BVHNode& n, const float* origin, const float* invDir, float limit) {
+    float t0 = 0.0f, t1 = limit;
+    for (int a = 0; a < 3; ++a) {
+        float near = (n.min[a] - origin[a]) * invDir[a];
+        float far  = (n.max[a] - origin[a]) * invDir[a];
+        if (near > far) std::swap(near, far);
+        t0 = near > t0 ? near : t0;
+        t1 = far < t1 ? far : t1;
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+// Möller–Trumbore, double-sided
+inline bool hitTriangle(const float* o, const float* d,
+                        const float* p0, const float* p1, const float* p2, float& t) {
+    float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    float p[3]  = {d[1]*e2[2] - d[2]*e2[1], d[2]*e2[0] - d[0]*e2[2], d[0]*e2[1] - d[1]*e2[0]};
+    float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if (std::fabs(det) < 1e-20f) return false;
+    float inv = 1.0f / det;
+
+    float s[3] = {o[0] - p0[0], o[1] - p0[1], o[2] - p0[2]};
+    float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+
+    float q[3] = {s[1]*e1[2] - s[2]*e1[1], s[2]*e1[0] - s[0]*e1[2], s[0]*e1[1] - s[1]*e1[0]};
+    float v = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+
+    t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv;
+    return t > 0.0f;
+}
+
+} // namespace
+
+void STLModel::buildBVH(unsigned threads) {
+    const size_t numTris = triangleCount();
+    if (numTris == 0 || numTris > std::numeric_limits<uint32_t>::max()) return;
+
+    threads = Parallel::threadCount(threads);
+    auto position = [&](size_t t, int corner) -> const float* {
+        size_t v = isIndexed() ? indices[t * 3 + corner] : t * 3 + corner;
+        return &glVertices[v * kFloatsPerVertex + 3];
+    };
+
+    // 1. Per-triangle boxes and centroids
+    std::vector<float> boxes(numTris * 6), centroids(numTris * 3);
+    Parallel::forChunks(numTris, kMinChunkTris, threads, [&](size_t b, size_t e, size_t) {
+        for (size_t t = b; t < e; ++t) {
+            const float* p0 = position(t, 0);
+            const float* p1 = position(t, 1);
+            const float* p2 = position(t, 2);
+            float* box = &boxes[t * 6];
+            for (int a = 0; a < 3; ++a) {
+                box[a]     = std::min({p0[a], p1[a], p2[a]});
+                box[3 + a] = std::max({p0[a], p1[a], p2[a]});
+                centroids[t * 3 + a] = (box[a] + box[3 + a]) * 0.5f;
+            }
+        }
+    });
+
+    // 2. Build over a triangle order array
+    std::vector<uint32_t> order(numTris);
+    for (size_t t = 0; t < numTris; ++t) order[t] = uint32_t(t);
+
+    auto tree = std::make_shared<MeshBVH>();
+    tree->nodes.reserve(numTris / kLeafSize * 2);
+    Builder(boxes, centroids, order, threads).build(tree->nodes, 0, uint32_t(numTris));
+    tree->nodes.shrink_to_fit();
+    std::vector<float>().swap(boxes);
+    std::vector<float>().swap(centroids);
+
+    // 3. Reorder the mesh so node ranges are draw ranges
+    if (isIndexed()) {
+        std::vector<uint32_t> reordered(indices.size());
+        Parallel::forChunks(numTris, kMinChunkTris, threads, [&](size_t b, size_t e, size_t) {
+            for (size_t t = b; t < e; ++t) {
+                std::memcpy(&reordered[t * 3], &indices[size_t(order[t]) * 3], 3 * sizeof(uint32_t));
+            }
+        });
+        indices = std::move(reordered);
+    } else {
+        std::vector<float> reordered(glVertices.size());
+        Parallel::forChunks(numTris, kMinChunkTris, threads, [&](size_t b, size_t e, size_t) {
+            for (size_t t = b; t < e; ++t) {
+                std::memcpy(&reordered[t * kFloatsPerTriangle], &glVertices[size_t(order[t]) * kFloatsPerTriangle],
+                            kFloatsPerTriangle * sizeof(float));
+            }
+        });
+        glVertices = std::move(reordered);
+    }
+    if (triangles.size() == numTris) {
+        std::vector<Triangle> reordered(numTris);
+        for (size_t t = 0; t < numTris; ++t) reordered[t] = triangles[order[t]];
+        triangles = std::move(reordered);
+    }
+
+    bvh = std::move(tree);
+    touch();
+}
+
+bool STLModel::raycast(const std::array<float, 3>& origin, const std::array<float, 3>& dir, RayHit& hit) const {
+    const size_t numTris = triangleCount();
+    float len = std::sqrt(dir[0]*dir[0] + dir[1]*dir[1] + dir[2]*dir[2]);
+    if (numTris == 0 || !(len > 0.0f)) return false;
+
+    const float o[3] = {origin[0], origin[1], origin[2]};
+    const float d[3] = {dir[0] / len, dir[1] / len, dir[2] / len};
+    auto position = [&](size_t t, int corner) -> const float* {
+        size_t v = isIndexed() ? indices[t * 3 + corner] : t * 3 + corner;
+        return &glVertices[v * kFloatsPerVertex + 3];
+    };
+
+    float best = std::numeric_limits<float>::max();
+    size_t bestTri = 0;
+    bool found = false;
+    auto test = [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            float dist;
+            if (hitTriangle(o, d, position(t, 0), position(t, 1), position(t, 2), dist) && dist < best) {
+                best    = dist;
+                bestTri = t;
+                found   = true;
+            }
+        }
+    };
+
+    if (!bvh || bvh->nodes.empty()) {
+        test(0, numTris);
+    } else {
+        const float inv[3] = {1.0f / d[0], 1.0f / d[1], 1.0f / d[2]};
+        const auto& nodes = bvh->nodes;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BVHNode& n = nodes[stack[--top]];
+            if (!hitBox(n, o, inv, best)) continue;
+            if (n.isLeaf() || top + 2 > 64) {
+                test(n.first, size_t(n.first) + n.count);
+                continue;
+            }
+            stack[top++] = n.left;
+            stack[top++] = n.right;
+        }
+    }
+
+    if (!found) return false;
+    hit.t        = best;
+    hit.triangle = bestTri;
+    hit.point    = {o[0] + d[0] * best, o[1] + d[1] * best, o[2] + d[2] * best};
+    return true;
+}
@@ -0,0 +1,277 @@
+#include "mesh_cache.h"
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace MeshCache {
+
+// ── File layout ─────────────────────────────────────────────────────────────
+// [Header][source path][pad] then glVertices, indices and BVH nodes, each
+// starting on a 64-byte boundary. All counts are elements, not bytes.
+
+namespace {
+
+constexpr char     kMagic[8]    = {'S', 'T', 'L', 'M', 'E', 'S', 'H', '\0'};
+constexpr uint32_t kByteOrder   = 0x01020304u;
+constexpr size_t   kAlign       = 64;
+constexpr const char* kExtension = ".mesh";
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceSize;
+    int64_t  sourceMtime;
+    uint64_t optionsKey;
+    uint64_t vertexFloats;
+    uint64_t indexCount;
+    uint64_t nodeCount;
+    float    bounds[6];     // min xyz, max xyz
+    uint32_t pathBytes;
+    uint32_t nodeBytes;     // sizeof(BVHNode) when written
+};
+
+inline size_t alignUp(size_t v) { return (v + kAlign - 1) & ~(kAlign - 1); }
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t h = 0xCBF29CE484222325ull) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+// Everything in LoadOptions that changes the arrays load() produces
+uint64_t optionsKey(const LoadOptions& o) {
+    uint32_t fields[4] = {
+        uint32_t(o.weld),
+        0,
+        uint32_t(o.weldOptions.normals == NormalMode::Smooth),
+        uint32_t(o.buildBVH),
+    };
+    if (o.weld) std::memcpy(&fields[1], &o.weldOptions.epsilon, sizeof(float));
+    else        fields[2] = 0;
+    return fnv1a(fields, sizeof(fields), fnv1a(&kVersion, sizeof(kVersion)));
+}
+
+bool sourceStamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec) return false;
+    auto time = fs::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = int64_t(time.time_since_epoch().count());
+    return true;
+}
+
+unsigned long processId() {
+#ifdef _WIN32
+    return (unsigned long)_getpid();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+std::string absolutePath(const std::string& path) {
+    std::error_code ec;
+    fs::path abs = fs::absolute(path, ec);
+    return ec ? path : abs.lexically_normal().string();
+}
+
+struct Layout {
+    size_t vertices, indices, nodes, end;
+};
+
+Layout layoutOf(const Header& h) {
+    Layout l;
+    l.vertices = alignUp(sizeof(Header) + h.pathBytes);
+    l.indices  = alignUp(l.vertices + h.vertexFloats * sizeof(float));
+    l.nodes    = alignUp(l.indices + h.indexCount * sizeof(uint32_t));
+    l.end      = l.nodes + h.nodeCount * sizeof(BVHNode);
+    return l;
+}
+
+bool writeAll(FILE* f, const void* data, size_t bytes) {
+    return bytes == 0 || std::fwrite(data, 1, bytes, f) == bytes;
+}
+
+bool padTo(FILE* f, size_t& offset, size_t target) {
+    static const char zeros[kAlign] = {};
+    size_t n = target - offset;
+    offset = target;
+    return writeAll(f, zeros, n);
+}
+
+} // namespace
+
+// ── Public API ──────────────────────────────────────────────────────────────
+
+std::string defaultDirectory() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (base && *base) return (fs::path(base) / "stl_viewer" / "cache").string();
+#else
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return (fs::path(xdg) / "stl_viewer").string();
+    const char* home = std::getenv("HOME");
+    if (home && *home) return (fs::path(home) / ".cache" / "stl_viewer").string();
+#endif
+    std::error_code ec;
+    return (fs::temp_directory_path(ec) / "stl_viewer_cache").string();
+}
+
+std::string entryPath(const std::string& stlPath, const LoadOptions& options) {
+    std::string abs = absolutePath(stlPath);
+    uint64_t key = fnv1a(abs.data(), abs.size()) ^ optionsKey(options);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+    return (fs::path(options.cacheDir) / (std::string(name) + kExtension)).string();
+}
+
+bool load(const std::string& stlPath, const LoadOptions& options, STLModel& model) {
+    if (options.cacheDir.empty()) return false;
+
+    uint64_t size;
+    int64_t  mtime;
+    if (!sourceStamp(stlPath, size, mtime)) return false;
+
+    MappedFile file;
+    if (!file.open(entryPath(stlPath, options))) return false;   // Miss
+    if (file.size() < sizeof(Header)) return false;
+
+    Header h;
+    std::memcpy(&h, file.data(), sizeof(Header));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion ||
+        h.byteOrder != kByteOrder || h.nodeBytes != sizeof(BVHNode)) {
+        return false;
+    }
+    if (h.sourceSize != size || h.sourceMtime != mtime || h.optionsKey != optionsKey(options)) return false;
+    if (h.vertexFloats == 0 || h.vertexFloats % 6 != 0 || h.indexCount % 3 != 0) return false;
+
+    // Guard the size arithmetic against a corrupt header before trusting it
+    const uint64_t limit = file.size();
+    if (h.pathBytes > limit || h.vertexFloats > limit / sizeof(float) ||
+        h.indexCount > limit / sizeof(uint32_t) || h.nodeCount > limit / sizeof(BVHNode)) {
+        return false;
+    }
+    Layout l = layoutOf(h);
+    if (l.end > file.size()) return false;   // Truncated
+
+    // Hash collisions: the stored path must be this file's
+    std::string abs = absolutePath(stlPath);
+    if (h.pathBytes != abs.size() || std::memcmp(file.data() + sizeof(Header), abs.data(), abs.size()) != 0) {
+        return false;
+    }
+
+    const char* base = file.data();
+    const float* vertices = reinterpret_cast<const float*>(base + l.vertices);
+    model.glVertices.assign(vertices, vertices + h.vertexFloats);
+    model.vertexCount = h.vertexFloats / 6;
+
+    const uint32_t* indices = reinterpret_cast<const uint32_t*>(base + l.indices);
+    model.indices.assign(indices, indices + h.indexCount);
+
+    model.bvh.reset();
+    if (h.nodeCount > 0) {
+        auto bvh = std::make_shared<MeshBVH>();
+        const BVHNode* nodes = reinterpret_cast<const BVHNode*>(base + l.nodes);
+        bvh->nodes.assign(nodes, nodes + h.nodeCount);
+        model.bvh = std::move(bvh);
+    }
+
+    model.bounds.minX = h.bounds[0]; model.bounds.minY = h.bounds[1]; model.bounds.minZ = h.bounds[2];
+    model.bounds.maxX = h.bounds[3]; model.bounds.maxY = h.bounds[4]; model.bounds.maxZ = h.bounds[5];
+    model.touch();
+    return true;
+}
+
+bool save(const std::string& stlPath, const LoadOptions& options, const STLModel& model) {
+    if (options.cacheDir.empty() || model.vertexCount == 0) return false;
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version   = kVersion;
+    h.byteOrder = kByteOrder;
+    if (!sourceStamp(stlPath, h.sourceSize, h.sourceMtime)) return false;
+    h.optionsKey   = optionsKey(options);
+    h.vertexFloats = model.glVertices.size();
+    h.indexCount   = model.indices.size();
+    h.nodeCount    = model.bvh ? model.bvh->nodes.size() : 0;
+    const BoundingBox& b = model.bounds;
+    float bounds[6] = {b.minX, b.minY, b.minZ, b.maxX, b.maxY, b.maxZ};
+    std::memcpy(h.bounds, bounds, sizeof(bounds));
+    std::string abs = absolutePath(stlPath);
+    h.pathBytes = uint32_t(abs.size());
+    h.nodeBytes = uint32_t(sizeof(BVHNode));
+
+    std::error_code ec;
+    fs::create_directories(options.cacheDir, ec);
+
+    // Loader threads, and other processes sharing the cache (the GUI, batch
+    // runs, --shard siblings), may save the same file at once; each writes its
+    // own temp. Thread ids repeat across processes, so the process id goes in too.
+    std::string path = entryPath(stlPath, options);
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%lx-%zx.tmp", processId(),
+                  std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::string tmp = path + suffix;
+
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Cannot write mesh cache: " << tmp << std::endl;
+        return false;
+    }
+
+    Layout l = layoutOf(h);
+    size_t offset = sizeof(Header) + abs.size();
+    bool ok = writeAll(f, &h, sizeof(Header)) && writeAll(f, abs.data(), abs.size()) &&
+              padTo(f, offset, l.vertices) &&
+              writeAll(f, model.glVertices.data(), h.vertexFloats * sizeof(float)) &&
+              (offset += h.vertexFloats * sizeof(float), padTo(f, offset, l.indices)) &&
+              writeAll(f, model.indices.data(), h.indexCount * sizeof(uint32_t)) &&
+              (offset += h.indexCount * sizeof(uint32_t), padTo(f, offset, l.nodes)) &&
+              (h.nodeCount == 0 || writeAll(f, model.bvh->nodes.data(), h.nodeCount * sizeof(BVHNode)));
+    ok = (std::fclose(f) == 0) && ok;
+
+    if (ok) {
+        // rename() won't replace an existing file on Windows
+        fs::rename(tmp, path, ec);
+        if (ec) {
+            fs::remove(path, ec);
+            fs::rename(tmp, path, ec);
+        }
+        ok = !ec;
+    }
+    if (!ok) {
+        std::cerr << "Failed to write mesh cache: " << path << std::endl;
+        fs::remove(tmp, ec);
+    }
+    return ok;
+}
+
+size_t clear(const std::string& directory) {
+    std::error_code ec;
+    size_t removed = 0;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == kExtension && fs::remove(it->path(), ec)) removed++;
+    }
+    return removed;
+}
+
+} // namespace MeshCache
@@ -0,0 +1,272 @@
+#include "mesh_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define STL_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define STL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC / Clang compile functions for extensions the rest of the file doesn't
+// assume; MSVC accepts the intrinsics anywhere
+#if defined(STL_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define STL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define STL_TARGET_AVX2
+#endif
+
+namespace MeshKernels {
+
+namespace {
+
+// ── Scalar ──────────────────────────────────────────────────────────────────
+
+// Cross product of (v1-v0) x (v2-v0), normalized, if the stored normal is
+// all zero (some exporters do this). Returns false to keep the stored one.
+inline bool fixedNormal(const float* t, float n[3]) {
+    float len = t[0]*t[0] + t[1]*t[1] + t[2]*t[2];
+    if (len >= 1e-6f) return false;
+    float ux = t[6] - t[3], uy = t[7] - t[4], uz = t[8]  - t[5];
+    float vx = t[9] - t[3], vy = t[10] - t[4], vz = t[11] - t[5];
+    float nx = uy*vz - uz*vy;
+    float ny = uz*vx - ux*vz;
+    float nz = ux*vy - uy*vx;
+    float nlen = std::sqrt(nx*nx + ny*ny + nz*nz);
+    if (nlen <= 1e-6f) return false;
+    n[0] = nx / nlen; n[1] = ny / nlen; n[2] = nz / nlen;
+    return true;
+}
+
+inline void emitOne(const char* src, float* out, BoundingBox& box) {
+    float t[12];
+    std::memcpy(t, src, sizeof(t));
+    float n[3] = {t[0], t[1], t[2]};
+    fixedNormal(t, n);
+    for (int v = 0; v < 3; ++v) {
+        const float* p = &t[3 + v * 3];
+        box.minX = std::min(box.minX, p[0]); box.maxX = std::max(box.maxX, p[0]);
+        box.minY = std::min(box.minY, p[1]); box.maxY = std::max(box.maxY, p[1]);
+        box.minZ = std::min(box.minZ, p[2]); box.maxZ = std::max(box.maxZ, p[2]);
+        *out++ = n[0]; *out++ = n[1]; *out++ = n[2];
+        *out++ = p[0]; *out++ = p[1]; *out++ = p[2];
+    }
+}
+
+void emitScalar(const char* src, size_t stride, size_t count, float* out, BoundingBox& box) {
+    for (size_t i = 0; i < count; ++i, src += stride, out += 18) emitOne(src, out, box);
+}
+
+// The vector kernels load and store 16 bytes per vertex, which reaches 4
+// bytes past a triangle's input and output. Within a run that's the next
+// triangle (re-read, or overwritten a moment later); the last triangle of
+// each run goes through emitOne() so nothing outside the run is touched.
+
+#ifdef STL_KERNELS_X86
+
+// ── SSE2 (x86-64 baseline) ──────────────────────────────────────────────────
+
+inline __m128 sseNormal(const char* r, __m128 n) {
+    __m128 nn  = _mm_mul_ps(n, n);
+    __m128 sum = _mm_add_ss(_mm_add_ss(nn, _mm_shuffle_ps(nn, nn, 1)), _mm_shuffle_ps(nn, nn, 2));
+    if (_mm_cvtss_f32(sum) >= 1e-6f) return n;
+
+    // Rare: exporters that leave normals zero usually do it for every facet,
+    // but the cross product is cheap next to the memory traffic
+    float t[12], fixed[3];
+    std::memcpy(t, r, sizeof(t));
+    if (!fixedNormal(t, fixed)) return n;
+    return _mm_setr_ps(fixed[0], fixed[1], fixed[2], 0.0f);
+}
+
+inline void sseStore(float* out, __m128 n, __m128 a, __m128 b, __m128 c) {
+    // Each store's 4th lane is overwritten by the next one
+    _mm_storeu_ps(out,      n);
+    _mm_storeu_ps(out + 3,  a);
+    _mm_storeu_ps(out + 6,  n);
+    _mm_storeu_ps(out + 9,  b);
+    _mm_storeu_ps(out + 12, n);
+    _mm_storeu_ps(out + 15, c);
+}
+
+// Lane 3 of the loaded vertices is the next field, so only x, y, z of the
+// running min / max are meaningful. The running value is the second operand,
+// which minps / maxps return when the other is NaN, like std::min's skip.
+inline void storeBox(__m128 lo, __m128 hi, BoundingBox& box) {
+    float l[4], h[4];
+    _mm_storeu_ps(l, lo);
+    _mm_storeu_ps(h, hi);
+    box.minX = l[0]; box.minY = l[1]; box.minZ = l[2];
+    box.maxX = h[0]; box.maxY = h[1]; box.maxZ = h[2];
+}
+
+void emitSSE2(const char* src, size_t stride, size_t count, float* out, BoundingBox& box) {
+    if (count == 0) return;
+    __m128 lo = _mm_setr_ps(box.minX, box.minY, box.minZ, 0.0f);
+    __m128 hi = _mm_setr_ps(box.maxX, box.maxY, box.maxZ, 0.0f);
+
+    for (size_t i = 0; i + 1 < count; ++i, src += stride, out += 18) {
+        const float* f = reinterpret_cast<const float*>(src);
+        __m128 n = sseNormal(src, _mm_loadu_ps(f));
+        __m128 a = _mm_loadu_ps(f + 3);
+        __m128 b = _mm_loadu_ps(f + 6);
+        __m128 c = _mm_loadu_ps(f + 9);
+        lo = _mm_min_ps(_mm_min_ps(a, _mm_min_ps(b, c)), lo);
+        hi = _mm_max_ps(_mm_max_ps(a, _mm_max_ps(b, c)), hi);
+        sseStore(out, n, a, b, c);
+    }
+
+    storeBox(lo, hi, box);
+    emitOne(src, out, box);
+}
+
+// ── AVX2 ────────────────────────────────────────────────────────────────────
+// Two triangles per iteration: their vertices share 256-bit min / max and
+// one dot-product test covers both normals.
+
+STL_TARGET_AVX2 inline __m256 pair(__m128 lo, __m128 hi) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+STL_TARGET_AVX2 void emitAVX2(const char* src, size_t stride, size_t count, float* out, BoundingBox& box) {
+    if (count == 0) return;
+    __m128 lo4 = _mm_setr_ps(box.minX, box.minY, box.minZ, 0.0f);
+    __m128 hi4 = _mm_setr_ps(box.maxX, box.maxY, box.maxZ, 0.0f);
+    __m256 lo = pair(lo4, lo4);
+    __m256 hi = pair(hi4, hi4);
+    const __m256 eps = _mm256_set1_ps(1e-6f);
+
+    size_t i = 0;
+    for (; i + 2 < count; i += 2, src += 2 * stride, out += 36) {
+        const float* f0 = reinterpret_cast<const float*>(src);
+        const float* f1 = reinterpret_cast<const float*>(src + stride);
+        __m128 n0 = _mm_loadu_ps(f0), n1 = _mm_loadu_ps(f1);
+        __m128 a0 = _mm_loadu_ps(f0 + 3), a1 = _mm_loadu_ps(f1 + 3);
+        __m128 b0 = _mm_loadu_ps(f0 + 6), b1 = _mm_loadu_ps(f1 + 6);
+        __m128 c0 = _mm_loadu_ps(f0 + 9), c1 = _mm_loadu_ps(f1 + 9);
+
+        __m256 a = pair(a0, a1), b = pair(b0, b1), c = pair(c0, c1);
+        lo = _mm256_min_ps(_mm256_min_ps(a, _mm256_min_ps(b, c)), lo);
+        hi = _mm256_max_ps(_mm256_max_ps(a, _mm256_max_ps(b, c)), hi);
+
+        // |n|^2 of x, y, z into lane 0 of each half
+        __m256 n = pair(n0, n1);
+        __m256 len = _mm256_dp_ps(n, n, 0x71);
+        int zero = _mm256_movemask_ps(_mm256_cmp_ps(len, eps, _CMP_LT_OQ)) & 0x11;
+        if (zero & 0x01) n0 = sseNormal(src, n0);
+        if (zero & 0x10) n1 = sseNormal(src + stride, n1);
+
+        sseStore(out,      n0, a0, b0, c0);
+        sseStore(out + 18, n1, a1, b1, c1);
+    }
+
+    lo4 = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+    hi4 = _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1));
+    storeBox(lo4, hi4, box);
+
+    // One or two left: the SSE2 kernel finishes (its last one scalar)
+    emitSSE2(src, stride, count - i, out, box);
+}
+
+bool cpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;   // OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // STL_KERNELS_X86
+
+#ifdef STL_KERNELS_NEON
+
+// ── NEON (AArch64 baseline) ─────────────────────────────────────────────────
+
+void emitNEON(const char* src, size_t stride, size_t count, float* out, BoundingBox& box) {
+    if (count == 0) return;
+    float lo0[4] = {box.minX, box.minY, box.minZ, 0.0f};
+    float hi0[4] = {box.maxX, box.maxY, box.maxZ, 0.0f};
+    float32x4_t lo = vld1q_f32(lo0);
+    float32x4_t hi = vld1q_f32(hi0);
+
+    for (size_t i = 0; i + 1 < count; ++i, src += stride, out += 18) {
+        const float* f = reinterpret_cast<const float*>(src);
+        float32x4_t n = vld1q_f32(f);
+        float32x4_t a = vld1q_f32(f + 3);
+        float32x4_t b = vld1q_f32(f + 6);
+        float32x4_t c = vld1q_f32(f + 9);
+        lo = vminnmq_f32(vminnmq_f32(a, vminnmq_f32(b, c)), lo);   // *nm: NaN lanes lose
+        hi = vmaxnmq_f32(vmaxnmq_f32(a, vmaxnmq_f32(b, c)), hi);
+
+        float32x4_t nn = vmulq_f32(n, n);
+        if (vgetq_lane_f32(nn, 0) + vgetq_lane_f32(nn, 1) + vgetq_lane_f32(nn, 2) < 1e-6f) {
+            float t[12], fixed[3];
+            std::memcpy(t, src, sizeof(t));
+            if (fixedNormal(t, fixed)) {
+                float v[4] = {fixed[0], fixed[1], fixed[2], 0.0f};
+                n = vld1q_f32(v);
+            }
+        }
+
+        vst1q_f32(out,      n);
+        vst1q_f32(out + 3,  a);
+        vst1q_f32(out + 6,  n);
+        vst1q_f32(out + 9,  b);
+        vst1q_f32(out + 12, n);
+        vst1q_f32(out + 15, c);
+    }
+
+    vst1q_f32(lo0, lo);
+    vst1q_f32(hi0, hi);
+    box.minX = lo0[0]; box.minY = lo0[1]; box.minZ = lo0[2];
+    box.maxX = hi0[0]; box.maxY = hi0[1]; box.maxZ = hi0[2];
+    emitOne(src, out, box);
+}
+
+#endif // STL_KERNELS_NEON
+
+const Kernel* pick() {
+    static const std::vector<Kernel> kernels = available();
+    if (const char* name = std::getenv("STL_VIEWER_SIMD")) {
+        for (const auto& k : kernels) {
+            if (std::string(k.name) == name) return &k;
+        }
+    }
+    return &kernels.back();
+}
+
+} // namespace
+
+std::vector<Kernel> available() {
+    std::vector<Kernel> kernels{{"scalar", emitScalar}};
+#ifdef STL_KERNELS_X86
+    kernels.push_back({"sse2", emitSSE2});
+    if (cpuHasAVX2()) kernels.push_back({"avx2", emitAVX2});
+#endif
+#ifdef STL_KERNELS_NEON
+    kernels.push_back({"neon", emitNEON});
+#endif
+    return kernels;
+}
+
+const Kernel& best() {
+    static const Kernel* kernel = pick();
+    return *kernel;
+}
+
+} // namespace MeshKernels
@@ -0,0 +1,434 @@
+#include "mesh_lod.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// ── Quadric vertex clustering ───────────────────────────────────────────────
+// Three parallel passes over the triangles. (1) Each chunk accumulates face
+// quadrics into private per-shard cell tables, keyed by grid cell. (2) Each
+// shard's tables are merged and solved for the cell's representative
+// vertex. (3) Triangles are remapped to cells and kept only if their three
+// corners landed in different cells. Sharding by cell hash means no two
+// threads ever touch the same cell, as in the vertex weld.
+
+namespace {
+
+constexpr size_t   kFloatsPerVertex = 6;               // nx,ny,nz, vx,vy,vz
+constexpr size_t   kMinChunkTris    = 64 * 1024;
+constexpr uint64_t kEmptyKey        = ~0ull;
+constexpr int      kMaxResolution   = (1 << 21) - 1;   // 21 bits per axis in a key
+constexpr double   kMaxLevelRatio   = 0.6;              // Largest kept level vs the previous one
+
+// Plane quadric a*x + b*y + c*z + d, upper triangle of the 4x4 outer product:
+// aa ab ac ad bb bc bd cc cd dd
+struct Cell {
+    double   q[10] = {};
+    double   sum[3] = {};      // Position sum, then the solved position
+    uint32_t count = 0;
+};
+
+inline uint64_t mixKey(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDull;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+// Open-addressing map from cell key to an index into `cells`
+struct CellTable {
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> slots;
+    std::vector<Cell>     cells;
+    std::vector<uint64_t> cellKeys;
+
+    Cell& get(uint64_t key, uint64_t hash) {
+        if ((cells.size() + 1) * 2 > keys.size()) grow();
+        size_t mask = keys.size() - 1;
+        for (size_t slot = (hash >> 20) & mask;; slot = (slot + 1) & mask) {
+            if (keys[slot] == key) return cells[slots[slot]];
+            if (keys[slot] == kEmptyKey) {
+                keys[slot]  = key;
+                slots[slot] = uint32_t(cells.size());
+                cellKeys.push_back(key);
+                cells.emplace_back();
+                return cells.back();
+            }
+        }
+    }
+
+    int64_t find(uint64_t key, uint64_t hash) const {
+        if (keys.empty()) return -1;
+        size_t mask = keys.size() - 1;
+        for (size_t slot = (hash >> 20) & mask;; slot = (slot + 1) & mask) {
+            if (keys[slot] == key) return slots[slot];
+            if (keys[slot] == kEmptyKey) return -1;
+        }
+    }
+
+private:
+    void grow() {
+        size_t capacity = std::max<size_t>(64, keys.size() * 2);
+        keys.assign(capacity, kEmptyKey);
+        slots.assign(capacity, 0);
+        size_t mask = capacity - 1;
+        for (uint32_t i = 0; i < cellKeys.size(); ++i) {
+            size_t slot = (mixKey(cellKeys[i]) >> 20) & mask;
+            while (keys[slot] != kEmptyKey) slot = (slot + 1) & mask;
+            keys[slot]  = cellKeys[i];
+            slots[slot] = i;
+        }
+    }
+};
+
+struct Grid {
+    double min[3];
+    double invCell;
+    double cell;
+    int    resolution;
+
+    uint64_t key(const double* p, int* coord = nullptr) const {
+        uint64_t k = 0;
+        for (int a = 0; a < 3; ++a) {
+            int i = int((p[a] - min[a]) * invCell);
+            i = std::clamp(i, 0, resolution - 1);
+            if (coord) coord[a] = i;
+            k |= uint64_t(i) << (21 * a);
+        }
+        return k;
+    }
+};
+
+// Minimise the quadric, regularised towards the cell's mean so flat and
+// creased regions (singular quadrics) still have a unique answer. Falls back
+// to the mean if the optimum leaves the cell's neighbourhood.
+void solveCell(Cell& c, const Grid& grid, uint64_t key) {
+    double mean[3];
+    for (int a = 0; a < 3; ++a) mean[a] = c.sum[a] / std::max<uint32_t>(1, c.count);
+
+    const double* q = c.q;
+    double lambda = 1e-3 * (q[0] + q[4] + q[7]) / 3.0 + 1e-30;
+    double A[3][3] = {{q[0] + lambda, q[1], q[2]},
+                      {q[1], q[4] + lambda, q[5]},
+                      {q[2], q[5], q[7] + lambda}};
+    double b[3] = {-q[3] + lambda * mean[0], -q[6] + lambda * mean[1], -q[8] + lambda * mean[2]};
+
+    double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+                 A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+                 A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+
+    double x[3] = {mean[0], mean[1], mean[2]};
+    if (std::fabs(det) > 1e-300) {
+        // Cramer's rule, one column replaced by b at a time
+        double sol[3];
+        for (int col = 0; col < 3; ++col) {
+            double M[3][3];
+            std::memcpy(M, A, sizeof(M));
+            for (int r = 0; r < 3; ++r) M[r][col] = b[r];
+            sol[col] = (M[0][0] * (M[1][1] * M[2][2] - M[1][2] * M[2][1]) -
+                        M[0][1] * (M[1][0] * M[2][2] - M[1][2] * M[2][0]) +
+                        M[0][2] * (M[1][0] * M[2][1] - M[1][1] * M[2][0])) / det;
+        }
+
+        bool inside = true;
+        for (int a = 0; a < 3; ++a) {
+            double lo = grid.min[a] + (double((key >> (21 * a)) & 0x1FFFFF) - 0.5) * grid.cell;
+            double hi = lo + 2.0 * grid.cell;
+            inside = inside && sol[a] >= lo && sol[a] <= hi;
+        }
+        if (inside) std::memcpy(x, sol, sizeof(x));
+    }
+    std::memcpy(c.sum, x, sizeof(x));
+}
+
+} // namespace
+
+bool simplifyMesh(const STLModel& source, int resolution, STLModel& out,
+                  unsigned threads, const std::atomic<bool>* cancel) {
+    const size_t numTris = source.triangleCount();
+    if (numTris == 0) return false;
+    auto cancelled = [&] { return cancel && cancel->load(std::memory_order_relaxed); };
+
+    const BoundingBox& bb = source.bounds;
+    Grid grid;
+    grid.min[0] = bb.minX;
+    grid.min[1] = bb.minY;
+    grid.min[2] = bb.minZ;
+    grid.resolution = std::clamp(resolution, 1, kMaxResolution);
+    grid.cell    = std::max(double(bb.span()), 1e-30) / grid.resolution;
+    grid.invCell = 1.0 / grid.cell;
+
+    auto position = [&](size_t t, int corner, double* p) {
+        size_t v = source.isIndexed() ? source.indices[t * 3 + corner] : t * 3 + corner;
+        const float* src = &source.glVertices[v * kFloatsPerVertex + 3];
+        p[0] = src[0]; p[1] = src[1]; p[2] = src[2];
+    };
+
+    threads = Parallel::threadCount(threads);
+    const size_t numChunks = Parallel::chunkCount(numTris, kMinChunkTris, threads);
+    const size_t numShards = numChunks * 4;
+    auto shardOf = [&](uint64_t hash) { return size_t(hash % numShards); };
+
+    // 1. Face quadrics into per-chunk, per-shard cell tables
+    std::vector<CellTable> local(numChunks * numShards);
+    Parallel::forChunks(numTris, kMinChunkTris, threads, [&](size_t b, size_t e, size_t c) {
+        CellTable* tables = &local[c * numShards];
+        for (size_t t = b; t < e; ++t) {
+            if ((t & 0xFFFF) == 0 && cancelled()) return;
+            double p[3][3];
+            for (int k = 0; k < 3; ++k) position(t, k, p[k]);
+
+            double e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+            double e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+            double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0]};
+            double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            double fq[10] = {};
+            if (len > 0.0) {
+                for (double& x : n) x /= len;
+                double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+                double w = len * 0.5;   // Area weighted
+                double plane[4] = {n[0], n[1], n[2], d};
+                int i = 0;
+                for (int r = 0; r < 4; ++r)
+                    for (int col = r; col < 4; ++col) fq[i++] = w * plane[r] * plane[col];
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                uint64_t key  = grid.key(p[k]);
+                uint64_t hash = mixKey(key);
+                Cell& cell = tables[shardOf(hash)].get(key, hash);
+                for (int i = 0; i < 10; ++i) cell.q[i] += fq[i];
+                for (int a = 0; a < 3; ++a) cell.sum[a] += p[k][a];
+                cell.count++;
+            }
+        }
+    });
+    if (cancelled()) return false;
+
+    // 2. Merge each shard's tables and solve its cells
+    std::vector<CellTable> merged(numShards);
+    Parallel::forChunks(numShards, 1, threads, [&](size_t sb, size_t se, size_t) {
+        for (size_t s = sb; s < se; ++s) {
+            CellTable& dst = merged[s];
+            dst = std::move(local[s]);
+            for (size_t c = 1; c < numChunks; ++c) {
+                CellTable& src = local[c * numShards + s];
+                for (size_t i = 0; i < src.cells.size(); ++i) {
+                    uint64_t key = src.cellKeys[i];
+                    Cell& cell = dst.get(key, mixKey(key));
+                    const Cell& from = src.cells[i];
+                    for (int k = 0; k < 10; ++k) cell.q[k] += from.q[k];
+                    for (int a = 0; a < 3; ++a) cell.sum[a] += from.sum[a];
+                    cell.count += from.count;
+                }
+                src = CellTable();
+            }
+            for (size_t i = 0; i < dst.cells.size(); ++i) solveCell(dst.cells[i], grid, dst.cellKeys[i]);
+        }
+    });
+    std::vector<CellTable>().swap(local);
+    if (cancelled()) return false;
+
+    std::vector<size_t> shardFirst(numShards + 1, 0);
+    for (size_t s = 0; s < numShards; ++s) shardFirst[s + 1] = shardFirst[s] + merged[s].cells.size();
+    const size_t numCells = shardFirst[numShards];
+    if (numCells > std::numeric_limits<uint32_t>::max()) return false;
+
+    // 3. Remap triangles to cells; collapsed ones drop out
+    std::vector<std::vector<uint32_t>> kept(numChunks);
+    Parallel::forChunks(numTris, kMinChunkTris, threads, [&](size_t b, size_t e, size_t c) {
+        std::vector<uint32_t>& dst = kept[c];
+        for (size_t t = b; t < e; ++t) {
+            uint32_t id[3];
+            for (int k = 0; k < 3; ++k) {
+                double p[3];
+                position(t, k, p);
+                uint64_t key  = grid.key(p);
+                uint64_t hash = mixKey(key);
+                size_t   s    = shardOf(hash);
+                id[k] = uint32_t(shardFirst[s] + size_t(merged[s].find(key, hash)));
+            }
+            if (id[0] == id[1] || id[1] == id[2] || id[0] == id[2]) continue;
+            dst.insert(dst.end(), id, id + 3);
+        }
+    });
+    if (cancelled()) return false;
+
+    size_t numIndices = 0;
+    for (const auto& k : kept) numIndices += k.size();
+    if (numIndices == 0) return false;
+
+    // Only cells a surviving triangle uses become vertices
+    std::vector<uint32_t> remap(numCells, std::numeric_limits<uint32_t>::max());
+    std::vector<uint32_t> indices;
+    indices.reserve(numIndices);
+    uint32_t numVerts = 0;
+    for (const auto& k : kept) {
+        for (uint32_t id : k) {
+            if (remap[id] == std::numeric_limits<uint32_t>::max()) remap[id] = numVerts++;
+            indices.push_back(remap[id]);
+        }
+    }
+    std::vector<std::vector<uint32_t>>().swap(kept);
+
+    std::vector<float> vertices(size_t(numVerts) * kFloatsPerVertex, 0.0f);
+    for (size_t s = 0; s < numShards; ++s) {
+        for (size_t i = 0; i < merged[s].cells.size(); ++i) {
+            uint32_t v = remap[shardFirst[s] + i];
+            if (v == std::numeric_limits<uint32_t>::max()) continue;
+            const double* p = merged[s].cells[i].sum;
+            float* dst = &vertices[size_t(v) * kFloatsPerVertex + 3];
+            dst[0] = float(p[0]); dst[1] = float(p[1]); dst[2] = float(p[2]);
+        }
+    }
+
+    // Smooth normals, area weighted, as weld() produces
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        const float* p0 = &vertices[size_t(indices[t])     * kFloatsPerVertex + 3];
+        const float* p1 = &vertices[size_t(indices[t + 1]) * kFloatsPerVertex + 3];
+        const float* p2 = &vertices[size_t(indices[t + 2]) * kFloatsPerVertex + 3];
+        float ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+        float vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+        float n[3] = {uy*vz - uz*vy, uz*vx - ux*vz, ux*vy - uy*vx};
+        for (int k = 0; k < 3; ++k) {
+            float* dst = &vertices[size_t(indices[t + k]) * kFloatsPerVertex];
+            dst[0] += n[0]; dst[1] += n[1]; dst[2] += n[2];
+        }
+    }
+    for (size_t v = 0; v < numVerts; ++v) {
+        float* n = &vertices[v * kFloatsPerVertex];
+        float len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if (len > 1e-20f) {
+            n[0] /= len; n[1] /= len; n[2] /= len;
+        }
+    }
+
+    out = STLModel();
+    out.filename    = source.filename;
+    out.fullpath    = source.fullpath;
+    out.bounds      = source.bounds;   // Same framing as the full mesh
+    out.glVertices  = std::move(vertices);
+    out.vertexCount = numVerts;
+    out.indices     = std::move(indices);
+    out.touch();
+    return true;
+}
+
+std::vector<std::shared_ptr<const STLModel>> buildLodChain(const STLModel& model, const LodOptions& options,
+                                                           const std::atomic<bool>* cancel) {
+    std::vector<std::shared_ptr<const STLModel>> levels;
+    const STLModel* prev = &model;
+    size_t prevTris = model.triangleCount();
+
+    // A surface keeps roughly density * r^2 triangles at grid resolution r;
+    // start from a guess and correct it from each result
+    double density = 4.0;
+    int    retries = 0;
+    while (levels.size() < options.maxLevels && prevTris > options.minTriangles) {
+        // Near the floor the target is clamped up; a level that would keep most
+        // of the previous one costs memory without making anything faster
+        double target = std::max(double(prevTris) * options.reduction, double(options.minTriangles));
+        if (target > double(prevTris) * kMaxLevelRatio) break;
+        int resolution = int(std::clamp(std::sqrt(target / density), 2.0, double(kMaxResolution)));
+
+        auto level = std::make_shared<STLModel>();
+        if (!simplifyMesh(*prev, resolution, *level, options.threads, cancel)) break;
+        size_t tris = level->triangleCount();
+        density = std::max(double(tris) / (double(resolution) * resolution), 1e-6);
+
+        // A poor guess that barely reduced: retry with the corrected density,
+        // then give up rather than keep a level that saves little
+        if (double(tris) > double(prevTris) * kMaxLevelRatio) {
+            if (retries++ < 2) continue;
+            break;
+        }
+        retries = 0;
+
+        prev = level.get();
+        prevTris = tris;
+        levels.push_back(std::move(level));
+    }
+
+    if (cancel && cancel->load()) levels.clear();
+    return levels;
+}
+
+// ── Background builder ──────────────────────────────────────────────────────
+
+LodBuilder::LodBuilder() : worker_([this] { workerLoop(); }) {}
+
+LodBuilder::~LodBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+        cancelRunning_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();
+}
+
+uint64_t LodBuilder::enqueue(std::shared_ptr<const STLModel> model, const LodOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Job job;
+    job.id      = nextId_++;
+    job.model   = std::move(model);
+    job.options = options;
+    queue_.push_back(std::move(job));
+    wake_.notify_one();
+    return queue_.back().id;
+}
+
+void LodBuilder::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ == id) cancelRunning_ = true;
+    queue_.erase(std::remove_if(queue_.begin(), queue_.end(), [&](const Job& j) { return j.id == id; }),
+                 queue_.end());
+}
+
+void LodBuilder::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) cancelRunning_ = true;
+    queue_.clear();
+}
+
+std::vector<LodResult> LodBuilder::takeFinished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<LodResult> out;
+    out.swap(finished_);
+    return out;
+}
+
+size_t LodBuilder::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + (running_ ? 1 : 0);
+}
+
+void LodBuilder::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+        if (stopping_) return;
+
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        running_ = job.id;
+        cancelRunning_ = false;
+        lock.unlock();
+
+        LodResult result;
+        result.id     = job.id;
+        result.levels = buildLodChain(*job.model, job.options, &cancelRunning_);
+        job.model.reset();
+
+        lock.lock();
+        running_ = 0;
+        if (!cancelRunning_) finished_.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,241 @@
+#include "stl_loader.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// ── Vertex welding ──────────────────────────────────────────────────────────
+// Positions are snapped to a grid of `epsilon * span` cells and hashed. To
+// parallelise without a shared map, vertices are bucketed into shards by
+// hash (a stable counting sort), so every distinct key lives in exactly one
+// shard and each thread dedups its shards with a private open-addressing
+// table. Welded vertices keep the order of their first occurrence, which
+// keeps index locality close to the original triangle order.
+
+namespace {
+
+constexpr size_t   kFloatsPerVertex = 6;               // nx,ny,nz, vx,vy,vz
+constexpr uint32_t kEmpty           = 0xFFFFFFFFu;
+constexpr size_t   kMinChunkVerts   = 256 * 1024;
+
+struct WeldKey {
+    uint32_t p[3];
+    uint32_t n[2];   // Packed 16-bit normal components (flat mode only)
+
+    bool operator==(const WeldKey& o) const {
+        return std::memcmp(this, &o, sizeof(WeldKey)) == 0;
+    }
+};
+
+struct KeyBuilder {
+    float min[3];
+    float invCell = 0.0f;   // 0 = exact (bitwise) position match
+    bool  flat    = false;
+
+    static uint32_t floatBits(float f) {
+        if (f == 0.0f) f = 0.0f;  // Fold -0 into +0
+        uint32_t u;
+        std::memcpy(&u, &f, 4);
+        return u;
+    }
+
+    static uint32_t quantizeNormal(float n) {
+        return uint32_t(int32_t(std::lround(std::clamp(n, -1.0f, 1.0f) * 32767.0f)) & 0xFFFF);
+    }
+
+    WeldKey operator()(const float* v) const {
+        WeldKey k{};
+        for (int i = 0; i < 3; ++i) {
+            float p = v[3 + i];
+            k.p[i] = invCell > 0.0f
+                ? uint32_t(std::lround(double(p - min[i]) * invCell))
+                : floatBits(p);
+        }
+        if (flat) {
+            k.n[0] = quantizeNormal(v[0]) | (quantizeNormal(v[1]) << 16);
+            k.n[1] = quantizeNormal(v[2]);
+        }
+        return k;
+    }
+};
+
+inline uint64_t hashKey(const WeldKey& k) {
+    // splitmix64-style mixing of the five words
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    const uint32_t words[5] = {k.p[0], k.p[1], k.p[2], k.n[0], k.n[1]};
+    for (uint32_t w : words) {
+        h ^= w;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    return h;
+}
+
+inline size_t nextPow2(size_t v) {
+    size_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+} // namespace
+
+void STLModel::weld(const WeldOptions& options) {
+    if (isIndexed() || vertexCount < 3) return;
+    if (vertexCount > std::numeric_limits<uint32_t>::max()) return;  // 32-bit indices
+
+    const size_t numVerts = vertexCount;
+    const float* src = glVertices.data();
+
+    KeyBuilder keyOf;
+    keyOf.min[0] = bounds.minX;
+    keyOf.min[1] = bounds.minY;
+    keyOf.min[2] = bounds.minZ;
+    keyOf.flat   = options.normals == NormalMode::Flat;
+    float cell = options.epsilon * bounds.span();
+    // Grid coordinates must fit in 32 bits; anything finer is effectively exact
+    if (cell > 0.0f && bounds.span() / cell < 2.0e9f) keyOf.invCell = 1.0f / cell;
+
+    unsigned threads = options.parallel ? Parallel::threadCount(options.threads) : 1;
+    size_t numChunks = Parallel::chunkCount(numVerts, kMinChunkVerts, threads);
+    size_t numShards = std::max<size_t>(1, numChunks * 8);
+
+    auto shardOf = [&](size_t v) {
+        return size_t(hashKey(keyOf(src + v * kFloatsPerVertex)) % numShards);
+    };
+
+    // 1. Stable counting sort of vertex ids by shard
+    std::vector<size_t> counts(numChunks * numShards, 0);
+    Parallel::forChunks(numVerts, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t c) {
+        size_t* hist = &counts[c * numShards];
+        for (size_t v = b; v < e; ++v) hist[shardOf(v)]++;
+    });
+
+    std::vector<size_t> shardStart(numShards + 1, 0);
+    std::vector<size_t> cursor(numChunks * numShards);
+    {
+        size_t offset = 0;
+        for (size_t s = 0; s < numShards; ++s) {
+            shardStart[s] = offset;
+            for (size_t c = 0; c < numChunks; ++c) {
+                cursor[c * numShards + s] = offset;
+                offset += counts[c * numShards + s];
+            }
+        }
+        shardStart[numShards] = offset;
+    }
+
+    std::vector<uint32_t> order(numVerts);
+    Parallel::forChunks(numVerts, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t c) {
+        size_t* cur = &cursor[c * numShards];
+        for (size_t v = b; v < e; ++v) order[cur[shardOf(v)]++] = uint32_t(v);
+    });
+    std::vector<size_t>().swap(cursor);
+    std::vector<size_t>().swap(counts);
+
+    // 2. Dedup each shard; rep[v] = first vertex with the same key. Ids within
+    //    a shard are ascending, so the first one seen is the lowest index.
+    std::vector<uint32_t> rep(numVerts);
+    std::vector<uint8_t>  isFirst(numVerts, 0);
+    Parallel::forChunks(numShards, 1, threads, [&](size_t sb, size_t se, size_t) {
+        std::vector<uint32_t> table;
+        for (size_t s = sb; s < se; ++s) {
+            size_t count = shardStart[s + 1] - shardStart[s];
+            if (count == 0) continue;
+            size_t mask = nextPow2(count * 2) - 1;
+            table.assign(mask + 1, kEmpty);
+
+            for (size_t i = shardStart[s]; i < shardStart[s + 1]; ++i) {
+                uint32_t v = order[i];
+                WeldKey key = keyOf(src + v * kFloatsPerVertex);
+                size_t slot = size_t(hashKey(key) >> 20) & mask;
+                for (;;) {
+                    uint32_t other = table[slot];
+                    if (other == kEmpty) {
+                        table[slot] = v;
+                        rep[v] = v;
+                        isFirst[v] = 1;
+                        break;
+                    }
+                    if (keyOf(src + other * kFloatsPerVertex) == key) {
+                        rep[v] = other;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        }
+    });
+
+    // 3. Number the unique vertices in first-occurrence order (chunked prefix sum)
+    std::vector<size_t> chunkFirsts(numChunks + 1, 0);
+    Parallel::forChunks(numVerts, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t c) {
+        size_t n = 0;
+        for (size_t v = b; v < e; ++v) n += isFirst[v];
+        chunkFirsts[c + 1] = n;
+    });
+    for (size_t c = 0; c < numChunks; ++c) chunkFirsts[c + 1] += chunkFirsts[c];
+    const size_t numUnique = chunkFirsts[numChunks];
+
+    std::vector<uint32_t> newIndices(numVerts);
+    std::vector<float>    welded(numUnique * kFloatsPerVertex, 0.0f);
+    Parallel::forChunks(numVerts, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t c) {
+        uint32_t next = uint32_t(chunkFirsts[c]);
+        for (size_t v = b; v < e; ++v) {
+            if (!isFirst[v]) continue;
+            newIndices[v] = next;
+            std::memcpy(&welded[size_t(next) * kFloatsPerVertex], src + v * kFloatsPerVertex,
+                        kFloatsPerVertex * sizeof(float));
+            ++next;
+        }
+    });
+    Parallel::forChunks(numVerts, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t) {
+        for (size_t v = b; v < e; ++v) {
+            if (!isFirst[v]) newIndices[v] = newIndices[rep[v]];
+        }
+    });
+    std::vector<uint8_t>().swap(isFirst);
+    std::vector<uint32_t>().swap(rep);
+
+    // 4. Smooth normals: accumulate area-weighted face normals. Every welded
+    //    vertex belongs to one shard, so walking shards in parallel never has
+    //    two threads adding into the same vertex.
+    if (options.normals == NormalMode::Smooth) {
+        for (size_t u = 0; u < numUnique; ++u) {
+            float* n = &welded[u * kFloatsPerVertex];
+            n[0] = n[1] = n[2] = 0.0f;
+        }
+
+        Parallel::forChunks(numShards, 1, threads, [&](size_t sb, size_t se, size_t) {
+            for (size_t i = shardStart[sb]; i < shardStart[se]; ++i) {
+                uint32_t v = order[i];
+                const float* t = src + (v / 3) * 3 * kFloatsPerVertex;
+                const float* p0 = t + 3;
+                const float* p1 = t + 3 + kFloatsPerVertex;
+                const float* p2 = t + 3 + 2 * kFloatsPerVertex;
+                float ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+                float vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+                float* n = &welded[size_t(newIndices[v]) * kFloatsPerVertex];
+                n[0] += uy*vz - uz*vy;
+                n[1] += uz*vx - ux*vz;
+                n[2] += ux*vy - uy*vx;
+            }
+        });
+
+        Parallel::forChunks(numUnique, kMinChunkVerts, threads, [&](size_t b, size_t e, size_t) {
+            for (size_t u = b; u < e; ++u) {
+                float* n = &welded[u * kFloatsPerVertex];
+                float len = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+                if (len > 1e-20f) {
+                    n[0] /= len; n[1] /= len; n[2] /= len;
+                }
+            }
+        });
+    }
+
+    glVertices  = std::move(welded);
+    vertexCount = numUnique;
+    indices     = std::move(newIndices);
+    touch();
+}
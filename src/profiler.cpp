@@ -0,0 +1,209 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+namespace Profiler {
+
+namespace {
+
+// About 6 MB of events; a long session keeps its most recent stretch
+constexpr size_t kMaxTraceEvents = 256 * 1024;
+
+// Latest times are per thread, and export runs start fresh worker threads;
+// past this the stalest entry makes room
+constexpr size_t kMaxLastTimes = 512;
+
+struct Event {
+    const char* name;
+    int64_t     startUs;
+    int64_t     durUs;
+    uint32_t    tid;
+};
+
+// Latest time of one scope name on one thread
+struct LastTime {
+    const char*       name;
+    uint32_t          tid;
+    double            ms;
+    Clock::time_point when;
+};
+
+struct State {
+    std::mutex             mutex;
+    std::vector<LastTime>  last;      // (name, thread) -> latest, first-seen order
+    std::vector<Event>     events;    // Ring of kMaxTraceEvents once full
+    size_t                 next = 0;  // Ring write position
+    std::atomic<bool>      tracing{false};
+    Clock::time_point      epoch = Clock::now();
+};
+
+State& state() {
+    static State s;
+    return s;
+}
+
+// Small stable per-thread ids read better in trace viewers than hashes
+uint32_t threadIndex() {
+    static std::atomic<uint32_t> nextId{1};
+    thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+int64_t micros(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+void writeJSONString(FILE* f, const char* s) {
+    std::fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+} // namespace
+
+Scope::~Scope() {
+    record(name_, start_, Clock::now());
+}
+
+void record(const char* name, Clock::time_point start, Clock::time_point end) {
+    State& s = state();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    bool trace = s.tracing.load(std::memory_order_relaxed);
+    uint32_t tid = threadIndex();
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.last.begin();
+    while (it != s.last.end() && (it->tid != tid || std::strcmp(it->name, name) != 0)) ++it;
+    if (it == s.last.end()) {
+        if (s.last.size() >= kMaxLastTimes) {
+            auto stalest = std::min_element(s.last.begin(), s.last.end(),
+                [](const LastTime& a, const LastTime& b) { return a.when < b.when; });
+            s.last.erase(stalest);
+        }
+        it = s.last.insert(s.last.end(), LastTime{name, tid, 0.0, end});
+    }
+    it->ms   = ms;
+    it->when = end;
+
+    if (trace) {
+        Event e{name, micros(start - s.epoch), micros(end - start), tid};
+        if (s.events.size() < kMaxTraceEvents) {
+            s.events.push_back(e);
+        } else {
+            s.events[s.next] = e;
+            s.next = (s.next + 1) % kMaxTraceEvents;
+        }
+    }
+}
+
+std::vector<StageTime> lastTimes(const std::string& group) {
+    State& s = state();
+    std::string prefix = group + ".";
+    std::vector<LastTime> times;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const auto& t : s.last) {
+            if (std::strncmp(t.name, prefix.c_str(), prefix.size()) == 0) times.push_back(t);
+        }
+    }
+
+    // The newest total on any thread is the run to show
+    const LastTime* run = nullptr;
+    for (const auto& t : times) {
+        if (std::strcmp(t.name + prefix.size(), "total") != 0) continue;
+        if (!run || t.when > run->when) run = &t;
+    }
+    Clock::time_point runStart{};
+    if (run) {
+        runStart = run->when - std::chrono::duration_cast<Clock::duration>(
+                                   std::chrono::duration<double, std::milli>(run->ms));
+    }
+    auto inRun = [&](const LastTime& t) {
+        return run && t.tid == run->tid && t.when >= runStart && t.when <= run->when;
+    };
+
+    std::vector<StageTime> out;
+    for (const auto& t : times) {
+        const char* stage = t.name + prefix.size();
+        auto it = std::find_if(out.begin(), out.end(), [&](const StageTime& o) { return o.name == stage; });
+        bool member = inRun(t);
+        if (it == out.end()) {
+            out.push_back(StageTime{stage, t.ms, t.when, run && !member});
+            continue;
+        }
+        // Prefer the run's own time, then the newest from anywhere
+        bool better = it->stale && (member || t.when > it->when);
+        if (!run) better = t.when > it->when;
+        if (better) *it = StageTime{stage, t.ms, t.when, run && !member};
+    }
+    return out;
+}
+
+void setTracing(bool enabled) {
+    state().tracing.store(enabled);
+}
+
+bool tracing() {
+    return state().tracing.load();
+}
+
+size_t traceEventCount() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.events.size();
+}
+
+void clearTrace() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.events.clear();
+    s.next = 0;
+}
+
+bool writeChromeTrace(const std::string& path) {
+    State& s = state();
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        // Oldest first: the ring's tail, then its head
+        events.assign(s.events.begin() + s.next, s.events.end());
+        events.insert(events.end(), s.events.begin(), s.events.begin() + s.next);
+    }
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Cannot write trace: " << path << std::endl;
+        return false;
+    }
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event& e = events[i];
+        const char* dot = e.name;
+        while (*dot && *dot != '.') ++dot;
+        std::string category(e.name, dot);
+
+        std::fputs(i ? ",\n{\"name\":" : "{\"name\":", f);
+        writeJSONString(f, e.name);
+        std::fputs(",\"cat\":", f);
+        writeJSONString(f, category.c_str());
+        std::fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}",
+                     e.tid, (long long)e.startUs, (long long)e.durUs);
+    }
+    std::fputs("\n]}\n", f);
+
+    bool ok = std::fclose(f) == 0;
+    if (!ok) std::cerr << "Failed to write trace: " << path << std::endl;
+    return ok;
+}
+
+} // namespace Profiler
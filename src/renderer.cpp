@@ -1,7 +1,12 @@
 #include "renderer.h"
+#include "parallel.h"
+#include "profiler.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <initializer_list>
 #include <iostream>
 #include <array>
 
@@ -11,31 +16,60 @@
 
 // ── Shader sources ──────────────────────────────────────────────────────────
 
+// Every stage is assembled from strings: the version line, the variant's
+// #defines (see compileShaders()), then the body. All matrices come from the
+// CPU; nothing per vertex depends only on uniforms.
+static const char* versionSrc = "#version 330 core\n";
+
 static const char* vertexShaderSrc = R"(
-#version 330 core
 layout(location = 0) in vec3 aNormal;
 layout(location = 1) in vec3 aPos;
 
+// uModel / uModelViewProjection include the compact format's dequantization
+uniform mat4 uModelViewProjection;
+
+#ifdef SCENE
+// Per instance: placement offset (xyz) and uniform scale (w), which leaves
+// normals' directions alone
+layout(location = 2) in vec4 aInstance;
+#endif
+
+#ifndef POSITION_ONLY
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+uniform mat3 uNormalMatrix;
 
 out vec3 FragPos;
 out vec3 Normal;
+#endif
 
 void main() {
-    vec4 worldPos = uModel * vec4(aPos, 1.0);
-    FragPos = worldPos.xyz;
-    Normal = mat3(transpose(inverse(uModel))) * aNormal;
-    gl_Position = uProjection * uView * worldPos;
+#ifdef SCENE
+    vec4 pos = vec4(aPos * aInstance.w + aInstance.xyz, 1.0);
+#else
+    vec4 pos = vec4(aPos, 1.0);
+#endif
+    gl_Position = uModelViewProjection * pos;
+#ifndef POSITION_ONLY
+    FragPos = (uModel * pos).xyz;
+    Normal = uNormalMatrix * aNormal;
+#endif
 }
 )";
 
-static const char* fragmentShaderSrc = R"(
-#version 330 core
-in vec3 FragPos;
-in vec3 Normal;
+// Flat colour for the GL_LINE wireframe overlay
+static const char* fragmentFlatSrc = R"(
+uniform vec4 uModelColor;
 
+out vec4 FragColor;
+
+void main() {
+    FragColor = uModelColor;
+}
+)";
+
+// Lit fragment shaders: this shared lighting, then a main() (solid, or
+// solid plus edges)
+static const char* shadingSrc = R"(
 uniform vec4 uModelColor;
 uniform vec3 uLightDir;
 uniform vec3 uViewPos;
@@ -46,8 +80,8 @@ uniform float uShininess;
 
 out vec4 FragColor;
 
-void main() {
-    vec3 norm = normalize(Normal);
+vec3 shade(vec3 fragPos, vec3 normal) {
+    vec3 norm = normalize(normal);
     vec3 lightDir = normalize(uLightDir);
 
     // Ambient
@@ -58,13 +92,84 @@ void main() {
     vec3 diffuse = uDiffuse * diff * uModelColor.rgb;
 
     // Specular
-    vec3 viewDir = normalize(uViewPos - FragPos);
+    vec3 viewDir = normalize(uViewPos - fragPos);
     vec3 halfDir = normalize(lightDir + viewDir);
     float spec = pow(max(abs(dot(norm, halfDir)), 0.0), uShininess);
     vec3 specular = uSpecular * spec * vec3(1.0);
 
-    vec3 result = ambient + diffuse + specular;
-    FragColor = vec4(result, uModelColor.a);
+    return ambient + diffuse + specular;
+}
+)";
+
+static const char* fragmentSolidSrc = R"(
+in vec3 FragPos;
+in vec3 Normal;
+
+void main() {
+    FragColor = vec4(shade(FragPos, Normal), uModelColor.a);
+}
+)";
+
+// Single-pass wireframe: the geometry shader gives every fragment its
+// distance in pixels to the triangle's three edges (noperspective, so it is
+// linear on screen), and fragments within half the edge width take the edge
+// colour. Adjacent triangles each draw their half of a shared edge.
+static const char* edgeGeometrySrc = R"(
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+in vec3 FragPos[];
+in vec3 Normal[];
+
+uniform vec2 uViewport;
+
+out vec3 gFragPos;
+out vec3 gNormal;
+noperspective out vec3 gEdgeDist;
+
+void main() {
+    // Corners in viewport pixels; a corner behind the eye has no meaningful
+    // projection, so that triangle gets no edges rather than garbage ones
+    vec2 p[3];
+    bool behind = false;
+    for (int i = 0; i < 3; ++i) {
+        vec4 c = gl_in[i].gl_Position;
+        behind = behind || c.w <= 0.0;
+        p[i] = 0.5 * uViewport * c.xy / max(c.w, 1e-6);
+    }
+
+    // Height of each corner over the opposite edge: 2 * area / edge length
+    vec2 e0 = p[2] - p[1], e1 = p[2] - p[0], e2 = p[1] - p[0];
+    float area2 = abs(e1.x * e2.y - e1.y * e2.x);
+    vec3 h = area2 / max(vec3(length(e0), length(e1), length(e2)), vec3(1e-6));
+    if (behind) h = vec3(1e9);
+
+    for (int i = 0; i < 3; ++i) {
+        gFragPos  = FragPos[i];
+        gNormal   = Normal[i];
+        gEdgeDist = vec3(0.0);
+        gEdgeDist[i] = h[i];
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+)";
+
+static const char* fragmentEdgeSrc = R"(
+in vec3 gFragPos;
+in vec3 gNormal;
+noperspective in vec3 gEdgeDist;
+
+uniform vec4 uEdgeColor;
+uniform float uEdgeWidth;
+
+void main() {
+    vec4 face = vec4(shade(gFragPos, gNormal), uModelColor.a);
+    float dist = min(gEdgeDist.x, min(gEdgeDist.y, gEdgeDist.z));
+    float halfWidth = 0.5 * uEdgeWidth;
+    float edge = 1.0 - smoothstep(halfWidth - 0.5, halfWidth + 0.5, dist);
+    FragColor = mix(face, uEdgeColor, edge);
 }
 )";
 
@@ -118,96 +223,224 @@ static Mat4 mat4Translate(float x, float y, float z) {
     return m;
 }
 
+static Mat4 mat4Multiply(const Mat4& a, const Mat4& b) {
+    Mat4 m{};
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            for (int k = 0; k < 4; ++k) m[c * 4 + r] += a[k * 4 + r] * b[c * 4 + k];
+    return m;
+}
+
+// Inverse transpose of m's upper 3x3 (column-major mat3) for transforming
+// normals: the cofactor matrix over the determinant
+static std::array<float, 9> mat3NormalMatrix(const Mat4& m) {
+    auto a = [&](int r, int c) { return m[c * 4 + r]; };
+    float cof[3][3] = {
+        {a(1,1)*a(2,2) - a(1,2)*a(2,1), a(1,2)*a(2,0) - a(1,0)*a(2,2), a(1,0)*a(2,1) - a(1,1)*a(2,0)},
+        {a(0,2)*a(2,1) - a(0,1)*a(2,2), a(0,0)*a(2,2) - a(0,2)*a(2,0), a(0,1)*a(2,0) - a(0,0)*a(2,1)},
+        {a(0,1)*a(1,2) - a(0,2)*a(1,1), a(0,2)*a(1,0) - a(0,0)*a(1,2), a(0,0)*a(1,1) - a(0,1)*a(1,0)},
+    };
+    float det = a(0,0) * cof[0][0] + a(0,1) * cof[0][1] + a(0,2) * cof[0][2];
+    float inv = std::fabs(det) > 1e-30f ? 1.0f / det : 1.0f;
+
+    std::array<float, 9> n;
+    for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r) n[c * 3 + r] = cof[r][c] * inv;
+    return n;
+}
+
+// Camera position from spherical coordinates, looking at the origin
+static std::array<float, 3> cameraEye(const RenderSettings& s) {
+    float elevRad = s.elevation * (float)M_PI / 180.0f;
+    float azimRad = s.azimuth   * (float)M_PI / 180.0f;
+    return {s.distance * std::cos(elevRad) * std::sin(azimRad),
+            s.distance * std::sin(elevRad),
+            s.distance * std::cos(elevRad) * std::cos(azimRad)};
+}
+
+// The mat4LookAt() basis for that camera: side, up, forward
+static void cameraBasis(const std::array<float, 3>& eye, float side[3], float up[3], float fwd[3]) {
+    float len = std::sqrt(eye[0]*eye[0] + eye[1]*eye[1] + eye[2]*eye[2]);
+    for (int i = 0; i < 3; ++i) fwd[i] = -eye[i] / len;
+    side[0] = -fwd[2]; side[1] = 0.0f; side[2] = fwd[0];   // fwd x (0, 1, 0)
+    float slen = std::sqrt(side[0]*side[0] + side[2]*side[2]);
+    side[0] /= slen; side[2] /= slen;
+    up[0] = side[1]*fwd[2] - side[2]*fwd[1];
+    up[1] = side[2]*fwd[0] - side[0]*fwd[2];
+    up[2] = side[0]*fwd[1] - side[1]*fwd[0];
+}
+
 // ── Renderer implementation ─────────────────────────────────────────────────
 
 bool Renderer::init() {
-    if (!compileShaders()) return false;
-    setupBuffers();
-    return true;
+    GLint maxTexture = 0, maxRenderbuffer = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexture);
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+    maxTargetSize = std::min(maxTexture, maxRenderbuffer);
+    // baseInstance in indirect commands needs base_instance semantics too
+    multiDrawIndirect = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+    return compileShaders();
 }
 
 void Renderer::shutdown() {
-    if (vao) glDeleteVertexArrays(1, &vao);
-    if (vbo) glDeleteBuffers(1, &vbo);
+    evictAll();
     if (fbo) glDeleteFramebuffers(1, &fbo);
     if (rbo) glDeleteRenderbuffers(1, &rbo);
     if (fboTex) glDeleteTextures(1, &fboTex);
-    if (shaderProgram) glDeleteProgram(shaderProgram);
+    fbo = rbo = fboTex = 0;
+    fboWidth = fboHeight = 0;
+    if (viewFbo) glDeleteFramebuffers(1, &viewFbo);
+    if (viewDepth) glDeleteRenderbuffers(1, &viewDepth);
+    if (viewColor) glDeleteTextures(1, &viewColor);
+    viewFbo = viewDepth = viewColor = 0;
+    viewWidth = viewHeight = 0;
+    if (gpuQueries[0][0]) glDeleteQueries(kGpuFrames * kGpuPasses, &gpuQueries[0][0]);
+    std::memset(gpuQueries, 0, sizeof(gpuQueries));
+    gpuTiming = false;
+    clearScene();
+    for (ShaderSet* set : {&meshShaders, &sceneShaders}) {
+        for (Shader* shader : {&set->solid, &set->edge, &set->line}) {
+            if (shader->program) glDeleteProgram(shader->program);
+        }
+        *set = ShaderSet{};
+    }
 }
 
-bool Renderer::compileShaders() {
-    auto compile = [](GLenum type, const char* src) -> GLuint {
-        GLuint s = glCreateShader(type);
-        glShaderSource(s, 1, &src, nullptr);
-        glCompileShader(s);
+static GLuint compileShader(GLenum type, std::initializer_list<const char*> sources) {
+    std::vector<const char*> parts(sources);
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, (GLsizei)parts.size(), parts.data(), nullptr);
+    glCompileShader(s);
+    GLint ok;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetShaderInfoLog(s, 512, nullptr, log);
+        std::cerr << "Shader compile error: " << log << std::endl;
+        glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+// Links and deletes `shaders`; 0 if any failed to compile or the link fails
+static GLuint linkProgram(std::initializer_list<GLuint> shaders) {
+    bool compiled = true;
+    for (GLuint s : shaders) compiled = compiled && s != 0;
+
+    GLuint program = 0;
+    if (compiled) {
+        program = glCreateProgram();
+        for (GLuint s : shaders) glAttachShader(program, s);
+        glLinkProgram(program);
+
         GLint ok;
-        glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
         if (!ok) {
             char log[512];
-            glGetShaderInfoLog(s, 512, nullptr, log);
-            std::cerr << "Shader compile error: " << log << std::endl;
-            glDeleteShader(s);
-            return 0;
+            glGetProgramInfoLog(program, 512, nullptr, log);
+            std::cerr << "Program link error: " << log << std::endl;
+            glDeleteProgram(program);
+            program = 0;
         }
-        return s;
-    };
+    }
+    for (GLuint s : shaders) {
+        if (s) glDeleteShader(s);
+    }
+    return program;
+}
 
-    GLuint vs = compile(GL_VERTEX_SHADER, vertexShaderSrc);
-    GLuint fs = compile(GL_FRAGMENT_SHADER, fragmentShaderSrc);
-    if (!vs || !fs) return false;
+void Renderer::Shader::cacheUniforms() {
+    uModel      = glGetUniformLocation(program, "uModel");
+    uMVP        = glGetUniformLocation(program, "uModelViewProjection");
+    uNormalMat  = glGetUniformLocation(program, "uNormalMatrix");
+    uModelColor = glGetUniformLocation(program, "uModelColor");
+    uLightDir   = glGetUniformLocation(program, "uLightDir");
+    uViewPos    = glGetUniformLocation(program, "uViewPos");
+    uAmbient    = glGetUniformLocation(program, "uAmbient");
+    uDiffuse    = glGetUniformLocation(program, "uDiffuse");
+    uSpecular   = glGetUniformLocation(program, "uSpecular");
+    uShininess  = glGetUniformLocation(program, "uShininess");
+    uViewport   = glGetUniformLocation(program, "uViewport");
+    uEdgeColor  = glGetUniformLocation(program, "uEdgeColor");
+    uEdgeWidth  = glGetUniformLocation(program, "uEdgeWidth");
+}
 
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vs);
-    glAttachShader(shaderProgram, fs);
-    glLinkProgram(shaderProgram);
+// Variants, specialized at compile time:
+//   solid  lit faces
+//   edge   lit faces plus single-pass wireframe (adds the geometry shader)
+//   line   position-only vertex shader and a flat colour, for the GL_LINE overlay
+// each built once per mesh and once instanced (SCENE) for scene mode
+bool Renderer::buildShaderSet(ShaderSet& set, const char* defines) {
+    set.solid.program = linkProgram({
+        compileShader(GL_VERTEX_SHADER, {versionSrc, defines, vertexShaderSrc}),
+        compileShader(GL_FRAGMENT_SHADER, {versionSrc, shadingSrc, fragmentSolidSrc}),
+    });
+    set.line.program = linkProgram({
+        compileShader(GL_VERTEX_SHADER, {versionSrc, defines, "#define POSITION_ONLY\n", vertexShaderSrc}),
+        compileShader(GL_FRAGMENT_SHADER, {versionSrc, fragmentFlatSrc}),
+    });
+    if (!set.solid.program || !set.line.program) return false;
+    set.solid.cacheUniforms();
+    set.line.cacheUniforms();
+
+    // Without it, wireframe falls back to the two-pass line overlay
+    set.edge.program = linkProgram({
+        compileShader(GL_VERTEX_SHADER, {versionSrc, defines, vertexShaderSrc}),
+        compileShader(GL_GEOMETRY_SHADER, {versionSrc, edgeGeometrySrc}),
+        compileShader(GL_FRAGMENT_SHADER, {versionSrc, shadingSrc, fragmentEdgeSrc}),
+    });
+    if (set.edge.program) set.edge.cacheUniforms();
+    else std::cerr << "Single-pass wireframe unavailable; using line overlay" << std::endl;
+    return true;
+}
 
-    GLint ok;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        char log[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, log);
-        std::cerr << "Program link error: " << log << std::endl;
-        return false;
-    }
+bool Renderer::compileShaders() {
+    return buildShaderSet(meshShaders, "") && buildShaderSet(sceneShaders, "#define SCENE\n");
+}
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+// ── Compact vertex packing ──────────────────────────────────────────────────
+// 12 bytes per vertex instead of 24: the normal as GL_INT_2_10_10_10_REV and
+// the position as 3 x 16-bit unorm relative to the model's bounding box.
 
-    // Cache uniform locations
-    uModel      = glGetUniformLocation(shaderProgram, "uModel");
-    uView       = glGetUniformLocation(shaderProgram, "uView");
-    uProjection = glGetUniformLocation(shaderProgram, "uProjection");
-    uModelColor = glGetUniformLocation(shaderProgram, "uModelColor");
-    uLightDir   = glGetUniformLocation(shaderProgram, "uLightDir");
-    uViewPos    = glGetUniformLocation(shaderProgram, "uViewPos");
-    uAmbient    = glGetUniformLocation(shaderProgram, "uAmbient");
-    uDiffuse    = glGetUniformLocation(shaderProgram, "uDiffuse");
-    uSpecular   = glGetUniformLocation(shaderProgram, "uSpecular");
-    uShininess  = glGetUniformLocation(shaderProgram, "uShininess");
+struct CompactVertex {
+    uint32_t normal;    // x:10 y:10 z:10 w:2, signed normalized
+    uint16_t pos[3];    // unorm, (p - min) / extent
+    uint16_t pad;
+};
+static_assert(sizeof(CompactVertex) == 12, "CompactVertex must be tightly packed");
 
-    return true;
+static uint32_t packSnorm10(float v) {
+    int i = (int)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 511.0f);
+    return (uint32_t)i & 0x3FFu;
 }
 
-void Renderer::setupBuffers() {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
+static uint16_t packUnorm16(float v) {
+    return (uint16_t)std::lround(std::max(0.0f, std::min(1.0f, v)) * 65535.0f);
 }
 
-void Renderer::uploadModel(const STLModel& model) {
-    currentVertexCount = model.vertexCount;
-    modelCenterX = model.bounds.centerX();
-    modelCenterY = model.bounds.centerY();
-    modelCenterZ = model.bounds.centerZ();
-    modelSpan    = model.bounds.span();
-    if (modelSpan < 1e-6f) modelSpan = 1.0f;
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 model.glVertices.size() * sizeof(float),
-                 model.glVertices.data(),
-                 GL_STATIC_DRAW);
+static std::vector<CompactVertex> packCompact(const STLModel& model) {
+    const BoundingBox& b = model.bounds;
+    const float minV[3] = {b.minX, b.minY, b.minZ};
+    const float ext[3]  = {b.maxX - b.minX, b.maxY - b.minY, b.maxZ - b.minZ};
+    float inv[3];
+    for (int i = 0; i < 3; ++i) inv[i] = ext[i] > 0.0f ? 1.0f / ext[i] : 0.0f;
+
+    std::vector<CompactVertex> out(model.vertexCount);
+    Parallel::forChunks(model.vertexCount, 256 * 1024, 0, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            const float* v = &model.glVertices[i * 6];
+            CompactVertex& c = out[i];
+            c.normal = packSnorm10(v[0]) | (packSnorm10(v[1]) << 10) | (packSnorm10(v[2]) << 20);
+            for (int k = 0; k < 3; ++k) c.pos[k] = packUnorm16((v[3 + k] - minV[k]) * inv[k]);
+            c.pad = 0;
+        }
+    });
+    return out;
+}
 
+// Interleaved float normal + position layout for the bound VAO and VBO
+static void setFloatAttributes() {
     // Normal attribute (location 0): offset 0, stride 24 bytes
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -215,138 +448,1307 @@ void Renderer::uploadModel(const STLModel& model) {
     // Position attribute (location 1): offset 12, stride 24 bytes
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
+}
+
+void Renderer::setVertexFormat(VertexFormat format) {
+    vertexFormat = format;
+}
+
+// ── GPU residency cache ─────────────────────────────────────────────────────
+
+MeshHandle Renderer::uploadModel(const STLModel& model) {
+    MeshHandle handle = acquire(model);
+    if (handle != currentMesh) generation++;
+    currentMesh = handle;
+    return currentMesh;
+}
+
+bool Renderer::select(MeshHandle handle) {
+    auto it = meshes.find(handle);
+    if (it == meshes.end()) {
+        if (currentMesh) generation++;
+        currentMesh = 0;
+        return false;
+    }
+    it->second.lastUse = ++useCounter;
+    if (handle != currentMesh) generation++;
+    currentMesh = handle;
+    return true;
+}
+
+MeshHandle Renderer::acquire(const STLModel& model) {
+    MeshHandle handle = model.revision;
+    if (handle == 0 || model.vertexCount == 0) return 0;
+
+    auto it = meshes.find(handle);
+    if (it == meshes.end() || it->second.format != vertexFormat) {
+        GpuMesh& mesh = meshes[handle];
+        residentTotal -= mesh.bytes;
+        uploadMesh(model, mesh);
+        residentTotal += mesh.bytes;
+        if (handle == currentMesh) generation++;   // Re-uploaded, e.g. in another format
+        it = meshes.find(handle);
+    }
+    it->second.lastUse = ++useCounter;
+    enforceBudget(handle);
+    return handle;
+}
+
+void Renderer::evict(MeshHandle handle) {
+    auto it = meshes.find(handle);
+    if (it == meshes.end()) return;
+    std::vector<MeshHandle> lods = std::move(it->second.lods);
+    residentTotal -= it->second.bytes;
+    releaseMesh(it->second);
+    meshes.erase(it);
+    generation++;
+    if (currentMesh == handle) currentMesh = 0;
+    for (MeshHandle lod : lods) evict(lod);
+}
+
+void Renderer::evictAll() {
+    for (auto& [handle, mesh] : meshes) releaseMesh(mesh);
+    meshes.clear();
+    residentTotal = 0;
+    currentMesh = 0;
+    generation++;
+}
 
+void Renderer::setVramBudget(size_t bytes) {
+    vramBudget = bytes;
+    enforceBudget(currentMesh);
+}
+
+void Renderer::enforceBudget(MeshHandle keep) {
+    // The current mesh's levels are part of what's on screen
+    auto current = meshes.find(currentMesh);
+    auto onScreen = [&](MeshHandle h) {
+        if (h == keep || h == currentMesh) return true;
+        if (current == meshes.end()) return false;
+        const auto& lods = current->second.lods;
+        return std::find(lods.begin(), lods.end(), h) != lods.end();
+    };
+
+    while (residentTotal > vramBudget && meshes.size() > 1) {
+        auto victim = meshes.end();
+        for (auto it = meshes.begin(); it != meshes.end(); ++it) {
+            if (onScreen(it->first)) continue;
+            if (victim == meshes.end() || it->second.lastUse < victim->second.lastUse) victim = it;
+        }
+        if (victim == meshes.end()) break;
+        evict(victim->first);
+        current = meshes.find(currentMesh);
+    }
+}
+
+// ── Streaming upload ────────────────────────────────────────────────────────
+
+// Streamed meshes have no STLModel revision; this bit keeps their handles
+// apart from revisions (a process-wide counter starting at 1)
+static constexpr MeshHandle kStreamHandleBit = MeshHandle(1) << 63;
+static constexpr size_t     kStreamBytesPerTriangle = 18 * sizeof(float);
+
+MeshHandle Renderer::beginStream(LoadStream& stream) {
+    size_t triangles = stream.triangles();
+    if (triangles == 0) return 0;
+
+    MeshHandle handle = kStreamHandleBit | ++streamCounter;
+    GpuMesh& mesh = meshes[handle];
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+
+    mesh.vertexCount = triangles * 3;
+    mesh.format      = VertexFormat::Float;
+    mesh.streaming   = true;
+    mesh.bytes       = triangles * kStreamBytesPerTriangle;
+    setFraming(mesh, stream.bounds());
+
+    // Allocated at the final size up front; runs land with glBufferSubData
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.bytes, nullptr, GL_STATIC_DRAW);
+    setFloatAttributes();
     glBindVertexArray(0);
+
+    residentTotal += mesh.bytes;
+    mesh.lastUse = ++useCounter;
+    enforceBudget(handle);
+    updateStream(handle, stream);
+    return handle;
 }
 
-void Renderer::setUniforms(const RenderSettings& s, int vpWidth, int vpHeight) {
-    glUseProgram(shaderProgram);
+bool Renderer::updateStream(MeshHandle handle, LoadStream& stream) {
+    auto it = meshes.find(handle);
+    if (it == meshes.end() || !it->second.streaming) return false;
+    GpuMesh& mesh = it->second;
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    stream.drain([&](const float* vertices, const LoadStream::Range& r) {
+        if (r.first + r.count > mesh.vertexCount / 3) return;
+        generation++;
+        glBufferSubData(GL_ARRAY_BUFFER, r.first * kStreamBytesPerTriangle, r.count * kStreamBytesPerTriangle,
+                        vertices + r.first * 18);
+
+        // Insert the vertex range in order, merging with touching neighbours
+        GLint   first = GLint(r.first * 3);
+        GLsizei count = GLsizei(r.count * 3);
+        auto& firsts = mesh.streamFirsts;
+        auto& counts = mesh.streamCounts;
+        size_t i = std::lower_bound(firsts.begin(), firsts.end(), first) - firsts.begin();
+        if (i > 0 && firsts[i - 1] + counts[i - 1] == first) {
+            counts[i - 1] += count;
+        } else {
+            firsts.insert(firsts.begin() + i, first);
+            counts.insert(counts.begin() + i, count);
+            i++;
+        }
+        if (i < firsts.size() && firsts[i - 1] + counts[i - 1] == firsts[i]) {
+            counts[i - 1] += counts[i];
+            firsts.erase(firsts.begin() + i);
+            counts.erase(counts.begin() + i);
+        }
+        mesh.streamedVertices += size_t(count);
+    });
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    setFraming(mesh, stream.bounds());
+    return true;
+}
+
+size_t Renderer::streamedTriangles(MeshHandle handle) const {
+    auto it = meshes.find(handle);
+    if (it == meshes.end()) return 0;
+    return it->second.streaming ? it->second.streamedVertices / 3 : it->second.vertexCount / 3;
+}
+
+size_t Renderer::meshBytes(MeshHandle handle) const {
+    auto it = meshes.find(handle);
+    if (it == meshes.end()) return 0;
+    size_t bytes = it->second.bytes;
+    for (MeshHandle lod : it->second.lods) {
+        auto l = meshes.find(lod);
+        if (l != meshes.end()) bytes += l->second.bytes;
+    }
+    return bytes;
+}
+
+// ── Level of detail ─────────────────────────────────────────────────────────
+
+void Renderer::attachLods(MeshHandle base, const std::vector<std::shared_ptr<const STLModel>>& levels) {
+    if (!meshes.count(base)) return;
+
+    std::vector<MeshHandle> handles;
+    for (const auto& level : levels) {
+        if (!level) continue;
+        if (MeshHandle h = acquire(*level)) handles.push_back(h);
+    }
+
+    // Making room for the levels may have evicted `base` itself
+    auto it = meshes.find(base);
+    if (it == meshes.end()) {
+        for (MeshHandle h : handles) evict(h);
+        return;
+    }
+    it->second.lods = std::move(handles);
+    generation++;
+}
+
+MeshHandle Renderer::pickLod(MeshHandle base, const RenderSettings& s, int vpWidth, int vpHeight) {
+    drawnLod = 0;
+    auto it = meshes.find(base);
+    if (!lodEnabled || it == meshes.end() || it->second.lods.empty() || vpWidth <= 0 || vpHeight <= 0) {
+        return base;
+    }
+
+    // The model is scaled to a span of 2, so it covers about a unit-radius
+    // disc: that many pixels at this distance and field of view
+    float tanHalf = std::tan(s.fov * (float)M_PI / 360.0f);
+    float radius  = 0.5f * vpHeight / (std::max(s.distance, 0.01f) * tanHalf);
+    double pixels = std::min(double(M_PI) * radius * radius, double(vpWidth) * vpHeight);
+    size_t budget = size_t(pixels * lodTrianglesPerPixel);
+    if (interactive) budget = std::min(budget, interactiveTriangles);
+
+    auto triangles = [](const GpuMesh& m) { return m.indexCount > 0 ? m.indexCount / 3 : m.vertexCount / 3; };
+    MeshHandle chosen = base;
+    size_t chosenTris = triangles(it->second);
+    const std::vector<MeshHandle>& lods = it->second.lods;
+    for (size_t i = 0; i < lods.size() && chosenTris > budget; ++i) {
+        auto lod = meshes.find(lods[i]);
+        if (lod == meshes.end()) continue;   // Evicted; try the next coarser
+        chosen     = lods[i];
+        chosenTris = triangles(lod->second);
+        drawnLod   = int(i) + 1;
+    }
+    return chosen;
+}
+
+void Renderer::releaseMesh(GpuMesh& mesh) {
+    if (mesh.vao) glDeleteVertexArrays(1, &mesh.vao);
+    if (mesh.vbo) glDeleteBuffers(1, &mesh.vbo);
+    if (mesh.ebo) glDeleteBuffers(1, &mesh.ebo);
+    mesh.vao = mesh.vbo = mesh.ebo = 0;
+    mesh.bytes = 0;
+    mesh.bvh.reset();
+}
+
+void Renderer::setFraming(GpuMesh& mesh, const BoundingBox& bounds) {
+    mesh.centerX = bounds.centerX();
+    mesh.centerY = bounds.centerY();
+    mesh.centerZ = bounds.centerZ();
+    mesh.span    = bounds.span();
+    if (mesh.span < 1e-6f) mesh.span = 1.0f;
+}
+
+void Renderer::uploadMesh(const STLModel& model, GpuMesh& mesh) {
+    PROFILE_SCOPE("render.upload");
+    if (!mesh.vao) {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &mesh.vbo);
+        glGenBuffers(1, &mesh.ebo);
+    }
+
+    mesh.vertexCount = model.vertexCount;
+    mesh.indexCount  = model.indices.size();
+    mesh.format      = vertexFormat;
+    mesh.bvh         = model.bvh;
+    setFraming(mesh, model.bounds);
+
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+
+    size_t vertexBytes;
+    if (mesh.format == VertexFormat::Compact) {
+        std::vector<CompactVertex> packed = packCompact(model);
+        vertexBytes = packed.size() * sizeof(CompactVertex);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, packed.data(), GL_STATIC_DRAW);
+
+        // Normal attribute (location 0): offset 0, stride 12 bytes
+        glVertexAttribPointer(0, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        // Position attribute (location 1): offset 4, stride 12 bytes
+        glVertexAttribPointer(1, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)4);
+        glEnableVertexAttribArray(1);
+
+        mesh.posOffset = {model.bounds.minX, model.bounds.minY, model.bounds.minZ};
+        mesh.posScale  = {model.bounds.maxX - model.bounds.minX,
+                          model.bounds.maxY - model.bounds.minY,
+                          model.bounds.maxZ - model.bounds.minZ};
+    } else {
+        vertexBytes = model.glVertices.size() * sizeof(float);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, model.glVertices.data(), GL_STATIC_DRAW);
+        setFloatAttributes();
+        mesh.posOffset = {0.0f, 0.0f, 0.0f};
+        mesh.posScale  = {1.0f, 1.0f, 1.0f};
+    }
+
+    // Welded models share vertices through a 32-bit index buffer (bound into the VAO)
+    size_t indexBytes = model.indices.size() * sizeof(uint32_t);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes,
+                 model.indices.empty() ? nullptr : model.indices.data(),
+                 GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    mesh.bytes = vertexBytes + indexBytes;
+}
+
+void Renderer::drawMesh(const GpuMesh& mesh, bool culled) {
+    if (mesh.streaming) {
+        if (!mesh.streamCounts.empty()) {
+            glMultiDrawArrays(GL_TRIANGLES, mesh.streamFirsts.data(), mesh.streamCounts.data(),
+                              (GLsizei)mesh.streamCounts.size());
+        }
+    } else if (culled) {
+        if (drawCounts.empty()) return;
+        if (mesh.indexCount > 0) {
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT,
+                                drawOffsets.data(), (GLsizei)drawCounts.size());
+        } else {
+            glMultiDrawArrays(GL_TRIANGLES, drawFirsts.data(), drawCounts.data(),
+                              (GLsizei)drawCounts.size());
+        }
+    } else if (mesh.indexCount > 0) {
+        glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indexCount, GL_UNSIGNED_INT, (void*)0);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mesh.vertexCount);
+    }
+}
+
+// ── Frustum culling ─────────────────────────────────────────────────────────
+// The six planes come straight out of the clip matrix (Gribb & Hartmann), in
+// the mesh's own coordinates, so BVH boxes are tested without transforming
+// them. Nodes outside are skipped; nodes fully inside, or small enough that
+// testing further costs more than drawing, are emitted whole. The tree keeps
+// each subtree's triangles contiguous and is walked left to right, so
+// neighbouring ranges merge and a typical view is a handful of draws.
+
+namespace {
+
+constexpr uint32_t kCullMinTriangles = 2048;   // Don't descend below this
+
+enum class Coverage { Outside, Partial, Inside };
+
+Coverage classifyBox(const float planes[6][4], const BVHNode& n) {
+    Coverage result = Coverage::Inside;
+    for (int i = 0; i < 6; ++i) {
+        const float* p = planes[i];
+        // Box corners furthest along / against the plane normal
+        float far = p[3], near = p[3];
+        for (int a = 0; a < 3; ++a) {
+            far  += p[a] * (p[a] >= 0.0f ? n.max[a] : n.min[a]);
+            near += p[a] * (p[a] >= 0.0f ? n.min[a] : n.max[a]);
+        }
+        if (far < 0.0f) return Coverage::Outside;
+        if (near < 0.0f) result = Coverage::Partial;
+    }
+    return result;
+}
+
+} // namespace
+
+bool Renderer::cullMesh(const GpuMesh& mesh) {
+    PROFILE_SCOPE("render.cull");
+    drawFirsts.clear();
+    drawCounts.clear();
+    drawOffsets.clear();
+    totalTriangles = mesh.indexCount > 0 ? mesh.indexCount / 3 : mesh.vertexCount / 3;
+    drawnTriangles = mesh.streaming ? mesh.streamedVertices / 3 : totalTriangles;
+    if (!mesh.bvh || mesh.bvh->nodes.empty()) return false;
+
+    // Rows of the clip matrix (column-major): planes are row3 +/- row0..2
+    const Mat4& m = clipMatrix;
+    float planes[6][4];
+    for (int i = 0; i < 3; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            planes[i * 2][c]     = m[c * 4 + 3] + m[c * 4 + i];
+            planes[i * 2 + 1][c] = m[c * 4 + 3] - m[c * 4 + i];
+        }
+    }
+
+    const auto& nodes = mesh.bvh->nodes;
+    if (classifyBox(planes, nodes[0]) == Coverage::Inside) return false;
+
+    const bool indexed = mesh.indexCount > 0;
+    uint32_t lastEnd = 0;   // End of the previous range, to merge into it
+    drawnTriangles = 0;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode& n = nodes[stack[--top]];
+        Coverage coverage = classifyBox(planes, n);
+        if (coverage == Coverage::Outside) continue;
+        if (coverage == Coverage::Partial && !n.isLeaf() && n.count > kCullMinTriangles && top + 2 <= 64) {
+            stack[top++] = n.right;   // Left child first: ranges stay ascending
+            stack[top++] = n.left;
+            continue;
+        }
+
+        drawnTriangles += n.count;
+        if (!drawCounts.empty() && lastEnd == n.first) {
+            drawCounts.back() += GLsizei(n.count) * 3;
+        } else {
+            drawCounts.push_back(GLsizei(n.count) * 3);
+            if (indexed) drawOffsets.push_back((const void*)(size_t(n.first) * 3 * sizeof(uint32_t)));
+            else         drawFirsts.push_back(GLint(n.first) * 3);
+        }
+        lastEnd = n.first + n.count;
+    }
+    return true;
+}
+
+void Renderer::setUniforms(const Shader& shader, const GpuMesh& mesh, const RenderSettings& s,
+                           int vpWidth, int vpHeight, const ClipTransform& clip) {
+    glUseProgram(shader.program);
 
     // Model matrix: center the model at origin, scale to unit size
-    float scale = 2.0f / modelSpan;
+    float scale = 2.0f / mesh.span;
     Mat4 model = mat4Identity();
     model[0] = model[5] = model[10] = scale;
-    model[12] = -modelCenterX * scale;
-    model[13] = -modelCenterY * scale;
-    model[14] = -modelCenterZ * scale;
-
-    // Camera position from spherical coordinates
-    float elevRad = s.elevation * (float)M_PI / 180.0f;
-    float azimRad = s.azimuth   * (float)M_PI / 180.0f;
-    float eyeX = s.distance * std::cos(elevRad) * std::sin(azimRad);
-    float eyeY = s.distance * std::sin(elevRad);
-    float eyeZ = s.distance * std::cos(elevRad) * std::cos(azimRad);
+    model[12] = -mesh.centerX * scale;
+    model[13] = -mesh.centerY * scale;
+    model[14] = -mesh.centerZ * scale;
 
+    auto [eyeX, eyeY, eyeZ] = cameraEye(s);
     Mat4 view = mat4LookAt(eyeX, eyeY, eyeZ, 0, 0, 0, 0, 1, 0);
 
-    float aspect = (float)vpWidth / (float)vpHeight;
+    float aspect = clip.aspect > 0.0f ? clip.aspect : (float)vpWidth / (float)vpHeight;
     Mat4 proj = mat4Perspective(s.fov, aspect, 0.01f, 100.0f);
+    for (int c = 0; c < 4; ++c) {
+        // Negate clip-space Y so framebuffer row 0 is the top of the image,
+        // then zoom into the tile: x' = sx * x + ox * w (rows 0/1 += row 3)
+        float* col = &proj[c * 4];
+        if (clip.flipY) col[1] = -col[1];
+        col[0] = clip.scaleX * col[0] + clip.offsetX * col[3];
+        col[1] = clip.scaleY * col[1] + clip.offsetY * col[3];
+    }
 
-    glUniformMatrix4fv(uModel, 1, GL_FALSE, model.data());
-    glUniformMatrix4fv(uView, 1, GL_FALSE, view.data());
-    glUniformMatrix4fv(uProjection, 1, GL_FALSE, proj.data());
+    clipMatrix = mat4Multiply(proj, mat4Multiply(view, model));
 
-    glUniform4fv(uModelColor, 1, s.modelColor);
-    glUniform3fv(uLightDir, 1, s.lightDir);
-    glUniform3f(uViewPos, eyeX, eyeY, eyeZ);
-    glUniform1f(uAmbient, s.ambientStr);
-    glUniform1f(uDiffuse, s.diffuseStr);
-    glUniform1f(uSpecular, s.specularStr);
-    glUniform1f(uShininess, s.shininess);
+    // Compact positions are unorm offsets into the bounds; that scale and
+    // offset go into the matrices instead of every vertex (identity for Float)
+    Mat4 dequant = mat4Identity();
+    for (int i = 0; i < 3; ++i) {
+        dequant[i * 5]  = mesh.posScale[i];
+        dequant[12 + i] = mesh.posOffset[i];
+    }
+    Mat4 vertexModel = mat4Multiply(model, dequant);
+    Mat4 mvp         = mat4Multiply(clipMatrix, dequant);
+    std::array<float, 9> normalMatrix = mat3NormalMatrix(model);
+
+    glUniformMatrix4fv(shader.uModel, 1, GL_FALSE, vertexModel.data());
+    glUniformMatrix4fv(shader.uMVP, 1, GL_FALSE, mvp.data());
+    glUniformMatrix3fv(shader.uNormalMat, 1, GL_FALSE, normalMatrix.data());
+
+    glUniform4fv(shader.uModelColor, 1, s.modelColor);
+    glUniform3fv(shader.uLightDir, 1, s.lightDir);
+    glUniform3f(shader.uViewPos, eyeX, eyeY, eyeZ);
+    glUniform1f(shader.uAmbient, s.ambientStr);
+    glUniform1f(shader.uDiffuse, s.diffuseStr);
+    glUniform1f(shader.uSpecular, s.specularStr);
+    glUniform1f(shader.uShininess, s.shininess);
+
+    // Edge widths are in pixels of this viewport, so tiles and sheets of an
+    // export draw the same width as the window
+    if (shader.uViewport >= 0) glUniform2f(shader.uViewport, (float)vpWidth, (float)vpHeight);
+    if (shader.uEdgeColor >= 0) glUniform4fv(shader.uEdgeColor, 1, s.edgeColor);
+    if (shader.uEdgeWidth >= 0) glUniform1f(shader.uEdgeWidth, s.edgeWidth);
 }
 
 void Renderer::render(const RenderSettings& s, int vpWidth, int vpHeight) {
-    glViewport(0, 0, vpWidth, vpHeight);
+    render(currentMesh, s, vpWidth, vpHeight);
+}
+
+void Renderer::render(MeshHandle handle, const RenderSettings& s, int vpWidth, int vpHeight) {
+    PROFILE_SCOPE("render.draw");
+    startGpuFrame();
+    renderMesh(pickLod(handle, s, vpWidth, vpHeight), s, 0, 0, vpWidth, vpHeight, ClipTransform{});
+    finishGpuFrame();
+}
+
+// ── Cached viewport ─────────────────────────────────────────────────────────
+
+bool sameView(const RenderSettings& a, const RenderSettings& b) {
+    auto same = [](const float* x, const float* y, int n) { return std::equal(x, x + n, y); };
+    return a.elevation == b.elevation && a.azimuth == b.azimuth && a.distance == b.distance &&
+           a.fov == b.fov && same(a.modelColor, b.modelColor, 4) && same(a.bgColor, b.bgColor, 4) &&
+           same(a.edgeColor, b.edgeColor, 4) && same(a.lightDir, b.lightDir, 3) &&
+           a.ambientStr == b.ambientStr && a.diffuseStr == b.diffuseStr && a.specularStr == b.specularStr &&
+           a.shininess == b.shininess && a.wireframe == b.wireframe && a.edgeWidth == b.edgeWidth &&
+           a.lineWireframe == b.lineWireframe;
+}
+
+bool Renderer::drawViewport(const RenderSettings& s, int width, int height, bool scene, bool redraw) {
+    if (width <= 0 || height <= 0) return false;
+
+    if (!viewFbo || width != viewWidth || height != viewHeight) {
+        if (!viewFbo) {
+            glGenFramebuffers(1, &viewFbo);
+            glGenTextures(1, &viewColor);
+            glGenRenderbuffers(1, &viewDepth);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, viewFbo);
+        glBindTexture(GL_TEXTURE_2D, viewColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, viewColor, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, viewDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, viewDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            // No cache: draw straight to the window every time
+            std::cerr << "Viewport framebuffer not complete; drawing uncached" << std::endl;
+            glDeleteFramebuffers(1, &viewFbo);
+            glDeleteRenderbuffers(1, &viewDepth);
+            glDeleteTextures(1, &viewColor);
+            viewFbo = viewDepth = viewColor = 0;
+            viewWidth = viewHeight = 0;
+            PROFILE_SCOPE("render.total");
+            if (scene) renderScene(s, width, height);
+            else       render(s, width, height);
+            return true;
+        }
+        viewWidth  = width;
+        viewHeight = height;
+        redraw     = true;
+    }
+
+    if (redraw) {
+        PROFILE_SCOPE("render.total");   // One viewport redraw is the group's run
+        // The whole image, whatever the window's scissor
+        GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, viewFbo);
+        glClearColor(s.bgColor[0], s.bgColor[1], s.bgColor[2], s.bgColor[3]);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (scene) renderScene(s, width, height);
+        else       render(s, width, height);
+        if (scissor) glEnable(GL_SCISSOR_TEST);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, viewFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return redraw;
+}
+
+// ── GPU timing ──────────────────────────────────────────────────────────────
+
+void Renderer::setGpuTiming(bool enabled) {
+    if (enabled && !gpuQueries[0][0]) glGenQueries(kGpuFrames * kGpuPasses, &gpuQueries[0][0]);
+    gpuTiming = enabled;
+    // Results from an earlier run would read as current
+    std::memset(gpuPending, 0, sizeof(gpuPending));
+    gpuTimes = GpuTimes{};
+}
+
+void Renderer::startGpuFrame() {
+    if (!gpuTiming) return;
+    // The slot about to be reused was recorded kGpuFrames renders ago
+    collectGpuTimes(gpuFrame);
+    gpuActive = gpuFrame;
+}
+
+void Renderer::finishGpuFrame() {
+    if (gpuActive >= 0) gpuFrame = (gpuFrame + 1) % kGpuFrames;
+    gpuActive = -1;
+}
+
+void Renderer::collectGpuTimes(int frame) {
+    for (int pass = 0; pass < kGpuPasses; ++pass) {
+        float& ms = pass == 0 ? gpuTimes.solidMs : gpuTimes.wireMs;
+        if (!gpuPending[frame][pass]) {
+            // The pass wasn't drawn that frame (e.g. wireframe off)
+            if (pass > 0) ms = -1.0f;
+            continue;
+        }
+        GLuint query = gpuQueries[frame][pass];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        // Still in flight after kGpuFrames: drop it rather than wait
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            ms = float(double(ns) / 1e6);
+        }
+        gpuPending[frame][pass] = false;
+    }
+}
+
+void Renderer::beginGpuPass(int pass) {
+    if (gpuActive >= 0) glBeginQuery(GL_TIME_ELAPSED, gpuQueries[gpuActive][pass]);
+}
+
+void Renderer::endGpuPass(int pass) {
+    if (gpuActive < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gpuPending[gpuActive][pass] = true;
+}
+
+void Renderer::renderMesh(MeshHandle handle, const RenderSettings& s,
+                          int x, int y, int vpWidth, int vpHeight, const ClipTransform& clip) {
+    glViewport(x, y, vpWidth, vpHeight);
     glEnable(GL_DEPTH_TEST);
 
-    if (currentVertexCount == 0) return;
+    auto it = meshes.find(handle);
+    if (it == meshes.end() || it->second.vertexCount == 0) return;
+    GpuMesh& mesh = it->second;
+    mesh.lastUse = ++useCounter;
 
-    setUniforms(s, vpWidth, vpHeight);
+    // Shader edges draw the wireframe within the solid pass; the line
+    // overlay is a second full draw
+    const bool singlePass = s.wireframe && !s.lineWireframe && meshShaders.edge.program;
+    const Shader& shader = singlePass ? meshShaders.edge : meshShaders.solid;
+    setUniforms(shader, mesh, s, vpWidth, vpHeight, clip);
+    bool culled = cullMesh(mesh);
 
-    glBindVertexArray(vao);
+    // The Y flip mirrors screen-space winding
+    glFrontFace(clip.flipY ? GL_CW : GL_CCW);
+
+    glBindVertexArray(mesh.vao);
 
     // Solid pass
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)currentVertexCount);
+    beginGpuPass(0);
+    drawMesh(mesh, culled);
+    endGpuPass(0);
 
     // Wireframe overlay
-    if (s.wireframe) {
+    if (s.wireframe && !singlePass) {
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         glLineWidth(s.edgeWidth);
-        // Temporarily change color
-        glUniform4fv(uModelColor, 1, s.edgeColor);
-        glUniform1f(uAmbient, 1.0f);
-        glUniform1f(uDiffuse, 0.0f);
-        glUniform1f(uSpecular, 0.0f);
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)currentVertexCount);
+        setUniforms(meshShaders.line, mesh, s, vpWidth, vpHeight, clip);
+        glUniform4fv(meshShaders.line.uModelColor, 1, s.edgeColor);
+        beginGpuPass(1);
+        drawMesh(mesh, culled);
+        endGpuPass(1);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
 
     glBindVertexArray(0);
+    glFrontFace(GL_CCW);
+}
+
+// ── Scene mode ──────────────────────────────────────────────────────────────
+
+namespace {
+
+// What glMultiDraw*Indirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+uint64_t hashBytes(const unsigned char* p, size_t n, uint64_t h) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < n; ++i) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// Chunks hashed in parallel, combined in order: equal bytes, equal hash
+uint64_t hashParallel(const void* data, size_t bytes, uint64_t seed) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    std::vector<uint64_t> parts(Parallel::chunkCount(bytes, 4 << 20, 0));
+    Parallel::forChunks(bytes, 4 << 20, 0, [&](size_t begin, size_t end, size_t chunk) {
+        parts[chunk] = hashBytes(p + begin, end - begin, 0xcbf29ce484222325ull);
+    });
+    return hashBytes(reinterpret_cast<const unsigned char*>(parts.data()), parts.size() * 8, seed ^ bytes);
+}
+
+uint64_t meshFingerprint(const STLModel& m) {
+    uint64_t h = hashParallel(m.glVertices.data(), m.glVertices.size() * sizeof(float), 0xcbf29ce484222325ull);
+    return hashParallel(m.indices.data(), m.indices.size() * sizeof(uint32_t), h);
+}
+
+bool sameMesh(const STLModel& a, const STLModel& b) {
+    return a.glVertices.size() == b.glVertices.size() && a.indices.size() == b.indices.size() &&
+           std::memcmp(a.glVertices.data(), b.glVertices.data(), a.glVertices.size() * sizeof(float)) == 0 &&
+           std::memcmp(a.indices.data(), b.indices.data(), a.indices.size() * sizeof(uint32_t)) == 0;
+}
+
+} // namespace
+
+bool Renderer::buildScene(const std::vector<SceneItem>& items) {
+    PROFILE_SCOPE("render.sceneBuild");
+
+    // Placements grouped by mesh: the same revision, or one with identical
+    // contents (hash first, then an exact compare, remembered in sceneKeys)
+    struct Group {
+        const STLModel*               model;
+        std::vector<const SceneItem*> placements;
+        long                          resident = -1;   // Index into the new resident list
+    };
+    std::vector<Group> groups;
+    std::unordered_map<uint64_t, size_t>      byRevision;
+    std::unordered_multimap<uint64_t, size_t> byHash;
+    std::unordered_map<uint64_t, SceneKey>    keys;
+    for (const auto& item : items) {
+        const STLModel* m = item.model;
+        if (!m || m->vertexCount == 0) continue;
+
+        auto known = byRevision.find(m->revision);
+        size_t g = known != byRevision.end() ? known->second : groups.size();
+        if (known == byRevision.end()) {
+            auto cached = sceneKeys.find(m->revision);
+            SceneKey key = cached != sceneKeys.end() ? cached->second : SceneKey{meshFingerprint(*m), 0};
+            auto same = key.sameAs ? byRevision.find(key.sameAs) : byRevision.end();
+            if (same != byRevision.end()) {
+                g = same->second;
+            } else {
+                auto range = byHash.equal_range(key.hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (sameMesh(*groups[it->second].model, *m)) {
+                        g = it->second;
+                        key.sameAs = groups[g].model->revision;
+                        break;
+                    }
+                }
+            }
+            if (g == groups.size()) {
+                groups.push_back({m, {}});
+                byHash.emplace(key.hash, g);
+            }
+            byRevision.emplace(m->revision, g);
+            keys.emplace(m->revision, key);
+        }
+        groups[g].placements.push_back(&item);
+    }
+    sceneKeys = std::move(keys);   // Forget models that left the scene
+    if (groups.empty()) {
+        clearScene();
+        return false;
+    }
+
+    // Indexed meshes first, so each kind's commands are contiguous
+    std::vector<size_t> order(groups.size()), position(groups.size());
+    for (size_t g = 0; g < order.size(); ++g) order[g] = g;
+    std::stable_partition(order.begin(), order.end(), [&](size_t g) { return groups[g].model->isIndexed(); });
+    std::vector<Group> sorted;
+    sorted.reserve(groups.size());
+    for (size_t g : order) {
+        position[g] = sorted.size();
+        sorted.push_back(std::move(groups[g]));
+    }
+    groups = std::move(sorted);
+    for (auto& entry : byRevision) entry.second = position[entry.second];
+
+    // Meshes the buffers already hold stay, even when only a model with the
+    // same contents is left (matched through sameAs); the rest are appended
+    std::unordered_map<uint64_t, size_t> byAlias;
+    for (const auto& k : sceneKeys) {
+        if (k.second.sameAs) byAlias.emplace(k.second.sameAs, byRevision.at(k.first));
+    }
+    std::vector<Scene::Resident> resident;
+    size_t liveVertices = 0, liveIndices = 0;
+    auto groupOf = [&](uint64_t revision) -> long {
+        auto it = byRevision.find(revision);
+        if (it != byRevision.end()) return long(it->second);
+        it = byAlias.find(revision);
+        return it != byAlias.end() ? long(it->second) : -1;
+    };
+    for (const auto& r : scene.resident) {
+        long g = groupOf(r.revision);
+        if (g < 0 || groups[size_t(g)].resident >= 0) continue;
+        groups[size_t(g)].resident = long(resident.size());
+        resident.push_back(r);
+        resident.back().revision = groups[size_t(g)].model->revision;
+        liveVertices += r.vertexCount;
+        liveIndices  += r.indexCount;
+    }
+    size_t addVertices = 0, addIndices = 0, instances = 0;
+    for (const auto& g : groups) {
+        instances += g.placements.size();
+        if (g.resident >= 0) continue;
+        addVertices += g.model->vertexCount;
+        addIndices  += g.model->indices.size();
+    }
+
+    // Draw parameters (first vertex, base vertex) are 32-bit
+    size_t totalVertices = liveVertices + addVertices, totalIndices = liveIndices + addIndices;
+    if (totalVertices > size_t(INT32_MAX) || totalIndices > size_t(UINT32_MAX)) {
+        std::cerr << "Scene too large for shared buffers (" << totalVertices << " vertices)" << std::endl;
+        clearScene();
+        return false;
+    }
+
+    GpuMesh& mesh = scene.mesh;
+    if (!mesh.vao) {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &scene.instanceVbo);
+    }
+
+    // New buffers when the appends don't fit or more than half is dead
+    // space; kept meshes move across on the GPU, packed, and the headroom
+    // lets a folder that is still loading append for a while
+    size_t deadVertices = scene.vertexEnd - std::min(scene.vertexEnd, liveVertices);
+    bool fits = scene.vertexEnd + addVertices <= scene.vertexCapacity &&
+                scene.indexEnd + addIndices <= scene.indexCapacity;
+    if (!mesh.vbo || !fits || deadVertices > totalVertices) {
+        size_t vertexCapacity = std::min(totalVertices + totalVertices / 2, size_t(INT32_MAX));
+        size_t indexCapacity  = std::min(totalIndices + totalIndices / 2, size_t(UINT32_MAX));
+        GLuint vbo, ebo;
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * 6 * sizeof(float), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, std::max<size_t>(indexCapacity, 1) * sizeof(uint32_t), nullptr,
+                     GL_STATIC_DRAW);
+
+        size_t vertex = 0, index = 0;
+        for (auto& r : resident) {
+            glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbo);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, r.firstVertex * 6 * sizeof(float),
+                                vertex * 6 * sizeof(float), r.vertexCount * 6 * sizeof(float));
+            if (r.indexCount > 0) {
+                glBindBuffer(GL_COPY_READ_BUFFER, mesh.ebo);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, r.firstIndex * sizeof(uint32_t),
+                                    index * sizeof(uint32_t), r.indexCount * sizeof(uint32_t));
+            }
+            r.firstVertex = vertex;
+            r.firstIndex  = index;
+            vertex += r.vertexCount;
+            index  += r.indexCount;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (mesh.vbo) glDeleteBuffers(1, &mesh.vbo);
+        if (mesh.ebo) glDeleteBuffers(1, &mesh.ebo);
+        mesh.vbo = vbo;
+        mesh.ebo = ebo;
+        scene.vertexCapacity = vertexCapacity;
+        scene.indexCapacity  = indexCapacity;
+        scene.vertexEnd      = vertex;
+        scene.indexEnd       = index;
+
+        // The VAO captured the old buffers
+        glBindVertexArray(mesh.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        setFloatAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBindBuffer(GL_ARRAY_BUFFER, scene.instanceVbo);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Upload only what the buffers don't have yet
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mesh.ebo);   // Not ELEMENT_ARRAY: that would rebind the VAO's
+    for (auto& g : groups) {
+        if (g.resident >= 0) continue;
+        const STLModel& m = *g.model;
+        Scene::Resident r;
+        r.revision    = m.revision;
+        r.firstVertex = scene.vertexEnd;
+        r.vertexCount = m.vertexCount;
+        r.firstIndex  = scene.indexEnd;
+        r.indexCount  = m.indices.size();
+        glBufferSubData(GL_ARRAY_BUFFER, r.firstVertex * 6 * sizeof(float),
+                        r.vertexCount * 6 * sizeof(float), m.glVertices.data());
+        if (r.indexCount > 0) {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, r.firstIndex * sizeof(uint32_t),
+                            r.indexCount * sizeof(uint32_t), m.indices.data());
+        }
+        scene.vertexEnd += r.vertexCount;
+        scene.indexEnd  += r.indexCount;
+        g.resident = long(resident.size());
+        resident.push_back(r);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    scene.resident = std::move(resident);
+
+    // Draws, placements and framing are rebuilt every time (they're small)
+    scene.draws.clear();
+    scene.elementDraws = 0;
+    scene.stats        = SceneStats{};
+    std::vector<float> placements;   // offset xyz, scale per instance
+    placements.reserve(instances * 4);
+    BoundingBox bounds;
+    bounds.reset();
+    for (const auto& g : groups) {
+        const STLModel& m = *g.model;
+        const Scene::Resident& r = scene.resident[size_t(g.resident)];
+
+        SceneDraw d;
+        d.indexed       = m.isIndexed();
+        d.instanceCount = GLuint(g.placements.size());
+        d.baseInstance  = GLuint(placements.size() / 4);
+        if (d.indexed) {
+            d.count      = GLuint(r.indexCount);
+            d.first      = GLuint(r.firstIndex);
+            d.baseVertex = GLint(r.firstVertex);
+        } else {
+            d.count = GLuint(r.vertexCount);
+            d.first = GLuint(r.firstVertex);
+        }
+
+        for (const SceneItem* item : g.placements) {
+            placements.insert(placements.end(), {item->offset[0], item->offset[1], item->offset[2], item->scale});
+            const BoundingBox& b = m.bounds;
+            bounds.include({b.minX * item->scale + item->offset[0],
+                            b.minY * item->scale + item->offset[1],
+                            b.minZ * item->scale + item->offset[2]});
+            bounds.include({b.maxX * item->scale + item->offset[0],
+                            b.maxY * item->scale + item->offset[1],
+                            b.maxZ * item->scale + item->offset[2]});
+        }
+        scene.draws.push_back(d);
+        if (d.indexed) scene.elementDraws++;
+        scene.stats.triangles += m.triangleCount() * g.placements.size();
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, scene.instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, placements.size() * sizeof(float), placements.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    size_t commandBytes = 0;
+    if (multiDrawIndirect) {
+        std::vector<DrawElementsIndirectCommand> elements;
+        std::vector<DrawArraysIndirectCommand>   arrays;
+        for (const SceneDraw& d : scene.draws) {
+            if (d.indexed) elements.push_back({d.count, d.instanceCount, d.first, d.baseVertex, d.baseInstance});
+            else           arrays.push_back({d.count, d.instanceCount, d.first, d.baseInstance});
+        }
+        size_t elementBytes = elements.size() * sizeof(DrawElementsIndirectCommand);
+        commandBytes = elementBytes + arrays.size() * sizeof(DrawArraysIndirectCommand);
+
+        if (!scene.indirectBuffer) glGenBuffers(1, &scene.indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, elementBytes, elements.data());
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, elementBytes, commandBytes - elementBytes, arrays.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    mesh.vertexCount = totalVertices;
+    mesh.indexCount  = totalIndices;
+    mesh.bytes       = scene.vertexCapacity * 6 * sizeof(float) + scene.indexCapacity * sizeof(uint32_t) +
+                       placements.size() * sizeof(float) + commandBytes;
+    setFraming(mesh, bounds);
+
+    size_t arrayDraws = scene.draws.size() - scene.elementDraws;
+    scene.stats.items     = instances;
+    scene.stats.meshes    = groups.size();
+    scene.stats.bytes     = mesh.bytes;
+    scene.stats.drawCalls = multiDrawIndirect ? int(scene.elementDraws > 0) + int(arrayDraws > 0)
+                                              : int(scene.draws.size());
+    generation++;
+    return true;
+}
+
+void Renderer::clearScene() {
+    GpuMesh& mesh = scene.mesh;
+    if (mesh.vao) glDeleteVertexArrays(1, &mesh.vao);
+    if (mesh.vbo) glDeleteBuffers(1, &mesh.vbo);
+    if (mesh.ebo) glDeleteBuffers(1, &mesh.ebo);
+    if (scene.instanceVbo) glDeleteBuffers(1, &scene.instanceVbo);
+    if (scene.indirectBuffer) glDeleteBuffers(1, &scene.indirectBuffer);
+    if (mesh.vao) generation++;
+    scene = Scene{};
+}
+
+void Renderer::drawScene() {
+    if (multiDrawIndirect) {
+        size_t arrayDraws = scene.draws.size() - scene.elementDraws;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene.indirectBuffer);
+        if (scene.elementDraws > 0) {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)scene.elementDraws, 0);
+        }
+        if (arrayDraws > 0) {
+            const void* offset = (const void*)(scene.elementDraws * sizeof(DrawElementsIndirectCommand));
+            glMultiDrawArraysIndirect(GL_TRIANGLES, offset, (GLsizei)arrayDraws, 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+
+    // No base instance: point the instance attribute at each mesh's placements
+    glBindBuffer(GL_ARRAY_BUFFER, scene.instanceVbo);
+    for (const SceneDraw& d : scene.draws) {
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                              (void*)(size_t(d.baseInstance) * 4 * sizeof(float)));
+        if (d.indexed) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)d.count, GL_UNSIGNED_INT,
+                                              (void*)(size_t(d.first) * sizeof(uint32_t)),
+                                              (GLsizei)d.instanceCount, d.baseVertex);
+        } else {
+            glDrawArraysInstanced(GL_TRIANGLES, (GLint)d.first, (GLsizei)d.count, (GLsizei)d.instanceCount);
+        }
+    }
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::renderScene(const RenderSettings& s, int vpWidth, int vpHeight) {
+    PROFILE_SCOPE("render.scene");
+    if (!hasScene()) return;
+
+    startGpuFrame();
+    glViewport(0, 0, vpWidth, vpHeight);
+    glEnable(GL_DEPTH_TEST);
+
+    const bool singlePass = s.wireframe && !s.lineWireframe && sceneShaders.edge.program;
+    const ClipTransform clip;
+    setUniforms(singlePass ? sceneShaders.edge : sceneShaders.solid, scene.mesh, s, vpWidth, vpHeight, clip);
+    drawnTriangles = totalTriangles = scene.stats.triangles;
+    drawnLod = 0;
+
+    glBindVertexArray(scene.mesh.vao);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    beginGpuPass(0);
+    drawScene();
+    endGpuPass(0);
+
+    if (s.wireframe && !singlePass) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glLineWidth(s.edgeWidth);
+        setUniforms(sceneShaders.line, scene.mesh, s, vpWidth, vpHeight, clip);
+        glUniform4fv(sceneShaders.line.uModelColor, 1, s.edgeColor);
+        beginGpuPass(1);
+        drawScene();
+        endGpuPass(1);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+    glBindVertexArray(0);
+    finishGpuFrame();
+}
+
+// ── Picking ─────────────────────────────────────────────────────────────────
+// The inverse of setUniforms() without a ClipTransform: the model matrix is
+// a uniform scale about the mesh's centre, so rays and points map back to
+// STL coordinates with one multiply-add.
+
+bool Renderer::pickRay(const RenderSettings& s, int vpWidth, int vpHeight, float px, float py,
+                       std::array<float, 3>& origin, std::array<float, 3>& dir) const {
+    auto it = meshes.find(currentMesh);
+    if (it == meshes.end() || vpWidth <= 0 || vpHeight <= 0) return false;
+    const GpuMesh& mesh = it->second;
+
+    std::array<float, 3> eye = cameraEye(s);
+    float side[3], up[3], fwd[3];
+    cameraBasis(eye, side, up, fwd);
+
+    float tanHalf = std::tan(s.fov * (float)M_PI / 360.0f);
+    float aspect  = (float)vpWidth / (float)vpHeight;
+    float ndcX = 2.0f * px / vpWidth - 1.0f;
+    float ndcY = 1.0f - 2.0f * py / vpHeight;
+
+    float invScale = mesh.span * 0.5f;
+    const float center[3] = {mesh.centerX, mesh.centerY, mesh.centerZ};
+    for (int i = 0; i < 3; ++i) {
+        origin[i] = eye[i] * invScale + center[i];
+        dir[i]    = fwd[i] + side[i] * ndcX * tanHalf * aspect + up[i] * ndcY * tanHalf;
+    }
+    return true;
+}
+
+bool Renderer::projectPoint(const RenderSettings& s, int vpWidth, int vpHeight,
+                            const std::array<float, 3>& point, float& px, float& py) const {
+    auto it = meshes.find(currentMesh);
+    if (it == meshes.end() || vpWidth <= 0 || vpHeight <= 0) return false;
+    const GpuMesh& mesh = it->second;
+
+    std::array<float, 3> eye = cameraEye(s);
+    float side[3], up[3], fwd[3];
+    cameraBasis(eye, side, up, fwd);
+
+    float scale = 2.0f / mesh.span;
+    const float center[3] = {mesh.centerX, mesh.centerY, mesh.centerZ};
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        float rel = (point[i] - center[i]) * scale - eye[i];
+        x += rel * side[i];
+        y += rel * up[i];
+        z += rel * fwd[i];
+    }
+    if (z <= 0.01f) return false;   // Behind the near plane
+
+    float tanHalf = std::tan(s.fov * (float)M_PI / 360.0f);
+    float aspect  = (float)vpWidth / (float)vpHeight;
+    px = (x / (z * tanHalf * aspect) + 1.0f) * 0.5f * vpWidth;
+    py = (1.0f - y / (z * tanHalf)) * 0.5f * vpHeight;
+    return true;
 }
 
 // ── Offscreen rendering (FBO) ───────────────────────────────────────────────
 
-void Renderer::setupFBO(int width, int height) {
-    if (fbo) {
-        glDeleteFramebuffers(1, &fbo);
-        glDeleteRenderbuffers(1, &rbo);
-        glDeleteTextures(1, &fboTex);
+bool Renderer::ensureFBO(int width, int height) {
+    if (fbo && width == fboWidth && height == fboHeight) return fboComplete;
+    if (maxTargetSize > 0 && (width > maxTargetSize || height > maxTargetSize)) {
+        std::cerr << "Offscreen target " << width << "x" << height
+                  << " exceeds the GL limit of " << maxTargetSize << std::endl;
+        return false;
     }
 
-    glGenFramebuffers(1, &fbo);
+    if (!fbo) {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &fboTex);
+        glGenRenderbuffers(1, &rbo);
+    }
+
+    // Re-specify storage in place; the object names (and the attachments) stay
     glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-    glGenTextures(1, &fboTex);
     glBindTexture(GL_TEXTURE_2D, fboTex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTex, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    glGenRenderbuffers(1, &rbo);
     glBindRenderbuffer(GL_RENDERBUFFER, rbo);
     glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    // Checked once per resize rather than per image
+    fboComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!fboComplete) std::cerr << "Framebuffer not complete!" << std::endl;
+    fboWidth  = width;
+    fboHeight = height;
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return fboComplete;
+}
+
+bool Renderer::renderOffscreen(const STLModel& model, const RenderSettings& s,
+                                int width, int height) {
+    PROFILE_SCOPE("export.render");
+    if (!ensureFBO(width, height)) return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    // Make resident (a no-op if cached) and render
+    MeshHandle handle = acquire(model);
+
+    // Clear the FBO
+    glClearColor(s.bgColor[0], s.bgColor[1], s.bgColor[2], s.bgColor[3]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    ClipTransform clip;
+    clip.flipY = true;
+    renderMesh(handle, s, 0, 0, width, height, clip);
+    return true;
+}
+
+void Renderer::endOffscreen() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 bool Renderer::renderToBuffer(const STLModel& model, const RenderSettings& s,
                                int width, int height,
                                std::vector<unsigned char>& pixels) {
-    setupFBO(width, height);
+    if (!renderOffscreen(model, s, width, height)) return false;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    // Already top-down, see renderOffscreen()
+    {
+        PROFILE_SCOPE("export.readback");
+        pixels.resize(size_t(width) * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer not complete!" << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        return false;
+    endOffscreen();
+    return true;
+}
+
+// ── Multi-view ──────────────────────────────────────────────────────────────
+
+std::vector<ViewPose> turntablePoses(const RenderSettings& s, int count) {
+    std::vector<ViewPose> poses;
+    for (int i = 0; i < count; ++i) {
+        poses.push_back({s.elevation, s.azimuth + 360.0f * i / count});
     }
+    return poses;
+}
 
-    // Upload and render
-    uploadModel(model);
+SheetLayout sheetLayout(size_t views, int tileWidth, int tileHeight, int columns) {
+    SheetLayout layout;
+    layout.tileWidth  = tileWidth;
+    layout.tileHeight = tileHeight;
+    if (views == 0) return layout;
+    if (columns <= 0) columns = (int)std::ceil(std::sqrt((double)views));
+    layout.columns = std::min<int>(columns, (int)views);
+    layout.rows    = (int)((views + layout.columns - 1) / layout.columns);
+    return layout;
+}
 
-    // Clear the FBO
+bool Renderer::renderViewsOffscreen(const STLModel& model, const RenderSettings& s,
+                                    const std::vector<ViewPose>& poses, const SheetLayout& layout) {
+    PROFILE_SCOPE("export.render");
+    if (poses.empty() || poses.size() > size_t(layout.columns) * layout.rows) return false;
+    if (!ensureFBO(layout.width(), layout.height())) return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    MeshHandle handle = acquire(model);
+
+    // One clear for the whole sheet; unused tiles stay background
     glClearColor(s.bgColor[0], s.bgColor[1], s.bgColor[2], s.bgColor[3]);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    render(s, width, height);
+    // Top-down rendering puts framebuffer row 0 at the top of the image, so
+    // tile row r starts at y = r * tileHeight
+    RenderSettings view = s;
+    ClipTransform clip;
+    clip.flipY = true;
+    for (size_t i = 0; i < poses.size(); ++i) {
+        view.elevation = poses[i].elevation;
+        view.azimuth   = poses[i].azimuth;
+        int col = int(i % layout.columns);
+        int row = int(i / layout.columns);
+        renderMesh(handle, view, col * layout.tileWidth, row * layout.tileHeight,
+                   layout.tileWidth, layout.tileHeight, clip);
+    }
+    return true;
+}
 
-    // Read pixels
-    pixels.resize(width * height * 4);
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+bool Renderer::renderViewsToBuffer(const STLModel& model, const RenderSettings& s,
+                                   const std::vector<ViewPose>& poses, const SheetLayout& layout,
+                                   std::vector<unsigned char>& pixels) {
+    if (!renderViewsOffscreen(model, s, poses, layout)) return false;
 
-    // Flip vertically (OpenGL reads bottom-up)
-    std::vector<unsigned char> row(width * 4);
-    for (int y = 0; y < height / 2; ++y) {
-        int top = y * width * 4;
-        int bot = (height - 1 - y) * width * 4;
-        memcpy(row.data(), &pixels[top], width * 4);
-        memcpy(&pixels[top], &pixels[bot], width * 4);
-        memcpy(&pixels[bot], row.data(), width * 4);
+    {
+        PROFILE_SCOPE("export.readback");
+        pixels.resize(size_t(layout.width()) * layout.height() * 4);
+        glReadPixels(0, 0, layout.width(), layout.height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    endOffscreen();
     return true;
 }
+
+// ── Tiled rendering ─────────────────────────────────────────────────────────
+
+bool Renderer::renderTiled(const STLModel& model, const RenderSettings& s,
+                           int width, int height, int tileSize, const BandSink& sink) {
+    if (width <= 0 || height <= 0) return false;
+
+    int tile = tileSize > 0 ? tileSize : kDefaultTileSize;
+    if (maxTargetSize > 0) tile = std::min<int>(tile, maxTargetSize);
+    const int tileW = std::min(tile, width);
+    const int tileH = std::min(tile, height);
+
+    // One tile-sized target for every tile; edge tiles use its corner
+    if (!ensureFBO(tileW, tileH)) return false;
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    MeshHandle handle = acquire(model);
+
+    // Tiles read straight into their column of the band
+    std::vector<unsigned char> band(size_t(width) * tileH * 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+
+    ClipTransform clip;
+    clip.flipY  = true;
+    clip.aspect = (float)width / (float)height;
+
+    bool ok = true;
+    for (int ty = 0; ty < height && ok; ty += tileH) {
+        const int th = std::min(tileH, height - ty);
+        for (int tx = 0; tx < width; tx += tileW) {
+            const int tw = std::min(tileW, width - tx);
+
+            // Sub-frustum covering pixels [tx, tx+tw) x [ty, ty+th) of the full image
+            clip.scaleX  = (float)width / (float)tw;
+            clip.offsetX = (float)(width - 2 * tx - tw) / (float)tw;
+            clip.scaleY  = (float)height / (float)th;
+            clip.offsetY = (float)(height - 2 * ty - th) / (float)th;
+
+            glClearColor(s.bgColor[0], s.bgColor[1], s.bgColor[2], s.bgColor[3]);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderMesh(handle, s, 0, 0, tw, th, clip);
+            glReadPixels(0, 0, tw, th, GL_RGBA, GL_UNSIGNED_BYTE, band.data() + size_t(tx) * 4);
+        }
+        ok = sink(band.data(), th);
+    }
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    endOffscreen();
+    return ok;
+}
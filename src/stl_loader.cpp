@@ -1,12 +1,21 @@
 #include "stl_loader.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "mesh_kernels.h"
+#include "parallel.h"
+#include "profiler.h"
 
 #include <fstream>
-#include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <filesystem>
 #include <iostream>
+#include <string_view>
 
 namespace fs = std::filesystem;
 
@@ -19,210 +28,604 @@ float BoundingBox::span() const {
     return std::max({dx, dy, dz});
 }
 
+void BoundingBox::reset() {
+    minX = minY = minZ =  1e30f;
+    maxX = maxY = maxZ = -1e30f;
+}
+
+void BoundingBox::include(const std::array<float, 3>& v) {
+    minX = std::min(minX, v[0]);
+    minY = std::min(minY, v[1]);
+    minZ = std::min(minZ, v[2]);
+    maxX = std::max(maxX, v[0]);
+    maxY = std::max(maxY, v[1]);
+    maxZ = std::max(maxZ, v[2]);
+}
+
+void BoundingBox::merge(const BoundingBox& o) {
+    minX = std::min(minX, o.minX);
+    minY = std::min(minY, o.minY);
+    minZ = std::min(minZ, o.minZ);
+    maxX = std::max(maxX, o.maxX);
+    maxY = std::max(maxY, o.maxY);
+    maxZ = std::max(maxZ, o.maxZ);
+}
+
+// ── LoadStream ──────────────────────────────────────────────────────────────
+
+// How long close() waits for the consumer (normally one frame) before
+// dropping runs it hasn't drained
+static constexpr auto kStreamCloseWait = std::chrono::milliseconds(250);
+
+bool LoadStream::drain(const std::function<void(const float*, const Range&)>& fn) {
+    // Held across the callbacks: close() can't invalidate `vertices_` under them
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!vertices_ || closed_) return false;
+    for (const Range& r : pending_) fn(vertices_, r);
+    pending_.clear();
+    drained_.notify_all();
+    return true;
+}
+
+size_t LoadStream::triangles() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return triangles_;
+}
+
+bool LoadStream::closed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+BoundingBox LoadStream::bounds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bounds_;
+}
+
+void LoadStream::open(const float* vertices, size_t triangles, const BoundingBox& estimate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    vertices_  = vertices;
+    triangles_ = triangles;
+    bounds_    = estimate;
+    pending_.clear();
+    closed_ = false;
+}
+
+void LoadStream::publish(size_t first, size_t count, const BoundingBox& box) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!vertices_ || closed_ || count == 0) return;
+    bounds_.merge(box);
+
+    // Each decoder thread's steps are consecutive; extend its last run
+    for (Range& r : pending_) {
+        if (r.first + r.count == first) {
+            r.count += count;
+            return;
+        }
+    }
+    pending_.push_back({first, count});
+}
+
+void LoadStream::close(bool drainFirst) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (drainFirst && vertices_ && !closed_) {
+        drained_.wait_for(lock, kStreamCloseWait, [&] { return pending_.empty(); });
+    }
+    vertices_ = nullptr;
+    pending_.clear();
+    closed_ = true;
+}
+
 // ── Helpers ─────────────────────────────────────────────────────────────────
 
-static bool isBinarySTL(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) return false;
+static constexpr size_t kBinaryHeaderSize = 84;   // 80-byte header + uint32 count
+static constexpr size_t kBinaryRecordSize = 50;   // 12 floats + uint16 attribute
 
-    // Read header (80 bytes) + triangle count (4 bytes)
-    char header[80];
-    file.read(header, 80);
-    if (!file) return false;
+// Below these sizes a chunk isn't worth a thread of its own
+static constexpr size_t kMinBinaryChunkTris  = 64 * 1024;
+static constexpr size_t kMinASCIIChunkBytes  = 4 * 1024 * 1024;
+
+// Typical exporters write ~250 bytes per facet; guessing low only over-reserves a little
+static constexpr size_t kASCIIBytesPerFacet  = 200;
+
+static constexpr size_t kFloatsPerTriangle = 18;  // 3 x (normal + position)
+
+// Records read for a streamed load's first bounds estimate
+static constexpr size_t kStreamBoundsSamples = 4096;
+
+static_assert(sizeof(Triangle) == 48, "Triangle must match the 48-byte STL record layout");
+
+static unsigned decodeThreads(const LoadOptions& options) {
+    return options.parallel ? Parallel::threadCount(options.threads) : 1;
+}
+
+// Decode threads report finished work units (triangles or bytes) here; it
+// publishes the fraction to LoadOptions::progress and relays cancellation
+class ProgressReporter {
+public:
+    ProgressReporter(LoadProgress* progress, uint64_t total, float share)
+        : progress_(progress), total_(std::max<uint64_t>(total, 1)), share_(share) {}
+
+    // Returns false once cancellation has been requested
+    bool advance(uint64_t units) {
+        if (!progress_) return true;
+        uint64_t done = done_.fetch_add(units, std::memory_order_relaxed) + units;
+        progress_->fraction.store(share_ * float(std::min(done, total_)) / float(total_),
+                                  std::memory_order_relaxed);
+        return !progress_->cancel.load(std::memory_order_relaxed);
+    }
+
+    bool cancelled() const {
+        return progress_ && progress_->cancel.load(std::memory_order_relaxed);
+    }
+
+private:
+    LoadProgress*         progress_;
+    uint64_t              total_;
+    float                 share_;
+    std::atomic<uint64_t> done_{0};
+};
+
+// Work between two progress/cancel checks
+static constexpr size_t kProgressStepTris  = 16 * 1024;
+static constexpr size_t kProgressStepBytes = 1024 * 1024;
+
+// Recompute the normal if it's all zero (some exporters do this)
+static inline void fixNormal(Triangle& tri) {
+    float len = tri.normal[0]*tri.normal[0] + tri.normal[1]*tri.normal[1] + tri.normal[2]*tri.normal[2];
+    if (len < 1e-6f) {
+        // Cross product of (v1-v0) x (v2-v0)
+        float ux = tri.v1[0] - tri.v0[0], uy = tri.v1[1] - tri.v0[1], uz = tri.v1[2] - tri.v0[2];
+        float vx = tri.v2[0] - tri.v0[0], vy = tri.v2[1] - tri.v0[1], vz = tri.v2[2] - tri.v0[2];
+        float nx = uy*vz - uz*vy;
+        float ny = uz*vx - ux*vz;
+        float nz = ux*vy - uy*vx;
+        float nlen = std::sqrt(nx*nx + ny*ny + nz*nz);
+        if (nlen > 1e-6f) {
+            tri.normal = {nx/nlen, ny/nlen, nz/nlen};
+        }
+    }
+}
+
+// `data` needs only the first 84 bytes; `size` is the whole file's size
+static bool isBinarySTL(const char* data, uint64_t size) {
+    // Too short for header (80 bytes) + triangle count (4 bytes)
+    if (size < kBinaryHeaderSize) return false;
 
     uint32_t numTriangles = 0;
-    file.read(reinterpret_cast<char*>(&numTriangles), 4);
-    if (!file) return false;
+    std::memcpy(&numTriangles, data + 80, 4);
 
     // Check if file size matches expected binary size
-    file.seekg(0, std::ios::end);
-    auto fileSize = file.tellg();
-    auto expectedSize = 80 + 4 + (numTriangles * 50);  // 50 bytes per triangle
+    uint64_t expectedSize = kBinaryHeaderSize + uint64_t(numTriangles) * kBinaryRecordSize;
 
     // Also check if header starts with "solid" — ambiguous, but if size matches binary, treat as binary
-    bool startsWithSolid = (std::strncmp(header, "solid", 5) == 0);
+    bool startsWithSolid = (std::strncmp(data, "solid", 5) == 0);
 
-    if (fileSize == static_cast<std::streampos>(expectedSize) && numTriangles > 0) {
+    if (size == expectedSize && numTriangles > 0) {
         return true;
     }
 
     return !startsWithSolid;
 }
 
-static bool loadBinarySTL(const std::string& filepath, std::vector<Triangle>& triangles) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file) return false;
-
-    char header[80];
-    file.read(header, 80);
+// Decodes the 50-byte records straight from memory (a mapping or a read buffer)
+// into the final interleaved vertex layout. Records are fixed-size, so each
+// thread takes a contiguous range of triangle indices and runs the emit kernel
+// (normal fixup, bounds, interleave) over it one progress step at a time.
+static bool loadBinarySTL(const char* data, size_t size, const LoadOptions& options,
+                          ProgressReporter& progress,
+                          std::vector<float>& glVertices, BoundingBox& bounds) {
+    if (size < kBinaryHeaderSize) return false;
 
     uint32_t numTriangles = 0;
-    file.read(reinterpret_cast<char*>(&numTriangles), 4);
+    std::memcpy(&numTriangles, data + 80, 4);
+
+    // Truncated file
+    if (size < kBinaryHeaderSize + uint64_t(numTriangles) * kBinaryRecordSize) return false;
+
+    glVertices.resize(size_t(numTriangles) * kFloatsPerTriangle);
+
+    const char* records = data + kBinaryHeaderSize;
+    unsigned threads = decodeThreads(options);
+    std::vector<BoundingBox> chunkBounds(Parallel::chunkCount(numTriangles, kMinBinaryChunkTris, threads));
+    MeshKernels::EmitFn emit = MeshKernels::best().emit;
+
+    // Streaming: estimate the bounds from a sample of records so the view
+    // frames the model from the first run on, then publish every step
+    LoadStream* stream = options.stream.get();
+    if (stream && numTriangles > 0) {
+        BoundingBox estimate;
+        estimate.reset();
+        size_t stride = std::max<size_t>(1, numTriangles / kStreamBoundsSamples);
+        for (size_t i = 0; i < numTriangles; i += stride) {
+            float v[9];
+            std::memcpy(v, records + i * kBinaryRecordSize + 12, sizeof(v));
+            for (int k = 0; k < 9; k += 3) estimate.include({v[k], v[k + 1], v[k + 2]});
+        }
+        stream->open(glVertices.data(), numTriangles, estimate);
+    }
 
-    triangles.resize(numTriangles);
+    Parallel::forChunks(numTriangles, kMinBinaryChunkTris, threads,
+                        [&](size_t begin, size_t end, size_t chunk) {
+        BoundingBox box;
+        box.reset();
+        for (size_t step = begin; step < end; step += kProgressStepTris) {
+            size_t stepEnd = std::min(end, step + kProgressStepTris);
+            // normal + v0 + v1 + v2; the trailing attribute byte count is ignored
+            emit(records + step * kBinaryRecordSize, kBinaryRecordSize, stepEnd - step,
+                 glVertices.data() + step * kFloatsPerTriangle, box);
+            if (stream) stream->publish(step, stepEnd - step, box);
+            if (!progress.advance(stepEnd - step)) break;
+        }
+        chunkBounds[chunk] = box;
+    });
+    if (progress.cancelled()) return false;
 
-    for (uint32_t i = 0; i < numTriangles; ++i) {
-        file.read(reinterpret_cast<char*>(triangles[i].normal.data()), 12);
-        file.read(reinterpret_cast<char*>(triangles[i].v0.data()), 12);
-        file.read(reinterpret_cast<char*>(triangles[i].v1.data()), 12);
-        file.read(reinterpret_cast<char*>(triangles[i].v2.data()), 12);
+    bounds.reset();
+    for (const auto& b : chunkBounds) bounds.merge(b);
+    return true;
+}
 
-        uint16_t attrByteCount;
-        file.read(reinterpret_cast<char*>(&attrByteCount), 2);
+// ── ASCII tokenizer ─────────────────────────────────────────────────────────
+// Works directly on the mapped (or buffered) text: no per-line strings, no
+// streams, and locale-independent float parsing.
 
-        if (!file) return false;
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool startsWith(const char* p, const char* end, std::string_view word) {
+    return size_t(end - p) >= word.size() && std::memcmp(p, word.data(), word.size()) == 0;
+}
+
+// Parse one float at p (after optional blanks) and advance p past it.
+// Malformed numbers yield 0 instead of aborting the whole file.
+static inline float parseFloat(const char*& p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    if (p < end && *p == '+') ++p;  // from_chars rejects an explicit '+'
+
+    float value = 0.0f;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto res = std::from_chars(p, end, value);
+    if (res.ec == std::errc::invalid_argument) value = 0.0f;
+    p = res.ptr;
+#else
+    // strtof needs a terminated string; numbers in STL files are short
+    char token[64];
+    size_t n = 0;
+    while (p + n < end && n < sizeof(token) - 1 && !isBlank(p[n]) && p[n] != '\n') {
+        token[n] = p[n];
+        ++n;
     }
+    token[n] = '\0';
+    char* stop = token;
+    value = std::strtof(token, &stop);
+    p += (stop > token) ? size_t(stop - token) : n;
+#endif
+    // Skip anything unparsed up to the next separator so one bad token can't desync the line
+    while (p < end && !isBlank(*p) && *p != '\n') ++p;
+    return value;
+}
 
-    return true;
+static inline void parseVec3(const char*& p, const char* end, std::array<float, 3>& v) {
+    v[0] = parseFloat(p, end);
+    v[1] = parseFloat(p, end);
+    v[2] = parseFloat(p, end);
 }
 
-static bool loadASCIISTL(const std::string& filepath, std::vector<Triangle>& triangles) {
-    std::ifstream file(filepath);
-    if (!file) return false;
+// Parses one run of complete facets. Chunks always start right after an
+// `endfacet` line, so no parser state crosses a chunk boundary.
+static void parseASCIIChunk(const char* begin, const char* end, ProgressReporter& progress,
+                            std::vector<Triangle>& triangles) {
+    triangles.reserve(triangles.size() + size_t(end - begin) / kASCIIBytesPerFacet + 1);
 
-    std::string line;
     Triangle currentTri{};
     int vertexIndex = 0;
 
-    while (std::getline(file, line)) {
+    const char* p = begin;
+    const char* reported = begin;
+    while (p < end) {
+        if (size_t(p - reported) >= kProgressStepBytes) {
+            if (!progress.advance(uint64_t(p - reported))) return;
+            reported = p;
+        }
+
         // Trim leading whitespace
-        size_t start = line.find_first_not_of(" \t\r\n");
-        if (start == std::string::npos) continue;
-        line = line.substr(start);
+        while (p < end && (isBlank(*p) || *p == '\n')) ++p;
+        if (p == end) break;
 
-        if (line.rfind("facet normal", 0) == 0) {
-            std::istringstream iss(line.substr(12));
-            iss >> currentTri.normal[0] >> currentTri.normal[1] >> currentTri.normal[2];
+        if (startsWith(p, end, "facet normal")) {
+            p += 12;
+            parseVec3(p, end, currentTri.normal);
             vertexIndex = 0;
-        } else if (line.rfind("vertex", 0) == 0) {
-            std::istringstream iss(line.substr(6));
-            float x, y, z;
-            iss >> x >> y >> z;
-            if (vertexIndex == 0) currentTri.v0 = {x, y, z};
-            else if (vertexIndex == 1) currentTri.v1 = {x, y, z};
-            else if (vertexIndex == 2) currentTri.v2 = {x, y, z};
+        } else if (startsWith(p, end, "vertex")) {
+            p += 6;
+            if (vertexIndex == 0) parseVec3(p, end, currentTri.v0);
+            else if (vertexIndex == 1) parseVec3(p, end, currentTri.v1);
+            else if (vertexIndex == 2) parseVec3(p, end, currentTri.v2);
             vertexIndex++;
-        } else if (line.rfind("endfacet", 0) == 0) {
+        } else if (startsWith(p, end, "endfacet")) {
             triangles.push_back(currentTri);
         }
+
+        // Everything else (solid, outer loop, endloop, ...) carries no data
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        p = eol ? eol + 1 : end;
     }
+    progress.advance(uint64_t(end - reported));
+}
+
+// Cut the text into `parts` ranges that each end just after an `endfacet` line
+static std::vector<const char*> splitASCIIChunks(const char* data, size_t size, size_t parts) {
+    std::string_view text(data, size);
+    std::vector<const char*> cuts{data};
+
+    size_t pos = 0;
+    for (size_t i = 1; i < parts; ++i) {
+        pos = std::max(pos, size * i / parts);
+        pos = text.find("endfacet", pos);
+        if (pos == std::string_view::npos) break;
+        pos = text.find('\n', pos);
+        if (pos == std::string_view::npos) break;
+        ++pos;
+        cuts.push_back(data + pos);
+    }
+
+    cuts.push_back(data + size);
+    return cuts;
+}
 
-    return !triangles.empty();
-}
-
-// Recompute normals if they're all zero (some exporters do this)
-static void fixNormals(std::vector<Triangle>& triangles) {
-    for (auto& tri : triangles) {
-        float len = tri.normal[0]*tri.normal[0] + tri.normal[1]*tri.normal[1] + tri.normal[2]*tri.normal[2];
-        if (len < 1e-6f) {
-            // Cross product of (v1-v0) x (v2-v0)
-            float ux = tri.v1[0] - tri.v0[0], uy = tri.v1[1] - tri.v0[1], uz = tri.v1[2] - tri.v0[2];
-            float vx = tri.v2[0] - tri.v0[0], vy = tri.v2[1] - tri.v0[1], vz = tri.v2[2] - tri.v0[2];
-            float nx = uy*vz - uz*vy;
-            float ny = uz*vx - ux*vz;
-            float nz = ux*vy - uy*vx;
-            float nlen = std::sqrt(nx*nx + ny*ny + nz*nz);
-            if (nlen > 1e-6f) {
-                tri.normal = {nx/nlen, ny/nlen, nz/nlen};
-            }
+// The facet count isn't known up front, so each chunk parses into its own
+// (transient) triangle list; once every chunk is done the lists are expanded
+// in parallel into their slice of glVertices and freed.
+static bool loadASCIISTL(const char* data, size_t size, const LoadOptions& options,
+                         ProgressReporter& progress,
+                         std::vector<float>& glVertices, BoundingBox& bounds) {
+    unsigned threads = decodeThreads(options);
+    auto cuts = splitASCIIChunks(data, size, Parallel::chunkCount(size, kMinASCIIChunkBytes, threads));
+    size_t chunks = cuts.size() - 1;
+
+    std::vector<std::vector<Triangle>> chunkTris(chunks);
+    std::vector<BoundingBox> chunkBounds(chunks);
+
+    Parallel::forChunks(chunks, 1, (unsigned)chunks, [&](size_t begin, size_t end, size_t) {
+        for (size_t c = begin; c < end; ++c) {
+            parseASCIIChunk(cuts[c], cuts[c + 1], progress, chunkTris[c]);
+        }
+    });
+    if (progress.cancelled()) return false;
+
+    // Each chunk's first triangle index, in file order
+    std::vector<size_t> firstTri(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; ++c) firstTri[c + 1] = firstTri[c] + chunkTris[c].size();
+    if (firstTri[chunks] == 0) return false;
+
+    glVertices.resize(firstTri[chunks] * kFloatsPerTriangle);
+    MeshKernels::EmitFn emit = MeshKernels::best().emit;
+
+    Parallel::forChunks(chunks, 1, (unsigned)chunks, [&](size_t begin, size_t end, size_t) {
+        for (size_t c = begin; c < end; ++c) {
+            BoundingBox box;
+            box.reset();
+            emit(reinterpret_cast<const char*>(chunkTris[c].data()), sizeof(Triangle), chunkTris[c].size(),
+                 glVertices.data() + firstTri[c] * kFloatsPerTriangle, box);
+            chunkBounds[c] = box;
+            std::vector<Triangle>().swap(chunkTris[c]);
         }
+    });
+
+    bounds.reset();
+    for (const auto& b : chunkBounds) bounds.merge(b);
+    return true;
+}
+
+// Fallback for pipes, network shares and anything else that can't be mapped:
+// pull the whole stream into memory once, in large blocks
+static bool readStream(const std::string& filepath, std::vector<char>& buffer) {
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file) return false;
+
+    constexpr size_t kBlockSize = 1 << 20;
+    buffer.clear();
+    while (file) {
+        size_t used = buffer.size();
+        buffer.resize(used + kBlockSize);
+        file.read(buffer.data() + used, kBlockSize);
+        buffer.resize(used + static_cast<size_t>(file.gcount()));
     }
+    return file.eof();
 }
 
 // ── STLModel ────────────────────────────────────────────────────────────────
 
-bool STLModel::load(const std::string& filepath) {
+bool STLModel::load(const std::string& filepath, const LoadOptions& options) {
+    PROFILE_SCOPE("load.total");
     filename = fs::path(filepath).filename().string();
     fullpath = fs::absolute(filepath).string();
     triangles.clear();
+    glVertices.clear();
+    indices.clear();
+    vertexCount = 0;
+    bvh.reset();
+
+    // A fresh cache entry has everything below already done
+    bool cached;
+    {
+        PROFILE_SCOPE("load.cacheRead");
+        cached = MeshCache::load(filepath, options, *this);
+    }
+    if (cached) {
+        if (options.stream) options.stream->close(false);
+        if (options.keepTriangles) ensureTriangles();
+        if (options.progress) options.progress->fraction.store(1.0f);
+        return true;
+    }
 
-    bool ok;
-    if (isBinarySTL(filepath)) {
-        ok = loadBinarySTL(filepath, triangles);
+    MappedFile mapped;
+    std::vector<char> buffer;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    // Map the file once; sniffing and decoding both work on the mapped bytes
+    if (mapped.open(filepath)) {
+        data = mapped.data();
+        size = mapped.size();
+    } else if (readStream(filepath, buffer)) {
+        data = buffer.data();
+        size = buffer.size();
     } else {
-        ok = loadASCIISTL(filepath, triangles);
+        if (options.stream) options.stream->close(false);
+        return false;
     }
 
-    if (!ok || triangles.empty()) return false;
+    // Decoders write glVertices directly and fix normals / reduce bounds per chunk
+    bool ok;
+    float decodeShare = options.weld ? 0.8f : 1.0f;
+    bool  binary = isBinarySTL(data, size);
+    {
+        PROFILE_SCOPE("load.parse");
+        if (binary) {
+            uint32_t numTriangles = 0;
+            std::memcpy(&numTriangles, data + 80, 4);
+            ProgressReporter progress(options.progress, numTriangles, decodeShare);
+            ok = loadBinarySTL(data, size, options, progress, glVertices, bounds);
+        } else {
+            ProgressReporter progress(options.progress, size, decodeShare);
+            ok = loadASCIISTL(data, size, options, progress, glVertices, bounds);
+        }
+    }
+
+    vertexCount = glVertices.size() / 6;
+
+    // The arrays are final until weld() / buildBVH(); ASCII shows up in one go
+    if (LoadStream* stream = options.stream.get()) {
+        if (ok && !binary && vertexCount > 0) {
+            stream->open(glVertices.data(), vertexCount / 3, bounds);
+            stream->publish(0, vertexCount / 3, bounds);
+        }
+        stream->close(ok && vertexCount > 0);
+    }
+
+    if (!ok || vertexCount == 0) {
+        std::vector<float>().swap(glVertices);
+        vertexCount = 0;
+        return false;
+    }
 
-    fixNormals(triangles);
-    computeBounds();
-    buildGLData();
+    touch();
+    if (options.weld) {
+        PROFILE_SCOPE("load.weld");
+        weld(options.weldOptions);
+    }
+    if (options.buildBVH) {
+        PROFILE_SCOPE("load.bvh");
+        buildBVH(options.threads);
+    }
+    if (!options.cacheDir.empty()) {
+        PROFILE_SCOPE("load.cacheWrite");
+        MeshCache::save(filepath, options, *this);
+    }
+    if (options.keepTriangles) {
+        PROFILE_SCOPE("load.triangles");
+        ensureTriangles();
+    }
+    if (options.progress) options.progress->fraction.store(1.0f);
     return true;
 }
 
+void STLModel::touch() {
+    static std::atomic<uint64_t> nextRevision{1};
+    revision = nextRevision.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t STLModel::memoryBytes() const {
+    return glVertices.capacity() * sizeof(float) +
+           indices.capacity() * sizeof(uint32_t) +
+           triangles.capacity() * sizeof(Triangle) +
+           (bvh ? bvh->memoryBytes() : 0);
+}
+
 void STLModel::computeBounds() {
     if (triangles.empty()) return;
 
-    bounds.minX = bounds.minY = bounds.minZ =  1e30f;
-    bounds.maxX = bounds.maxY = bounds.maxZ = -1e30f;
+    bounds.reset();
+    for (const auto& tri : triangles) {
+        bounds.include(tri.v0);
+        bounds.include(tri.v1);
+        bounds.include(tri.v2);
+    }
+}
 
-    auto updateBounds = [&](const std::array<float,3>& v) {
-        bounds.minX = std::min(bounds.minX, v[0]);
-        bounds.minY = std::min(bounds.minY, v[1]);
-        bounds.minZ = std::min(bounds.minZ, v[2]);
-        bounds.maxX = std::max(bounds.maxX, v[0]);
-        bounds.maxY = std::max(bounds.maxY, v[1]);
-        bounds.maxZ = std::max(bounds.maxZ, v[2]);
-    };
+void STLModel::ensureTriangles() {
+    if (!triangles.empty() || vertexCount == 0) return;
 
-    for (const auto& tri : triangles) {
-        updateBounds(tri.v0);
-        updateBounds(tri.v1);
-        updateBounds(tri.v2);
+    triangles.resize(triangleCount());
+
+    if (!isIndexed()) {
+        // Rebuild from the interleaved layout; every vertex of a facet carries its normal
+        const float* v = glVertices.data();
+        for (auto& tri : triangles) {
+            tri.normal = {v[0], v[1], v[2]};
+            tri.v0 = {v[3],  v[4],  v[5]};
+            tri.v1 = {v[9],  v[10], v[11]};
+            tri.v2 = {v[15], v[16], v[17]};
+            v += kFloatsPerTriangle;
+        }
+        return;
+    }
+
+    // Welded vertices may carry smoothed normals, so recompute facet normals
+    auto position = [&](uint32_t i) {
+        const float* v = &glVertices[size_t(i) * 6 + 3];
+        return std::array<float, 3>{v[0], v[1], v[2]};
+    };
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        auto& tri = triangles[t];
+        tri.normal = {0.0f, 0.0f, 0.0f};
+        tri.v0 = position(indices[t * 3 + 0]);
+        tri.v1 = position(indices[t * 3 + 1]);
+        tri.v2 = position(indices[t * 3 + 2]);
+        fixNormal(tri);
     }
 }
 
 void STLModel::buildGLData() {
-    // Interleaved: [nx, ny, nz, vx, vy, vz] per vertex, 3 vertices per triangle
+    // Interleaved: [nx, ny, nz, vx, vy, vz] per vertex, 3 vertices per triangle.
+    // The emit kernel also refreshes the bounds and fills in zero normals.
     vertexCount = triangles.size() * 3;
     glVertices.resize(vertexCount * 6);
+    indices.clear();
 
-    size_t idx = 0;
-    for (const auto& tri : triangles) {
-        // Vertex 0
-        glVertices[idx++] = tri.normal[0]; glVertices[idx++] = tri.normal[1]; glVertices[idx++] = tri.normal[2];
-        glVertices[idx++] = tri.v0[0];     glVertices[idx++] = tri.v0[1];     glVertices[idx++] = tri.v0[2];
-        // Vertex 1
-        glVertices[idx++] = tri.normal[0]; glVertices[idx++] = tri.normal[1]; glVertices[idx++] = tri.normal[2];
-        glVertices[idx++] = tri.v1[0];     glVertices[idx++] = tri.v1[1];     glVertices[idx++] = tri.v1[2];
-        // Vertex 2
-        glVertices[idx++] = tri.normal[0]; glVertices[idx++] = tri.normal[1]; glVertices[idx++] = tri.normal[2];
-        glVertices[idx++] = tri.v2[0];     glVertices[idx++] = tri.v2[1];     glVertices[idx++] = tri.v2[2];
-    }
-}
-
-// ── Directory scanning ──────────────────────────────────────────────────────
-
-std::vector<std::string> findSTLFiles(const std::string& directory, bool recursive) {
-    std::vector<std::string> files;
-
-    try {
-        if (recursive) {
-            for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-                if (entry.is_regular_file()) {
-                    auto ext = entry.path().extension().string();
-                    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                    if (ext == ".stl") {
-                        files.push_back(entry.path().string());
-                    }
-                }
-            }
-        } else {
-            for (const auto& entry : fs::directory_iterator(directory)) {
-                if (entry.is_regular_file()) {
-                    auto ext = entry.path().extension().string();
-                    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                    if (ext == ".stl") {
-                        files.push_back(entry.path().string());
-                    }
-                }
-            }
-        }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Filesystem error: " << e.what() << std::endl;
+    if (!triangles.empty()) {
+        bounds.reset();
+        MeshKernels::best().emit(reinterpret_cast<const char*>(triangles.data()), sizeof(Triangle),
+                                 triangles.size(), glVertices.data(), bounds);
     }
+    touch();
+}
+
+// ── File probing ────────────────────────────────────────────────────────────
 
-    std::sort(files.begin(), files.end());
-    return files;
+bool probeSTLFile(const std::string& filepath, STLFileInfo& info) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(filepath, ec);
+    if (ec) return false;
+
+    char header[kBinaryHeaderSize] = {};
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if (!file) return false;
+        file.read(header, sizeof(header));
+    }
+
+    info.fileSize = size;
+    info.binary   = isBinarySTL(header, size);
+    if (info.binary) {
+        uint32_t numTriangles = 0;
+        std::memcpy(&numTriangles, header + 80, 4);
+        info.triangles = numTriangles;
+    } else {
+        info.triangles = size_t(size / kASCIIBytesPerFacet);
+    }
+    return true;
 }